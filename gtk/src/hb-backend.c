@@ -237,6 +237,17 @@ combo_opts_t crop_opts =
     d_crop_opts
 };
 
+static options_map_t d_scaler_opts[] =
+{
+    {N_("Lanczos"), "swscale", 0},
+    {N_("Fast"),    "fast",    1},
+};
+combo_opts_t scaler_opts =
+{
+    sizeof(d_scaler_opts)/sizeof(options_map_t),
+    d_scaler_opts
+};
+
 static options_map_t d_rotate_opts[] =
 {
     {N_("Off"),    "0",   0},
@@ -808,6 +819,12 @@ combo_name_map_t combo_name_map[] =
         small_opts_set,
         generic_opt_get
     },
+    {
+        "VideoScaler",
+        &scaler_opts,
+        small_opts_set,
+        generic_opt_get
+    },
     {
         "crop_mode",
         &crop_opts,
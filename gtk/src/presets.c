@@ -1710,27 +1710,461 @@ presets_list_remove(signal_user_data_t *ud, hb_preset_index_t *path)
     }
 }
 
+// The queue is persisted as a snapshot, "queue.<pid>", plus a journal of
+// the changes made since, "queue.<pid>.journal".  Each save appends only
+// the difference from the previous save, one compact JSON record per line.
+// Once the journal outgrows the queue it is folded into a new snapshot.
+//
+// Journal records:
+//   {"op":"base","generation":N}   first line, names the snapshot
+//   {"op":"add","index":I,"job":{...}}
+//   {"op":"remove","index":I}
+//   {"op":"move","from":J,"to":I}
+//   {"op":"update","index":I,"uiSettings":{...}}
+#define QUEUE_JOURNAL_MIN_RECORDS 256
+
+// The only job settings the queue modifies in place after a job is added
+static const char *queue_tracked_keys[] =
+{
+    "job_status",
+    "job_unique_id",
+    "job_start_time",
+    "job_finish_time",
+    "job_pause_time_ms",
+    "ActivityFilename",
+    NULL
+};
+
+typedef struct
+{
+    GhbValue *job;      // Reference held so the pointer can not be reused
+    GhbValue *tracked;  // Tracked uiSettings as of the last save
+} queue_shadow_t;
+
+static GArray *queue_shadow         = NULL;
+static FILE   *queue_journal        = NULL;
+static int     queue_journal_count  = 0;
+static gint64  queue_generation     = 0;
+
+static gchar*
+queue_file_path (int pid, const char *suffix)
+{
+    gchar *config, *path;
+
+    config = ghb_get_user_config_dir(NULL);
+    path   = g_strdup_printf("%s/queue.%d%s", config, pid, suffix);
+    g_free(config);
+    return path;
+}
+
+static GhbValue*
+queue_tracked_new (GhbValue *job)
+{
+    GhbValue *ui, *tracked;
+    int       ii;
+
+    tracked = ghb_dict_new();
+    ui      = ghb_dict_get(job, "uiSettings");
+    for (ii = 0; ui != NULL && queue_tracked_keys[ii] != NULL; ii++)
+    {
+        GhbValue *val = ghb_dict_get(ui, queue_tracked_keys[ii]);
+        if (val != NULL)
+        {
+            ghb_dict_set(tracked, queue_tracked_keys[ii], ghb_value_dup(val));
+        }
+    }
+    return tracked;
+}
+
+static gboolean
+queue_tracked_changed (GhbValue *job, GhbValue *tracked)
+{
+    GhbValue *ui;
+    int       ii;
+
+    ui = ghb_dict_get(job, "uiSettings");
+    for (ii = 0; queue_tracked_keys[ii] != NULL; ii++)
+    {
+        GhbValue *a = ui != NULL ? ghb_dict_get(ui, queue_tracked_keys[ii])
+                                 : NULL;
+        GhbValue *b = ghb_dict_get(tracked, queue_tracked_keys[ii]);
+        if (a == NULL || b == NULL ? a != b : ghb_value_cmp(a, b))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void
+queue_shadow_insert (int index, GhbValue *job)
+{
+    queue_shadow_t entry;
+
+    entry.job     = job;
+    entry.tracked = queue_tracked_new(job);
+    ghb_value_incref(job);
+    g_array_insert_val(queue_shadow, index, entry);
+}
+
+static void
+queue_shadow_remove (int index)
+{
+    queue_shadow_t *entry;
+
+    entry = &g_array_index(queue_shadow, queue_shadow_t, index);
+    ghb_value_decref(entry->job);
+    ghb_value_free(&entry->tracked);
+    g_array_remove_index(queue_shadow, index);
+}
+
+static void
+queue_journal_write (GhbValue *record)
+{
+    char *json;
+
+    json = json_dumps(record, JSON_COMPACT);
+    ghb_value_free(&record);
+    if (json == NULL || queue_journal == NULL)
+    {
+        free(json);
+        return;
+    }
+    fputs(json, queue_journal);
+    fputc('\n', queue_journal);
+    free(json);
+    queue_journal_count++;
+}
+
+static GhbValue*
+queue_record_new (const char *op, const char *key, int index)
+{
+    GhbValue *record;
+
+    record = ghb_dict_new();
+    ghb_dict_set_string(record, "op", op);
+    ghb_dict_set_int(record, key, index);
+    return record;
+}
+
+// Write the snapshot and make sure it is on disk before it replaces
+// the old one
+static int
+queue_write_snapshot (const char *path, GhbValue *snapshot)
+{
+    FILE *file;
+    int   err;
+
+    file = g_fopen(path, "w");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    err = json_dumpf(snapshot, file, JSON_INDENT(4) | JSON_SORT_KEYS);
+    if (fflush(file) != 0)
+    {
+        err = -1;
+    }
+#if !defined(_WIN32)
+    if (err == 0 && fsync(fileno(file)) != 0)
+    {
+        err = -1;
+    }
+#endif
+    if (fclose(file) != 0)
+    {
+        err = -1;
+    }
+    return err;
+}
+
+// Write a fresh snapshot and start a new journal on top of it.  Returns
+// FALSE and leaves the current snapshot and journal in use on failure.
+static gboolean
+queue_compact (GhbValue *queue)
+{
+    GhbValue *snapshot;
+    gchar    *path, *tmp_path;
+    int       pid, ii, count, err;
+
+    pid      = getpid();
+    path     = queue_file_path(pid, "");
+    tmp_path = queue_file_path(pid, ".tmp");
+
+    snapshot = ghb_dict_new();
+    ghb_dict_set_int(snapshot, "Generation", queue_generation + 1);
+    ghb_value_incref(queue);
+    ghb_dict_set(snapshot, "Queue", queue);
+    err = queue_write_snapshot(tmp_path, snapshot);
+    if (err == 0)
+    {
+        // Replace the snapshot atomically so a crash leaves either the
+        // old snapshot and journal or the new snapshot intact
+        err = g_rename(tmp_path, path);
+    }
+    if (err != 0)
+    {
+        g_warning("Failed to write queue snapshot %s", path);
+        g_unlink(tmp_path);
+    }
+    ghb_value_free(&snapshot);
+    g_free(tmp_path);
+    g_free(path);
+    if (err != 0)
+    {
+        return FALSE;
+    }
+    queue_generation++;
+
+    if (queue_journal != NULL)
+    {
+        fclose(queue_journal);
+    }
+    path          = queue_file_path(pid, ".journal");
+    queue_journal = g_fopen(path, "w");
+    g_free(path);
+    queue_journal_count = 0;
+
+    GhbValue *record = ghb_dict_new();
+    ghb_dict_set_string(record, "op", "base");
+    ghb_dict_set_int(record, "generation", queue_generation);
+    queue_journal_write(record);
+    if (queue_journal != NULL)
+    {
+        fflush(queue_journal);
+    }
+
+    if (queue_shadow == NULL)
+    {
+        queue_shadow = g_array_new(FALSE, FALSE, sizeof(queue_shadow_t));
+    }
+    while (queue_shadow->len > 0)
+    {
+        queue_shadow_remove(queue_shadow->len - 1);
+    }
+    count = ghb_array_len(queue);
+    for (ii = 0; ii < count; ii++)
+    {
+        queue_shadow_insert(ii, ghb_array_get(queue, ii));
+    }
+    return TRUE;
+}
+
 void
 ghb_save_queue(GhbValue *queue)
 {
-    pid_t  pid;
-    char  *name;
+    GHashTable *present;
+    int         ii, jj, count;
 
-    pid  = getpid();
-    name = g_strdup_printf ("queue.%" PRId64, (int64_t)pid);
-    write_config_file(name, queue);
-    g_free(name);
+    count = ghb_array_len(queue);
+    if (queue_journal == NULL ||
+        queue_journal_count > MAX(QUEUE_JOURNAL_MIN_RECORDS, count))
+    {
+        // On failure keep appending to the current journal, if any
+        if (queue_compact(queue) || queue_journal == NULL)
+        {
+            return;
+        }
+    }
+
+    // Jobs that left the queue
+    present = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (ii = 0; ii < count; ii++)
+    {
+        g_hash_table_add(present, ghb_array_get(queue, ii));
+    }
+    for (ii = queue_shadow->len - 1; ii >= 0; ii--)
+    {
+        queue_shadow_t *entry;
+
+        entry = &g_array_index(queue_shadow, queue_shadow_t, ii);
+        if (!g_hash_table_contains(present, entry->job))
+        {
+            queue_journal_write(queue_record_new("remove", "index", ii));
+            queue_shadow_remove(ii);
+        }
+    }
+    g_hash_table_destroy(present);
+
+    // Jobs that were added or reordered, then in-place status changes
+    for (ii = 0; ii < count; ii++)
+    {
+        GhbValue       *job = ghb_array_get(queue, ii);
+        GhbValue       *record;
+        queue_shadow_t *entry;
+
+        for (jj = ii; jj < (int)queue_shadow->len; jj++)
+        {
+            if (g_array_index(queue_shadow, queue_shadow_t, jj).job == job)
+                break;
+        }
+        if (jj >= (int)queue_shadow->len)
+        {
+            record = queue_record_new("add", "index", ii);
+            ghb_dict_set(record, "job", ghb_value_dup(job));
+            queue_journal_write(record);
+            queue_shadow_insert(ii, job);
+            continue;
+        }
+        if (jj != ii)
+        {
+            queue_shadow_t moved;
+
+            record = queue_record_new("move", "from", jj);
+            ghb_dict_set_int(record, "to", ii);
+            queue_journal_write(record);
+            moved = g_array_index(queue_shadow, queue_shadow_t, jj);
+            g_array_remove_index(queue_shadow, jj);
+            g_array_insert_val(queue_shadow, ii, moved);
+        }
+        entry = &g_array_index(queue_shadow, queue_shadow_t, ii);
+        if (queue_tracked_changed(job, entry->tracked))
+        {
+            ghb_value_free(&entry->tracked);
+            entry->tracked = queue_tracked_new(job);
+            record = queue_record_new("update", "index", ii);
+            ghb_dict_set(record, "uiSettings", ghb_value_dup(entry->tracked));
+            queue_journal_write(record);
+        }
+    }
+    fflush(queue_journal);
+}
+
+static void
+queue_journal_apply (GhbValue *queue, GhbValue *record)
+{
+    const char *op;
+    int         index, count;
+
+    op    = ghb_dict_get_string(record, "op");
+    index = ghb_dict_get_int(record, "index");
+    count = ghb_array_len(queue);
+    if (op == NULL)
+    {
+        return;
+    }
+    if (!strcmp(op, "add"))
+    {
+        GhbValue *job = ghb_dict_get(record, "job");
+        if (job != NULL && index >= 0)
+        {
+            ghb_array_insert(queue, MIN(index, count), ghb_value_dup(job));
+        }
+    }
+    else if (!strcmp(op, "remove"))
+    {
+        if (index >= 0 && index < count)
+        {
+            ghb_array_remove(queue, index);
+        }
+    }
+    else if (!strcmp(op, "move"))
+    {
+        int from = ghb_dict_get_int(record, "from");
+        int to   = ghb_dict_get_int(record, "to");
+        if (from >= 0 && from < count && to >= 0 && to < count)
+        {
+            GhbValue *job = ghb_array_get(queue, from);
+            ghb_value_incref(job);
+            ghb_array_remove(queue, from);
+            ghb_array_insert(queue, to, job);
+        }
+    }
+    else if (!strcmp(op, "update"))
+    {
+        GhbValue *tracked = ghb_dict_get(record, "uiSettings");
+        if (index >= 0 && index < count && tracked != NULL)
+        {
+            GhbValue *ui;
+            int       ii;
+
+            ui = ghb_dict_get(ghb_array_get(queue, index), "uiSettings");
+            for (ii = 0; ui != NULL && queue_tracked_keys[ii] != NULL; ii++)
+            {
+                GhbValue *val = ghb_dict_get(tracked, queue_tracked_keys[ii]);
+                if (val != NULL)
+                {
+                    ghb_dict_set(ui, queue_tracked_keys[ii],
+                                 ghb_value_dup(val));
+                }
+                else
+                {
+                    ghb_dict_remove(ui, queue_tracked_keys[ii]);
+                }
+            }
+        }
+    }
 }
 
 GhbValue*
 ghb_load_old_queue(int pid)
 {
-    GhbValue *queue;
-    char     *name;
+    GhbValue *snapshot, *queue;
+    gint64    generation;
+    gchar    *path, *contents;
 
-    name  = g_strdup_printf ("queue.%d", pid);
-    queue = read_config_file(name);
-    g_free(name);
+    path     = queue_file_path(pid, "");
+    snapshot = NULL;
+    if (g_file_test(path, G_FILE_TEST_IS_REGULAR))
+    {
+        snapshot = ghb_json_parse_file(path);
+    }
+    g_free(path);
+    if (snapshot == NULL)
+    {
+        return NULL;
+    }
+    if (ghb_value_type(snapshot) == GHB_ARRAY)
+    {
+        // Queue written before journaling, no journal applies to it
+        return snapshot;
+    }
+    queue = ghb_dict_get(snapshot, "Queue");
+    if (queue == NULL || ghb_value_type(queue) != GHB_ARRAY)
+    {
+        ghb_value_free(&snapshot);
+        return NULL;
+    }
+    generation = ghb_dict_get_int(snapshot, "Generation");
+    ghb_value_incref(queue);
+    ghb_value_free(&snapshot);
+
+    path = queue_file_path(pid, ".journal");
+    if (g_file_get_contents(path, &contents, NULL, NULL))
+    {
+        gboolean   based = FALSE;
+        gchar    **lines;
+        int        ii;
+
+        lines = g_strsplit(contents, "\n", -1);
+        for (ii = 0; lines[ii] != NULL && lines[ii][0] != 0; ii++)
+        {
+            GhbValue *record = json_loads(lines[ii], 0, NULL);
+            if (record == NULL)
+            {
+                // Torn write at the tail of the journal
+                break;
+            }
+            if (!based)
+            {
+                const char *op = ghb_dict_get_string(record, "op");
+                based = op != NULL && !strcmp(op, "base") &&
+                        ghb_dict_get_int(record, "generation") == generation;
+                ghb_value_free(&record);
+                if (!based)
+                {
+                    // Journal belongs to another snapshot
+                    break;
+                }
+                continue;
+            }
+            queue_journal_apply(queue, record);
+            ghb_value_free(&record);
+        }
+        g_strfreev(lines);
+        g_free(contents);
+    }
+    g_free(path);
     return queue;
 }
 
@@ -1742,6 +2176,12 @@ ghb_remove_old_queue_file(int pid)
     name = g_strdup_printf ("queue.%d", pid);
     remove_config_file(name);
     g_free(name);
+    name = g_strdup_printf ("queue.%d.journal", pid);
+    remove_config_file(name);
+    g_free(name);
+    name = g_strdup_printf ("queue.%d.tmp", pid);
+    remove_config_file(name);
+    g_free(name);
 }
 
 GhbValue* ghb_create_copy_mask(GhbValue *settings)
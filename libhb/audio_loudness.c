@@ -0,0 +1,354 @@
+/* audio_loudness.c
+ *
+ * Copyright (c) 2003-2025 HandBrake Team
+ * This file is part of the HandBrake source code
+ * Homepage: <http://handbrake.fr/>
+ * It may be used under the terms of the GNU General Public License v2.
+ * For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+#include "handbrake/common.h"
+#include "handbrake/hbffmpeg.h"
+#include "handbrake/audio_loudness.h"
+
+#define LOUDNESS_MAX_CHANNELS  8
+
+// Gated block loudness histogram, -70 LUFS (absolute gate) and up
+#define LOUDNESS_HIST_MIN      -70.0
+#define LOUDNESS_HIST_STEP       0.1
+#define LOUDNESS_HIST_BINS     1000
+
+#define LOUDNESS_MAX_GAIN       20.0    // dB, either way
+#define LOUDNESS_SLEW            1.0    // dB per second
+#define LOUDNESS_CEILING         0.8912509381337456 // -1 dBFS
+
+typedef struct
+{
+    double b0, b1, b2;
+    double a1, a2;
+} biquad_t;
+
+struct hb_audio_loudness_s
+{
+    int              channels;
+    double           target;
+    int64_t          lookahead;
+
+    // K-weighting, BS.1770 pre-filter and RLB high-pass
+    biquad_t         shelf;
+    biquad_t         highpass;
+    double           state[LOUDNESS_MAX_CHANNELS][4];
+    double           weight[LOUDNESS_MAX_CHANNELS];
+
+    // 100 ms sub-blocks, 4 make a 400 ms gating block
+    int              step;
+    int              step_count;
+    double           step_sum;
+    double           sub[4];
+    int              sub_count;
+
+    uint64_t         hist_count[LOUDNESS_HIST_BINS];
+    double           hist_energy[LOUDNESS_HIST_BINS];
+
+    hb_buffer_list_t queue;
+    int64_t          queued;         // duration of the queue
+
+    int              started;
+    double           gain_db;        // slew limited loudness gain
+    double           gain;           // linear gain applied last
+};
+
+static double energy_to_lufs(double energy)
+{
+    return -0.691 + 10. * log10(energy);
+}
+
+static void biquad_init(hb_audio_loudness_t *loudness, int sample_rate)
+{
+    double K, Q, Vh, Vb, a0;
+
+    // High shelf, +4 dB above ~1.7 kHz
+    K  = tan(M_PI * 1681.974450955533 / sample_rate);
+    Q  = 0.7071752369554196;
+    Vh = pow(10., 3.999843853973347 / 20.);
+    Vb = pow(Vh, 0.4996667741545416);
+    a0 = 1. + K / Q + K * K;
+    loudness->shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+    loudness->shelf.b1 = 2. * (K * K - Vh) / a0;
+    loudness->shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+    loudness->shelf.a1 = 2. * (K * K - 1.) / a0;
+    loudness->shelf.a2 = (1. - K / Q + K * K) / a0;
+
+    // High-pass at ~38 Hz
+    K  = tan(M_PI * 38.13547087602444 / sample_rate);
+    Q  = 0.5003270373238773;
+    a0 = 1. + K / Q + K * K;
+    loudness->highpass.b0 =  1.;
+    loudness->highpass.b1 = -2.;
+    loudness->highpass.b2 =  1.;
+    loudness->highpass.a1 = 2. * (K * K - 1.) / a0;
+    loudness->highpass.a2 = (1. - K / Q + K * K) / a0;
+}
+
+static double channel_weight(enum AVChannel channel)
+{
+    switch (channel)
+    {
+        case AV_CHAN_LOW_FREQUENCY:
+        case AV_CHAN_LOW_FREQUENCY_2:
+            return 0.;
+        case AV_CHAN_SIDE_LEFT:
+        case AV_CHAN_SIDE_RIGHT:
+        case AV_CHAN_BACK_LEFT:
+        case AV_CHAN_BACK_RIGHT:
+        case AV_CHAN_BACK_CENTER:
+            return 1.41;
+        default:
+            return 1.;
+    }
+}
+
+hb_audio_loudness_t * hb_audio_loudness_init(int sample_rate, int hb_amixdown,
+                                             double target, int64_t lookahead)
+{
+    hb_audio_loudness_t *loudness;
+    AVChannelLayout      ch_layout;
+    uint64_t             layout;
+
+    layout = hb_ff_mixdown_xlat(hb_amixdown, NULL);
+    if (av_channel_layout_from_mask(&ch_layout, layout) < 0 ||
+        ch_layout.nb_channels > LOUDNESS_MAX_CHANNELS || sample_rate <= 0)
+    {
+        hb_error("hb_audio_loudness_init: unsupported mixdown %d", hb_amixdown);
+        return NULL;
+    }
+
+    loudness = calloc(1, sizeof(hb_audio_loudness_t));
+    if (loudness == NULL)
+    {
+        hb_error("hb_audio_loudness_init: failed to allocate loudness");
+        return NULL;
+    }
+
+    loudness->channels  = ch_layout.nb_channels;
+    loudness->target    = MIN(MAX(target, HB_LOUDNESS_TARGET_MIN),
+                              HB_LOUDNESS_TARGET_MAX);
+    loudness->lookahead = lookahead;
+    loudness->step      = MAX(1, sample_rate / 10);
+    loudness->gain      = 1.;
+    for (int ii = 0; ii < loudness->channels; ii++)
+    {
+        loudness->weight[ii] = channel_weight(
+            av_channel_layout_channel_from_index(&ch_layout, ii));
+    }
+    av_channel_layout_uninit(&ch_layout);
+    biquad_init(loudness, sample_rate);
+
+    return loudness;
+}
+
+void hb_audio_loudness_free(hb_audio_loudness_t **_loudness)
+{
+    hb_audio_loudness_t *loudness = *_loudness;
+
+    if (loudness == NULL)
+    {
+        return;
+    }
+    hb_buffer_list_close(&loudness->queue);
+    free(loudness);
+    *_loudness = NULL;
+}
+
+static void add_block(hb_audio_loudness_t *loudness, double energy)
+{
+    double lufs;
+    int    bin;
+
+    if (energy <= 0.)
+    {
+        return;
+    }
+    lufs = energy_to_lufs(energy);
+    if (lufs < LOUDNESS_HIST_MIN)
+    {
+        return;
+    }
+    bin = (lufs - LOUDNESS_HIST_MIN) / LOUDNESS_HIST_STEP;
+    bin = MIN(bin, LOUDNESS_HIST_BINS - 1);
+    loudness->hist_count[bin]++;
+    loudness->hist_energy[bin] += energy;
+}
+
+static void measure(hb_audio_loudness_t *loudness, const hb_buffer_t *buf)
+{
+    const float *samples  = (const float *)buf->data;
+    const int    channels = loudness->channels;
+    int          nsamples = buf->size / (channels * sizeof(float));
+    biquad_t     s = loudness->shelf, h = loudness->highpass;
+
+    for (int ii = 0; ii < nsamples; ii++)
+    {
+        double sum = 0.;
+
+        for (int ch = 0; ch < channels; ch++)
+        {
+            double *z = loudness->state[ch];
+            double  x = samples[ii * channels + ch];
+            double  y;
+
+            // Transposed direct form II, both stages
+            y    = s.b0 * x + z[0];
+            z[0] = s.b1 * x - s.a1 * y + z[1];
+            z[1] = s.b2 * x - s.a2 * y;
+            x    = y;
+            y    = h.b0 * x + z[2];
+            z[2] = h.b1 * x - h.a1 * y + z[3];
+            z[3] = h.b2 * x - h.a2 * y;
+
+            sum += loudness->weight[ch] * y * y;
+        }
+        loudness->step_sum += sum;
+
+        if (++loudness->step_count == loudness->step)
+        {
+            loudness->sub[loudness->sub_count % 4] =
+                loudness->step_sum / loudness->step;
+            loudness->sub_count++;
+            loudness->step_sum   = 0.;
+            loudness->step_count = 0;
+
+            if (loudness->sub_count >= 4)
+            {
+                add_block(loudness, (loudness->sub[0] + loudness->sub[1] +
+                                     loudness->sub[2] + loudness->sub[3]) / 4.);
+            }
+        }
+    }
+}
+
+double hb_audio_loudness_integrated(hb_audio_loudness_t *loudness)
+{
+    uint64_t count = 0;
+    double   energy = 0., gate;
+    int      ii, first;
+
+    for (ii = 0; ii < LOUDNESS_HIST_BINS; ii++)
+    {
+        count  += loudness->hist_count[ii];
+        energy += loudness->hist_energy[ii];
+    }
+    if (count == 0)
+    {
+        return -HUGE_VAL;
+    }
+
+    // Relative gate, 10 LU below the absolute gated loudness
+    gate  = energy_to_lufs(energy / count) - 10.;
+    first = ceil((gate - LOUDNESS_HIST_MIN) / LOUDNESS_HIST_STEP);
+    first = MAX(first, 0);
+
+    count  = 0;
+    energy = 0.;
+    for (ii = first; ii < LOUDNESS_HIST_BINS; ii++)
+    {
+        count  += loudness->hist_count[ii];
+        energy += loudness->hist_energy[ii];
+    }
+    if (count == 0)
+    {
+        return -HUGE_VAL;
+    }
+    return energy_to_lufs(energy / count);
+}
+
+double hb_audio_loudness_gain(hb_audio_loudness_t *loudness)
+{
+    return 20. * log10(loudness->gain);
+}
+
+static hb_buffer_t * apply_gain(hb_audio_loudness_t *loudness, hb_buffer_t *buf)
+{
+    float  *samples  = (float *)buf->data;
+    int     channels = loudness->channels;
+    int     nsamples = buf->size / (channels * sizeof(float));
+    double  integrated, gain, step, peak = 0.;
+
+    loudness->queued -= buf->s.duration;
+
+    integrated = hb_audio_loudness_integrated(loudness);
+    if (integrated > -HUGE_VAL)
+    {
+        double wanted = loudness->target - integrated;
+        double slew   = LOUDNESS_SLEW * buf->s.duration / 90000.;
+
+        wanted = MIN(MAX(wanted, -LOUDNESS_MAX_GAIN), LOUDNESS_MAX_GAIN);
+        if (!loudness->started)
+        {
+            loudness->gain_db = wanted;
+            loudness->gain    = pow(10., wanted / 20.);
+            loudness->started = 1;
+        }
+        else
+        {
+            loudness->gain_db += MIN(MAX(wanted - loudness->gain_db, -slew), slew);
+        }
+    }
+
+    for (int ii = 0; ii < nsamples * channels; ii++)
+    {
+        peak = MAX(peak, fabs(samples[ii]));
+    }
+    gain = pow(10., loudness->gain_db / 20.);
+    if (peak * gain > LOUDNESS_CEILING)
+    {
+        // Peak limit, and let the slew bring the gain back up from here
+        gain = LOUDNESS_CEILING / peak;
+        loudness->gain_db = 20. * log10(gain);
+    }
+
+    // Cut at once so no sample exceeds the ceiling, ramp up from the
+    // previous gain to avoid zipper noise
+    step = nsamples > 0 && gain > loudness->gain ?
+           (gain - loudness->gain) / nsamples : 0.;
+    for (int ii = 0; ii < nsamples; ii++)
+    {
+        double g = step > 0. ? loudness->gain + step * (ii + 1) : gain;
+        for (int ch = 0; ch < channels; ch++)
+        {
+            double sample = samples[ii * channels + ch] * g;
+            samples[ii * channels + ch] = MIN(MAX(sample, -1.), 1.);
+        }
+    }
+    loudness->gain = gain;
+
+    return buf;
+}
+
+hb_buffer_t * hb_audio_loudness_process(hb_audio_loudness_t *loudness,
+                                        hb_buffer_t *buf)
+{
+    hb_buffer_t *head;
+
+    measure(loudness, buf);
+    hb_buffer_list_append(&loudness->queue, buf);
+    loudness->queued += buf->s.duration;
+
+    head = hb_buffer_list_head(&loudness->queue);
+    if (loudness->queued - head->s.duration < loudness->lookahead)
+    {
+        return NULL;
+    }
+    return apply_gain(loudness, hb_buffer_list_rem_head(&loudness->queue));
+}
+
+hb_buffer_t * hb_audio_loudness_flush(hb_audio_loudness_t *loudness)
+{
+    hb_buffer_t *buf = hb_buffer_list_rem_head(&loudness->queue);
+
+    if (buf == NULL)
+    {
+        return NULL;
+    }
+    return apply_gain(loudness, buf);
+}
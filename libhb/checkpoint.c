@@ -0,0 +1,838 @@
+/* checkpoint.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/* Resumable encodes.
+ *
+ * When job->checkpoint is set the muxer does not write job->file
+ * directly.  Each run of the job writes a part file in a container
+ * layout that stays readable when the process dies (fragmented MP4,
+ * or Matroska which is always written cluster by cluster).  Every
+ * job->checkpoint seconds, at a video IDR frame, the muxer flushes
+ * everything that precedes that frame and appends a commit to a
+ * journal next to the output:
+ *
+ *   HandBrake checkpoint 1
+ *   job <fingerprint of the job settings>
+ *   part <part index> <start of the part on the output timeline>
+ *   chapter <chapter index> <start time>
+ *   commit <part index> <time> <part size>
+ *
+ * Times are in 90 kHz ticks on the output timeline of the whole job.
+ * A later run of the same job truncates the last part to its last
+ * commit, starts reading the source at the committed time and writes
+ * the next part.  Once the encode completes, the parts are joined into
+ * job->file and the journal is deleted.  A single part that needs
+ * nothing only a remux provides is renamed instead.
+ *
+ * The journal is append only.  Replaying it is enough to recover the
+ * state: a 'part' line discards chapters recorded at or after its
+ * start, which a run that died before its next commit may have left.
+ */
+
+#include "handbrake/handbrake.h"
+#include "handbrake/hbffmpeg.h"
+#include "handbrake/hb_json.h"
+
+#define CHECKPOINT_VERSION 1
+
+typedef struct
+{
+    int     index;
+    int64_t start;
+} checkpoint_chapter_t;
+
+struct hb_checkpoint_s
+{
+    char                 * journal_path;
+    FILE                 * journal;
+    int64_t                journal_size; // up to the last complete line
+    uint32_t               fingerprint;
+
+    char                 * part_path;    // file written by this run
+    int                    part;         // its index
+    int64_t                interval;     // 90 kHz ticks between commits
+    int64_t                next;         // part time of the next commit
+    int                    idr;          // encoder labels IDR frames
+
+    int64_t              * part_start;   // output time of each part start
+    int                    part_count;
+    checkpoint_chapter_t * chapters;
+    int                    chapter_count;
+
+    int                    commit_part;  // last commit, -1 if none
+    int64_t                commit_pts;
+    int64_t                commit_size;
+};
+
+static char * part_name(const hb_job_t *job, int part)
+{
+    return hb_strdup_printf("%s.part%03d", job->file, part);
+}
+
+// FNV-1a over the job settings, so that a journal left by a
+// different job writing to the same file is never resumed.
+static uint32_t job_fingerprint(const hb_job_t *job)
+{
+    hb_dict_t *dict = hb_job_to_dict(job);
+    uint32_t   hash = 2166136261u;
+
+    if (dict == NULL)
+    {
+        return 0;
+    }
+    // Neither changes what ends up in the output
+    hb_dict_remove(dict, "SequenceID");
+    hb_dict_remove(hb_dict_get(hb_dict_get(dict, "Destination"), "Options"),
+                   "Checkpoint");
+
+    char *json = hb_value_get_json(dict);
+    hb_value_free(&dict);
+    if (json == NULL)
+    {
+        return 0;
+    }
+    for (const char *c = json; *c; c++)
+    {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+    free(json);
+
+    return hash;
+}
+
+static int set_part_start(hb_checkpoint_t *cp, int part, int64_t start)
+{
+    if (part >= cp->part_count)
+    {
+        int64_t *tmp = realloc(cp->part_start, (part + 1) * sizeof(int64_t));
+        if (tmp == NULL)
+        {
+            return -1;
+        }
+        cp->part_start = tmp;
+    }
+    cp->part_count = part + 1;
+    cp->part_start[part] = start;
+
+    // Anything recorded after this point belonged to a run that
+    // did not reach its next commit
+    while (cp->chapter_count > 0 &&
+           cp->chapters[cp->chapter_count - 1].start >= start)
+    {
+        cp->chapter_count--;
+    }
+    return 0;
+}
+
+static int add_chapter(hb_checkpoint_t *cp, int index, int64_t start)
+{
+    checkpoint_chapter_t *tmp;
+
+    tmp = realloc(cp->chapters, (cp->chapter_count + 1) * sizeof(*tmp));
+    if (tmp == NULL)
+    {
+        return -1;
+    }
+    cp->chapters = tmp;
+    cp->chapters[cp->chapter_count].index = index;
+    cp->chapters[cp->chapter_count].start = start;
+    cp->chapter_count++;
+    return 0;
+}
+
+// Returns 0 when the journal belongs to this job
+static int journal_replay(hb_checkpoint_t *cp, FILE *file)
+{
+    char    line[1024];
+    int     version = 0, part, index;
+    int64_t start, size;
+    uint32_t fingerprint;
+
+    if (fgets(line, sizeof(line), file) == NULL ||
+        sscanf(line, "HandBrake checkpoint %d", &version) != 1 ||
+        version != CHECKPOINT_VERSION)
+    {
+        return -1;
+    }
+    if (fgets(line, sizeof(line), file) == NULL ||
+        sscanf(line, "job %"SCNx32, &fingerprint) != 1 ||
+        fingerprint != cp->fingerprint)
+    {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        // A line cut short by a crash is ignored
+        if (strchr(line, '\n') == NULL)
+        {
+            break;
+        }
+        cp->journal_size = ftell(file);
+        if (sscanf(line, "part %d %"SCNd64, &part, &start) == 2)
+        {
+            if (part < 0 || set_part_start(cp, part, start))
+            {
+                return -1;
+            }
+        }
+        else if (sscanf(line, "chapter %d %"SCNd64, &index, &start) == 2)
+        {
+            if (add_chapter(cp, index, start))
+            {
+                return -1;
+            }
+        }
+        else if (sscanf(line, "commit %d %"SCNd64" %"SCNd64,
+                        &part, &start, &size) == 3)
+        {
+            if (part < 0 || part >= cp->part_count)
+            {
+                return -1;
+            }
+            cp->commit_part = part;
+            cp->commit_pts  = start;
+            cp->commit_size = size;
+        }
+    }
+    return 0;
+}
+
+static int journal_write(hb_checkpoint_t *cp, const char *fmt, ...)
+{
+    va_list args;
+    int     ret;
+
+    if (cp->journal == NULL)
+    {
+        return -1;
+    }
+
+    va_start(args, fmt);
+    ret = vfprintf(cp->journal, fmt, args);
+    va_end(args);
+
+    if (ret < 0 || hb_fsync(cp->journal))
+    {
+        hb_error("checkpoint: failed to write %s", cp->journal_path);
+        fclose(cp->journal);
+        cp->journal = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void remove_parts(hb_job_t *job, int first)
+{
+    hb_stat_t sb;
+
+    for (int ii = first; ; ii++)
+    {
+        char *name = part_name(job, ii);
+        if (hb_stat(name, &sb))
+        {
+            free(name);
+            break;
+        }
+        hb_unlink(name);
+        free(name);
+    }
+}
+
+static void checkpoint_free(hb_checkpoint_t **_cp)
+{
+    hb_checkpoint_t *cp = *_cp;
+
+    if (cp == NULL)
+    {
+        return;
+    }
+    if (cp->journal != NULL)
+    {
+        fclose(cp->journal);
+    }
+    free(cp->journal_path);
+    free(cp->part_path);
+    free(cp->part_start);
+    free(cp->chapters);
+    free(cp);
+    *_cp = NULL;
+}
+
+static int checkpoint_supported(hb_job_t *job)
+{
+    if (job->pass_id != HB_PASS_ENCODE)
+    {
+        hb_log("checkpoint: not supported with multi-pass encoding");
+        return 0;
+    }
+    if (job->frame_to_start || job->frame_to_stop || job->start_at_preview)
+    {
+        hb_log("checkpoint: not supported with frame or preview ranges");
+        return 0;
+    }
+    // Time ranges are relative to the first chapter on DVD only
+    if (job->chapter_start > 1 && job->title->type != HB_DVD_TYPE)
+    {
+        hb_log("checkpoint: not supported when starting after chapter 1");
+        return 0;
+    }
+    for (int ii = 0; ii < hb_list_count(job->list_subtitle); ii++)
+    {
+        hb_subtitle_t *subtitle = hb_list_item(job->list_subtitle, ii);
+        if (subtitle->config.external_filename != NULL)
+        {
+            hb_log("checkpoint: not supported with external subtitle files");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int hb_checkpoint_init(hb_job_t *job)
+{
+    hb_checkpoint_t *cp;
+    FILE            *file;
+    int              resume = 0;
+
+    if (job->checkpoint <= 0 || !checkpoint_supported(job))
+    {
+        job->checkpoint = 0;
+        return 0;
+    }
+
+    cp = calloc(1, sizeof(hb_checkpoint_t));
+    if (cp == NULL)
+    {
+        hb_error("checkpoint: malloc failure");
+        goto fail;
+    }
+    cp->journal_path = hb_strdup_printf("%s.checkpoint", job->file);
+    cp->fingerprint  = job_fingerprint(job);
+    cp->interval     = (int64_t)job->checkpoint * 90000;
+    cp->commit_part  = -1;
+
+    file = hb_fopen(cp->journal_path, "r");
+    if (file != NULL)
+    {
+        resume = journal_replay(cp, file) == 0 && cp->commit_part >= 0;
+        fclose(file);
+    }
+
+    if (resume)
+    {
+        // Cut the uncommitted tail off the last good part
+        char *name = part_name(job, cp->commit_part);
+        file = hb_fopen(name, "r+b");
+        if (file == NULL || hb_ftruncate(file, cp->commit_size))
+        {
+            hb_log("checkpoint: cannot truncate %s, starting over", name);
+            resume = 0;
+        }
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+        free(name);
+    }
+
+    if (resume)
+    {
+        cp->part = cp->commit_part + 1;
+        remove_parts(job, cp->part);
+        set_part_start(cp, cp->part, cp->commit_pts);
+
+        hb_log("checkpoint: resuming at %"PRId64" ms in part %d",
+               cp->commit_pts / 90, cp->part);
+        job->pts_to_start += cp->commit_pts;
+        if (job->pts_to_stop)
+        {
+            job->pts_to_stop = MAX(1, job->pts_to_stop - cp->commit_pts);
+        }
+
+        cp->journal = hb_fopen(cp->journal_path, "r+");
+        if (cp->journal == NULL ||
+            hb_ftruncate(cp->journal, cp->journal_size) ||
+            fseek(cp->journal, 0, SEEK_END) ||
+            journal_write(cp, "part %d %"PRId64"\n",
+                          cp->part, cp->commit_pts))
+        {
+            hb_error("checkpoint: cannot append to %s", cp->journal_path);
+            goto fail;
+        }
+    }
+    else
+    {
+        remove_parts(job, 0);
+        cp->part          = 0;
+        cp->part_count    = 0;
+        cp->chapter_count = 0;
+        cp->commit_part   = -1;
+        set_part_start(cp, 0, 0);
+
+        cp->journal = hb_fopen(cp->journal_path, "w");
+        if (cp->journal == NULL ||
+            journal_write(cp, "HandBrake checkpoint %d\njob %08"PRIx32"\n"
+                              "part 0 0\n",
+                          CHECKPOINT_VERSION, cp->fingerprint))
+        {
+            hb_error("checkpoint: cannot create %s", cp->journal_path);
+            goto fail;
+        }
+    }
+
+    cp->part_path = part_name(job, cp->part);
+    cp->next      = cp->interval;
+    job->checkpoint_state = cp;
+
+    return 0;
+
+fail:
+    // Encode without checkpoints rather than not at all
+    checkpoint_free(&cp);
+    job->checkpoint = 0;
+    return -1;
+}
+
+const char * hb_checkpoint_part_path(hb_checkpoint_t *cp)
+{
+    return cp->part_path;
+}
+
+void hb_checkpoint_video(hb_checkpoint_t *cp, hb_buffer_t *buf)
+{
+    if (buf->s.frametype == HB_FRAME_IDR)
+    {
+        cp->idr = 1;
+    }
+    if (buf->s.new_chap > 0)
+    {
+        int64_t start = cp->part_start[cp->part] + buf->s.start;
+
+        // A resumed run starts inside a chapter that is already known
+        if (cp->chapter_count > 0 &&
+            cp->chapters[cp->chapter_count - 1].index == buf->s.new_chap)
+        {
+            return;
+        }
+        if (add_chapter(cp, buf->s.new_chap, start) == 0)
+        {
+            journal_write(cp, "chapter %d %"PRId64"\n", buf->s.new_chap, start);
+        }
+    }
+}
+
+int hb_checkpoint_due(hb_checkpoint_t *cp, hb_buffer_t *buf)
+{
+    // Decoding from this frame must not need earlier frames.  Encoders
+    // that label IDR frames may also emit open-GOP I frames as keyframes.
+    if (!(buf->s.flags & HB_FLAG_FRAMETYPE_KEY) ||
+        (cp->idr && buf->s.frametype != HB_FRAME_IDR))
+    {
+        return 0;
+    }
+    return cp->journal != NULL && buf->s.start >= cp->next;
+}
+
+void hb_checkpoint_commit(hb_checkpoint_t *cp, int64_t start, int64_t size)
+{
+    int64_t pts = cp->part_start[cp->part] + start;
+
+    if (journal_write(cp, "commit %d %"PRId64" %"PRId64"\n",
+                      cp->part, pts, size) == 0)
+    {
+        hb_deep_log(2, "checkpoint: committed %"PRId64" ms, %"PRId64" bytes",
+                    pts / 90, size);
+    }
+
+    cp->next = start + cp->interval;
+}
+
+static const char * join_options(hb_job_t *job, AVDictionary **opts)
+{
+    switch (job->mux)
+    {
+        case HB_MUX_AV_MP4:
+            av_dict_set(opts, "brand", "mp42", 0);
+            av_dict_set(opts, "strict", "experimental", 0);
+            av_dict_set(opts, "movflags", job->optimize ?
+                        "faststart+disable_chpl+write_colr" :
+                        "+disable_chpl+write_colr", 0);
+            return job->ipod_atom ? "ipod" : "mp4";
+        case HB_MUX_AV_MKV:
+            av_dict_set(opts, "default_mode", "passthrough", 0);
+            return "matroska";
+        case HB_MUX_AV_WEBM:
+            av_dict_set(opts, "default_mode", "passthrough", 0);
+            return "webm";
+        default:
+            return NULL;
+    }
+}
+
+static void join_progress(hb_job_t *job, int64_t done, int64_t total)
+{
+    hb_state_t state;
+
+    hb_get_state2(job->h, &state);
+    state.state = HB_STATE_MUXING;
+    state.param.muxing.progress = total > 0 ? (float)done / total : 0;
+    hb_set_state(job->h, &state);
+}
+
+static int join_add_chapters(hb_job_t *job, hb_checkpoint_t *cp,
+                             AVFormatContext *oc, int64_t duration)
+{
+    AVRational tb = {1, 90000};
+    AVStream  *st = oc->streams[0];
+
+    oc->chapters = av_calloc(cp->chapter_count, sizeof(AVChapter*));
+    if (oc->chapters == NULL)
+    {
+        hb_error("checkpoint: chapter array malloc failure");
+        return -1;
+    }
+    for (int ii = 0; ii < cp->chapter_count; ii++)
+    {
+        hb_chapter_t *chapter;
+        AVChapter    *chap;
+        char          title[1024];
+
+        int64_t start = av_rescale_q(cp->chapters[ii].start, tb, st->time_base);
+        int64_t end   = ii + 1 < cp->chapter_count ?
+            av_rescale_q(cp->chapters[ii + 1].start, tb, st->time_base) :
+            duration;
+
+        // Same rule as the muxer, a last chapter under 1.5 seconds is dropped
+        if (ii + 1 == cp->chapter_count &&
+            av_rescale_q(end - start, st->time_base, tb) <= 135000)
+        {
+            break;
+        }
+
+        chap = av_mallocz(sizeof(AVChapter));
+        if (chap == NULL)
+        {
+            hb_error("checkpoint: chapter malloc failure");
+            return -1;
+        }
+        oc->chapters[oc->nb_chapters++] = chap;
+
+        chapter = hb_list_item(job->list_chapter, cp->chapters[ii].index - 1);
+        if (chapter != NULL && chapter->title != NULL)
+        {
+            snprintf(title, sizeof(title), "%s", chapter->title);
+        }
+        else
+        {
+            snprintf(title, sizeof(title), "Chapter %d", cp->chapters[ii].index);
+        }
+
+        chap->id        = ii + 1;
+        chap->time_base = st->time_base;
+        chap->start     = start;
+        chap->end       = end;
+        av_dict_set(&chap->metadata, "title", title, 0);
+    }
+    return 0;
+}
+
+static int join_streams(AVFormatContext *oc, AVFormatContext *ic,
+                        const char *name)
+{
+    if (oc->nb_streams == 0)
+    {
+        for (int ii = 0; ii < ic->nb_streams; ii++)
+        {
+            AVStream *ist = ic->streams[ii];
+            AVStream *ost = avformat_new_stream(oc, NULL);
+
+            if (ost == NULL ||
+                avcodec_parameters_copy(ost->codecpar, ist->codecpar) < 0)
+            {
+                hb_error("checkpoint: could not initialize stream %d", ii);
+                return -1;
+            }
+            ost->codecpar->codec_tag = 0;
+            ost->time_base           = ist->time_base;
+            ost->disposition         = ist->disposition;
+            ost->sample_aspect_ratio = ist->sample_aspect_ratio;
+            ost->avg_frame_rate      = ist->avg_frame_rate;
+            av_dict_copy(&ost->metadata, ist->metadata, 0);
+        }
+        av_dict_copy(&oc->metadata, ic->metadata, 0);
+        return 0;
+    }
+
+    // Every run must have produced the same streams with the same setup
+    if (ic->nb_streams != oc->nb_streams)
+    {
+        hb_error("checkpoint: %s has %d streams, expected %d",
+                 name, ic->nb_streams, oc->nb_streams);
+        return -1;
+    }
+    for (int ii = 0; ii < ic->nb_streams; ii++)
+    {
+        AVCodecParameters *in  = ic->streams[ii]->codecpar;
+        AVCodecParameters *out = oc->streams[ii]->codecpar;
+
+        if (in->codec_id != out->codec_id ||
+            in->extradata_size != out->extradata_size ||
+            (in->extradata_size > 0 &&
+             memcmp(in->extradata, out->extradata, in->extradata_size)))
+        {
+            hb_error("checkpoint: stream %d of %s does not match the first part",
+                     ii, name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int join_parts(hb_job_t *job, hb_checkpoint_t *cp)
+{
+    AVFormatContext *oc = NULL, *ic = NULL;
+    AVDictionary    *av_opts = NULL;
+    AVPacket        *pkt = NULL;
+    AVRational       tb = {1, 90000};
+    int64_t         *last_dts = NULL, *last_end = NULL;
+    int64_t          total = 0, done = 0, reported = 0;
+    const char      *muxer_name;
+    hb_stat_t        sb;
+    int              ret;
+
+    muxer_name = join_options(job, &av_opts);
+    if (muxer_name == NULL)
+    {
+        hb_error("checkpoint: invalid mux %x", job->mux);
+        goto fail;
+    }
+    ret = avformat_alloc_output_context2(&oc, NULL, muxer_name, job->file);
+    if (ret < 0)
+    {
+        hb_error("checkpoint: could not initialize avformat context");
+        goto fail;
+    }
+    pkt = av_packet_alloc();
+    if (pkt == NULL)
+    {
+        hb_error("checkpoint: packet malloc failure");
+        goto fail;
+    }
+
+    // Progress is measured in bytes read from the parts
+    for (int part = 0; part < cp->part_count; part++)
+    {
+        char *name = part_name(job, part);
+        if (!hb_stat(name, &sb))
+        {
+            total += sb.st_size;
+        }
+        free(name);
+    }
+    join_progress(job, 0, total);
+
+    for (int part = 0; part < cp->part_count; part++)
+    {
+        char *name = part_name(job, part);
+
+        ret = avformat_open_input(&ic, name, NULL, NULL);
+        if (ret < 0)
+        {
+            hb_error("checkpoint: could not open %s, errno %d", name, ret);
+            free(name);
+            goto fail;
+        }
+        ret = join_streams(oc, ic, name);
+        free(name);
+        if (ret < 0)
+        {
+            goto fail;
+        }
+
+        if (part == 0)
+        {
+            last_dts = av_malloc_array(oc->nb_streams, sizeof(int64_t));
+            last_end = av_malloc_array(oc->nb_streams, sizeof(int64_t));
+            if (last_dts == NULL || last_end == NULL)
+            {
+                hb_error("checkpoint: malloc failure");
+                goto fail;
+            }
+            for (int ii = 0; ii < oc->nb_streams; ii++)
+            {
+                last_dts[ii] = last_end[ii] = AV_NOPTS_VALUE;
+            }
+            ret = avio_open2(&oc->pb, job->file, AVIO_FLAG_WRITE, NULL, NULL);
+            if (ret < 0)
+            {
+                hb_error("checkpoint: avio_open2 failed, errno %d", ret);
+                goto fail;
+            }
+            ret = avformat_write_header(oc, &av_opts);
+            if (ret < 0)
+            {
+                hb_error("checkpoint: failed to write header, errno %d", ret);
+                goto fail;
+            }
+        }
+
+        while (av_read_frame(ic, pkt) >= 0)
+        {
+            int       index = pkt->stream_index;
+            AVStream *ost   = oc->streams[index];
+            int64_t   offset;
+
+            av_packet_rescale_ts(pkt, ic->streams[index]->time_base,
+                                 ost->time_base);
+            offset = av_rescale_q(cp->part_start[part], tb, ost->time_base);
+            if (pkt->pts != AV_NOPTS_VALUE)
+            {
+                pkt->pts += offset;
+            }
+            if (pkt->dts != AV_NOPTS_VALUE)
+            {
+                pkt->dts += offset;
+            }
+
+            if (ost->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+            {
+                // Reordering delay can make the first dts of a part
+                // collide with the tail of the previous one
+                if (pkt->dts != AV_NOPTS_VALUE &&
+                    last_dts[index] != AV_NOPTS_VALUE &&
+                    pkt->dts <= last_dts[index])
+                {
+                    pkt->dts = last_dts[index] + 1;
+                    if (pkt->pts != AV_NOPTS_VALUE && pkt->pts < pkt->dts)
+                    {
+                        pkt->pts = pkt->dts;
+                    }
+                }
+            }
+            else if (pkt->pts != AV_NOPTS_VALUE &&
+                     last_end[index] != AV_NOPTS_VALUE &&
+                     pkt->pts < last_end[index])
+            {
+                // The previous run already wrote this span
+                av_packet_unref(pkt);
+                continue;
+            }
+
+            if (pkt->dts != AV_NOPTS_VALUE)
+            {
+                last_dts[index] = pkt->dts;
+            }
+            if (pkt->pts != AV_NOPTS_VALUE &&
+                (last_end[index] == AV_NOPTS_VALUE ||
+                 pkt->pts + pkt->duration > last_end[index]))
+            {
+                last_end[index] = pkt->pts + pkt->duration;
+            }
+
+            ret = av_interleaved_write_frame(oc, pkt);
+            if (ret < 0)
+            {
+                hb_error("checkpoint: failed to write frame, errno %d", ret);
+                goto fail;
+            }
+
+            if (done + avio_tell(ic->pb) - reported > total / 100)
+            {
+                reported = done + avio_tell(ic->pb);
+                join_progress(job, reported, total);
+            }
+        }
+        done += avio_size(ic->pb) > 0 ? avio_size(ic->pb) : 0;
+        avformat_close_input(&ic);
+    }
+
+    // The muxers take chapters up to the trailer, and only now is the
+    // end of the last one known
+    if (job->chapter_markers && cp->chapter_count > 0 &&
+        join_add_chapters(job, cp, oc, last_end[0]) < 0)
+    {
+        goto fail;
+    }
+
+    ret = av_write_trailer(oc);
+    avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    av_packet_free(&pkt);
+    av_dict_free(&av_opts);
+    av_free(last_dts);
+    av_free(last_end);
+
+    return ret < 0 ? -1 : 0;
+
+fail:
+    avformat_close_input(&ic);
+    if (oc != NULL)
+    {
+        avio_closep(&oc->pb);
+        avformat_free_context(oc);
+    }
+    av_packet_free(&pkt);
+    av_dict_free(&av_opts);
+    av_free(last_dts);
+    av_free(last_end);
+
+    return -1;
+}
+
+int hb_checkpoint_join(hb_job_t *job)
+{
+    hb_checkpoint_t *cp = job->checkpoint_state;
+    int              ret;
+
+    if (cp == NULL)
+    {
+        return 0;
+    }
+
+    // A part written in one run is already a complete file.  A
+    // fragmented MP4 only needs the remux for faststart and for
+    // chapters, which fragmented MP4 can't carry.
+    if (cp->part_count == 1 &&
+        (job->mux != HB_MUX_AV_MP4 ||
+         (!job->optimize &&
+          (!job->chapter_markers || cp->chapter_count == 0))))
+    {
+        ret = hb_rename(cp->part_path, job->file);
+    }
+    else
+    {
+        hb_log("checkpoint: joining %d part(s) into %s",
+               cp->part_count, job->file);
+        ret = join_parts(job, cp);
+    }
+
+    if (ret < 0)
+    {
+        // The parts and journal are left in place, nothing is lost
+        hb_error("checkpoint: could not create %s", job->file);
+        return -1;
+    }
+
+    remove_parts(job, 0);
+    if (cp->journal != NULL)
+    {
+        fclose(cp->journal);
+        cp->journal = NULL;
+    }
+    hb_unlink(cp->journal_path);
+
+    return 0;
+}
+
+void hb_checkpoint_close(hb_job_t *job)
+{
+    checkpoint_free(&job->checkpoint_state);
+}
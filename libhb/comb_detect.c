@@ -100,9 +100,20 @@ struct hb_filter_private_s
     void (*detect_combed_segment)(hb_filter_private_t *pv,
                                   int segment_start, int segment_stop);
     void (*apply_mask)(hb_filter_private_t *pv, hb_buffer_t *b);
+    void (*check_combing_mask)(hb_filter_private_t *pv, int segment,
+                               int start, int stop);
+    void (*check_filtered_combing_mask)(hb_filter_private_t *pv, int segment,
+                                        int start, int stop);
+    void (*mask_filter_work)(void *thread_args_v);
+    void (*mask_erode_work)(void *thread_args_v);
+    void (*mask_dilate_work)(void *thread_args_v);
 
     hb_buffer_list_t   out_list;
 
+    // Motion metric for vfr, measured in the comb detection pass
+    hb_motion_metric_object_t *metric;
+    uint64_t          *motion_sum;
+
     // Filter statistics
     int                comb_heavy;
     int                comb_light;
@@ -147,7 +158,7 @@ hb_filter_object_t hb_filter_comb_detect =
 #undef BIT_DEPTH
 
 #if defined (__aarch64__)
-static void check_filtered_combing_mask(hb_filter_private_t *pv, int segment, int start, int stop)
+static void check_filtered_combing_mask_neon(hb_filter_private_t *pv, int segment, int start, int stop)
 {
     // Go through the mask in X*Y blocks. If any of these windows
     // have threshold or more combed pixels, consider the whole
@@ -216,7 +227,8 @@ static void check_filtered_combing_mask(hb_filter_private_t *pv, int segment, in
         }
     }
 }
-#else
+#endif
+
 static void check_filtered_combing_mask(hb_filter_private_t *pv, int segment, int start, int stop)
 {
     // Go through the mask in X*Y blocks. If any of these windows
@@ -273,10 +285,9 @@ static void check_filtered_combing_mask(hb_filter_private_t *pv, int segment, in
         }
     }
 }
-#endif
 
 #if defined(__aarch64__)
-static void check_combing_mask(hb_filter_private_t *pv, int segment, int start, int stop)
+static void check_combing_mask_neon(hb_filter_private_t *pv, int segment, int start, int stop)
 {
     // Go through the mask in X*Y blocks. If any of these windows
     // have threshold or more combed pixels, consider the whole
@@ -379,7 +390,8 @@ static void check_combing_mask(hb_filter_private_t *pv, int segment, int start,
         }
     }
 }
-#else
+#endif
+
 static void check_combing_mask(hb_filter_private_t *pv, int segment, int start, int stop)
 {
     // Go through the mask in X*Y blocks. If any of these windows
@@ -451,10 +463,9 @@ static void check_combing_mask(hb_filter_private_t *pv, int segment, int start,
         }
     }
 }
-#endif
 
 #if defined(__aarch64__)
-static void mask_dilate_work(void *thread_args_v)
+static void mask_dilate_work_neon(void *thread_args_v)
 {
     comb_detect_thread_arg_t *thread_args = thread_args_v;
     hb_filter_private_t *pv = thread_args->pv;
@@ -551,7 +562,8 @@ static void mask_dilate_work(void *thread_args_v)
         dst += stride;
     }
 }
-#else
+#endif
+
 static void mask_dilate_work(void *thread_args_v)
 {
     comb_detect_thread_arg_t *thread_args = thread_args_v;
@@ -619,10 +631,9 @@ static void mask_dilate_work(void *thread_args_v)
         dst += stride;
     }
 }
-#endif
 
 #if defined (__aarch64__)
-static void mask_erode_work(void *thread_args_v)
+static void mask_erode_work_neon(void *thread_args_v)
 {
     comb_detect_thread_arg_t *thread_args = thread_args_v;
     hb_filter_private_t *pv = thread_args->pv;
@@ -721,7 +732,8 @@ static void mask_erode_work(void *thread_args_v)
         dst += stride;
     }
 }
-#else
+#endif
+
 static void mask_erode_work(void *thread_args_v)
 {
     comb_detect_thread_arg_t *thread_args = thread_args_v;
@@ -789,10 +801,9 @@ static void mask_erode_work(void *thread_args_v)
         dst += stride;
     }
 }
-#endif
 
 #if defined (__aarch64__)
-static void mask_filter_work(void *thread_args_v)
+static void mask_filter_work_neon(void *thread_args_v)
 {
     comb_detect_thread_arg_t *thread_args = thread_args_v;
     hb_filter_private_t *pv = thread_args->pv;
@@ -896,7 +907,8 @@ static void mask_filter_work(void *thread_args_v)
         }
     }
 }
-#else
+#endif
+
 static void mask_filter_work(void *thread_args_v)
 {
     comb_detect_thread_arg_t *thread_args = thread_args_v;
@@ -963,7 +975,6 @@ static void mask_filter_work(void *thread_args_v)
         dst += stride;
     }
 }
-#endif
 
 static void comb_detect_check_work(void *thread_args_v)
 {
@@ -976,11 +987,11 @@ static void comb_detect_check_work(void *thread_args_v)
 
     if (pv->mode & MODE_FILTER)
     {
-        check_filtered_combing_mask(pv, segment, segment_start, segment_stop);
+        pv->check_filtered_combing_mask(pv, segment, segment_start, segment_stop);
     }
     else
     {
-        check_combing_mask(pv, segment, segment_start, segment_stop);
+        pv->check_combing_mask(pv, segment, segment_start, segment_stop);
     }
 }
 
@@ -1001,6 +1012,15 @@ static void comb_detect_filter_work(void *thread_args_v)
     {
         pv->detect_combed_segment(pv, segment_start, segment_stop);
     }
+
+    // The rows of prev and cur were just read, measure motion while
+    // they are still in cache
+    if (pv->metric != NULL)
+    {
+        pv->motion_sum[thread_args->arg.segment] =
+            hb_motion_metric_rows(pv->metric, pv->ref[0], pv->ref[1],
+                                  segment_start, segment_stop);
+    }
 }
 
 static void store_ref(hb_filter_private_t *pv, hb_buffer_t *b)
@@ -1070,6 +1090,27 @@ static int comb_segmenter(hb_filter_private_t *pv)
     return check_combing_results(pv);
 }
 
+// vfr measures motion between frames when it drops frames to
+// reach a constant or peak rate
+static int vfr_uses_motion(hb_filter_init_t *init)
+{
+    if (init->job == NULL || init->hw_pix_fmt != AV_PIX_FMT_NONE)
+    {
+        return 0;
+    }
+    for (int ii = 0; ii < hb_list_count(init->job->list_filter); ii++)
+    {
+        hb_filter_object_t *filter = hb_list_item(init->job->list_filter, ii);
+        if (filter->id == HB_FILTER_VFR)
+        {
+            int cfr = init->cfr;
+            hb_dict_extract_int(&cfr, filter->settings, "mode");
+            return cfr != 0;
+        }
+    }
+    return 0;
+}
+
 static void build_gamma_lut(hb_filter_private_t *pv)
 {
     const int max = pv->max_value;
@@ -1160,7 +1201,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
     pv->comb32detect_min = pv->depth >= 8 ? 10 << (pv->depth - 8) : 10;
     pv->comb32detect_max = pv->depth >= 8 ? 15 << (pv->depth - 8) : 15;
 
-    pv->cpu_count = hb_get_cpu_count();
+    pv->cpu_count = hb_get_thread_count();
 
     // Make segment sizes an even number of lines
     int height = hb_image_height(init->pix_fmt, init->geometry.height, 0);
@@ -1196,6 +1237,33 @@ static int comb_detect_init(hb_filter_object_t *filter,
             break;
     }
 
+    pv->check_combing_mask          = check_combing_mask;
+    pv->check_filtered_combing_mask = check_filtered_combing_mask;
+    pv->mask_filter_work            = mask_filter_work;
+    pv->mask_erode_work             = mask_erode_work;
+    pv->mask_dilate_work            = mask_dilate_work;
+#if defined(__aarch64__)
+    if (!hb_get_reference_kernels())
+    {
+        pv->check_combing_mask          = check_combing_mask_neon;
+        pv->check_filtered_combing_mask = check_filtered_combing_mask_neon;
+        pv->mask_filter_work            = mask_filter_work_neon;
+        pv->mask_erode_work             = mask_erode_work_neon;
+        pv->mask_dilate_work            = mask_dilate_work_neon;
+    }
+#endif
+
+    if (vfr_uses_motion(init))
+    {
+        pv->metric     = hb_motion_metric_init(init);
+        pv->motion_sum = calloc(pv->cpu_count, sizeof(uint64_t));
+        if (pv->metric == NULL || pv->motion_sum == NULL)
+        {
+            hb_error("comb_detect: motion metric init failed");
+            return -1;
+        }
+    }
+
     /*
      * Create comb detection taskset.
      */
@@ -1303,7 +1371,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
     if (pv->mode & MODE_FILTER)
     {
         if (taskset_init(&pv->mask_filter_taskset, "mask_filter_segment", pv->cpu_count,
-                         sizeof(comb_detect_thread_arg_t), mask_filter_work) == 0)
+                         sizeof(comb_detect_thread_arg_t), pv->mask_filter_work) == 0)
         {
             hb_error( "mask filter could not initialize taskset" );
             return -1;
@@ -1347,7 +1415,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
         if (pv->filter_mode == FILTER_ERODE_DILATE)
         {
             if (taskset_init(&pv->mask_erode_taskset, "mask_erode_segment", pv->cpu_count,
-                             sizeof(comb_detect_thread_arg_t), mask_erode_work) == 0)
+                             sizeof(comb_detect_thread_arg_t), pv->mask_erode_work) == 0)
             {
                 hb_error("mask erode could not initialize taskset");
                 return -1;
@@ -1389,7 +1457,7 @@ static int comb_detect_init(hb_filter_object_t *filter,
             }
 
             if (taskset_init(&pv->mask_dilate_taskset, "mask_dilate_segment", pv->cpu_count,
-                             sizeof(comb_detect_thread_arg_t), mask_dilate_work) == 0)
+                             sizeof(comb_detect_thread_arg_t), pv->mask_dilate_work) == 0)
             {
                 hb_error("mask dilate could not initialize taskset");
                 return -1;
@@ -1476,6 +1544,8 @@ static void comb_detect_close(hb_filter_object_t *filter)
     hb_buffer_close(&pv->mask_filtered);
     hb_buffer_close(&pv->mask_temp);
 
+    hb_motion_metric_close(&pv->metric);
+    free(pv->motion_sum);
     free(pv->gamma_lut);
     free(pv->block_score);
     free(pv);
@@ -1514,6 +1584,18 @@ static void process_frame(hb_filter_private_t *pv)
     {
         pv->ref_used[1] = 1;
         pv->ref[1]->s.combed = combed;
+        if (pv->metric != NULL)
+        {
+            uint64_t sum = 0;
+            for (int ii = 0; ii < pv->cpu_count; ii++)
+            {
+                sum += pv->motion_sum[ii];
+            }
+            pv->ref[1]->s.analysis.flags     |= HB_ANALYSIS_MOTION;
+            pv->ref[1]->s.analysis.motion     =
+                hb_motion_metric_finish(pv->metric, pv->ref[1], sum);
+            pv->ref[1]->s.analysis.motion_ref = pv->ref[0]->s.start;
+        }
         hb_buffer_list_append(&pv->out_list, pv->ref[1]);
     }
 
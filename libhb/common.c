@@ -90,6 +90,7 @@ enum
     HB_GID_VCODEC_AV1_VCE,
     HB_GID_VCODEC_AV1_MF,
     HB_GID_VCODEC_FFV1,
+    HB_GID_VCODEC_PASSTHRU,
     HB_GID_ACODEC_ALAC,
     HB_GID_ACODEC_ALAC_PASS,
     HB_GID_ACODEC_AAC,
@@ -327,6 +328,7 @@ hb_encoder_internal_t hb_video_encoders[]  =
     { { "VP9",                         "VP9",              "VP9 (libvpx)",                   HB_VCODEC_FFMPEG_VP9,        HB_MUX_MASK_MP4|HB_MUX_MASK_WEBM|HB_MUX_MASK_MKV, }, NULL, 0, 1, HB_GID_VCODEC_VP9,        },
     { { "VP9 10-bit",                  "VP9_10bit",        "VP9 10-bit (libvpx)",            HB_VCODEC_FFMPEG_VP9_10BIT,  HB_MUX_MASK_MP4|HB_MUX_MASK_WEBM|HB_MUX_MASK_MKV, }, NULL, 0, 1, HB_GID_VCODEC_VP9,        },
     { { "Theora",                      "theora",           "Theora (libtheora)",             HB_VCODEC_THEORA,                                             HB_MUX_MASK_MKV, }, NULL, 0, 1, HB_GID_VCODEC_THEORA,     },
+    { { "Passthru",                    "copy",             "Video Passthru",                 HB_VCODEC_PASSTHRU,                           HB_MUX_MASK_MP4|HB_MUX_MASK_MKV, }, NULL, 0, 1, HB_GID_VCODEC_PASSTHRU,   },
 };
 int hb_video_encoders_count = sizeof(hb_video_encoders) / sizeof(hb_video_encoders[0]);
 static int hb_video_encoder_is_enabled(int encoder, int disable_hardware)
@@ -405,6 +407,7 @@ static int hb_video_encoder_is_enabled(int encoder, int disable_hardware)
         case HB_VCODEC_SVT_AV1:
         case HB_VCODEC_SVT_AV1_10BIT:
         case HB_VCODEC_FFMPEG_FFV1:
+        case HB_VCODEC_PASSTHRU:
             return 1;
 
 #if HB_PROJECT_FEATURE_X265
@@ -4583,6 +4586,9 @@ static void job_setup(hb_job_t * job, hb_title_t * title)
     job->vquality   = HB_INVALID_VIDEO_QUALITY;
     job->vbitrate   = 1000;
     job->multipass  = 0;
+    job->quality_metric          = HB_QUALITY_METRIC_SSIM;
+    job->quality_samples         = 4;
+    job->quality_sample_duration = 10;
     job->pass_id    = HB_PASS_ENCODE;
     job->vrate      = title->vrate;
 
@@ -4668,6 +4674,8 @@ static void job_clean( hb_job_t * job )
         job->encoder_level = NULL;
         free(job->file);
         job->file = NULL;
+        free(job->frame_hash_file);
+        job->frame_hash_file = NULL;
 
         hb_data_close(&job->extradata);
 
@@ -4845,6 +4853,14 @@ void hb_job_set_file(hb_job_t *job, const char *file)
     }
 }
 
+void hb_job_set_frame_hash_file(hb_job_t *job, const char *file)
+{
+    if (job != NULL)
+    {
+        hb_update_str(&job->frame_hash_file, file);
+    }
+}
+
 hb_filter_object_t * hb_filter_copy( hb_filter_object_t * filter )
 {
     if( filter == NULL )
@@ -5637,6 +5653,7 @@ void hb_audio_config_init(hb_audio_config_t * audiocfg)
     audiocfg->out.mixdown = HB_INVALID_AMIXDOWN;
     audiocfg->out.dynamic_range_compression = 0;
     audiocfg->out.gain = 0;
+    audiocfg->out.loudness_target = 0;
     audiocfg->out.normalize_mix_level = 0;
     audiocfg->out.dither_method = hb_audio_dither_get_default();
     audiocfg->out.name = NULL;
@@ -7019,6 +7036,7 @@ static int pix_fmt_is_supported(hb_job_t *job, int pix_fmt)
             case HB_FILTER_DECOMB:
             case HB_FILTER_YADIF:
             case HB_FILTER_BWDIF:
+            case HB_FILTER_DEBLOCK:
             case HB_FILTER_DENOISE:
             case HB_FILTER_NLMEANS:
             case HB_FILTER_CHROMA_SMOOTH:
@@ -7,9 +7,18 @@
    For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
  */
 
-#include "handbrake/common.h"
+#include "handbrake/handbrake.h"
 #include "handbrake/avfilter_priv.h"
 #include "handbrake/hbffmpeg.h"
+#include "handbrake/taskset.h"
+
+#if defined(ARCH_X86)
+#include <emmintrin.h>
+#include "libavutil/cpu.h"
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 #if HB_PROJECT_FEATURE_QSV && (defined( _WIN32 ) || defined( __MINGW32__ ))
 #include "handbrake/qsv_common.h"
 #endif
@@ -17,11 +26,76 @@
 static int crop_scale_init(hb_filter_object_t * filter,
                            hb_filter_init_t * init);
 static hb_filter_info_t * crop_scale_info( hb_filter_object_t * filter );
+static void crop_scale_close(hb_filter_object_t * filter);
+static int  crop_scale_native_work(hb_filter_object_t * filter,
+                                   hb_buffer_t ** buf_in,
+                                   hb_buffer_t ** buf_out);
+
+typedef struct hb_crop_scale_pad_s hb_crop_scale_pad_t;
+
+typedef void (*downscale_box_f)(const uint8_t * src, int src_stride,
+                                uint8_t * dst, int dst_stride,
+                                int width, int start, int stop);
+
+// Weights of the source samples that make up one output sample,
+// starting 'offset' samples before factor * x
+typedef struct
+{
+    int offset;
+    int count;
+    int shift;      // log2 of the sum of the taps
+    int taps[5];
+} downscale_taps_t;
+
+typedef struct
+{
+    taskset_thread_arg_t  arg;
+    hb_crop_scale_pad_t * fp;
+} crop_scale_thread_arg_t;
+
+struct hb_crop_scale_pad_s
+{
+    struct SwsContext * sws;
+    AVFrame           * src;
+    AVFrame           * dst;
+
+    // Integer ratio box downscale, used instead of swscale when
+    // factor > 0.  Slices of each plane are scaled in parallel.
+    int                 factor;
+    int                 threads;
+    taskset_t           taskset;
+    downscale_box_f     box;
+    const downscale_taps_t * taps_h;    // for chroma planes that are not
+    const downscale_taps_t * taps_v;    // centered, else NULL
+    hb_buffer_t       * src_buf;    // frame being scaled
+    hb_buffer_t       * dst_buf;
+
+    int                 pix_fmt;
+    int                 bps;
+    int                 log2_chroma_w;
+    int                 log2_chroma_h;
+
+    int                 crop[4];
+    int                 cropped_width;
+    int                 cropped_height;
+    int                 width;      // scaled picture size
+    int                 height;
+    int                 pad_width;  // padded frame size
+    int                 pad_height;
+    int                 x;          // position of the scaled picture
+    int                 y;          // within the padded frame
+    int                 color[3];
+    int                 padded;     // pad filter was fused
+};
 
 static const char crop_scale_template[] =
     "width=^"HB_INT_REG"$:height=^"HB_INT_REG"$:"
     "crop-top=^"HB_INT_REG"$:crop-bottom=^"HB_INT_REG"$:"
-    "crop-left=^"HB_INT_REG"$:crop-right=^"HB_INT_REG"$";
+    "crop-left=^"HB_INT_REG"$:crop-right=^"HB_INT_REG"$:"
+    "fast-downscale=^"HB_BOOL_REG"$";
+
+static void crop_scale_native_setup(hb_filter_object_t * filter);
+static void crop_scale_native_free(hb_crop_scale_pad_t ** fp);
 
 hb_filter_object_t hb_filter_crop_scale =
 {
@@ -32,7 +106,7 @@ hb_filter_object_t hb_filter_crop_scale =
     .settings          = NULL,
     .init              = crop_scale_init,
     .work              = hb_avfilter_null_work,
-    .close             = hb_avfilter_alias_close,
+    .close             = crop_scale_close,
     .info              = crop_scale_info,
     .settings_template = crop_scale_template,
 };
@@ -46,6 +120,8 @@ hb_filter_object_t hb_filter_crop_scale =
  *  crop-bottom - bottom crop margin
  *  crop-left   - left crop margin
  *  crop-right  - right crop margin
+ *  fast-downscale - allow a box filter instead of lanczos for exact
+ *                   2:1 and 4:1 downscales
  *
  */
 static int crop_scale_init(hb_filter_object_t * filter, hb_filter_init_t * init)
@@ -166,6 +242,13 @@ static int crop_scale_init(hb_filter_object_t * filter, hb_filter_init_t * init)
 
     pv->avfilters = avfilters;
 
+    int fast = 0;
+    hb_dict_extract_bool(&fast, settings, "fast-downscale");
+    if (fast)
+    {
+        crop_scale_native_setup(filter);
+    }
+
     return 0;
 }
 
@@ -200,12 +283,956 @@ static hb_filter_info_t * crop_scale_info( hb_filter_object_t * filter )
     int cropped_width  = pv->input.geometry.width - (left + right);
     int cropped_height = pv->input.geometry.height - (top + bottom);
 
-    info->human_readable_desc = hb_strdup_printf(
+    char * desc = hb_strdup_printf(
         "source: %d * %d, crop (%d/%d/%d/%d): %d * %d, scale: %d * %d",
         pv->input.geometry.width, pv->input.geometry.height,
         top, bottom, left, right,
         cropped_width, cropped_height, width, height);
 
+    hb_crop_scale_pad_t * fp = pv->native;
+    if (fp != NULL && fp->factor > 0)
+    {
+        char * tmp = hb_strdup_printf("%s (box %d:1)", desc, fp->factor);
+        free(desc);
+        desc = tmp;
+    }
+    if (fp != NULL && fp->padded)
+    {
+        char * tmp = hb_strdup_printf("%s, pad: %d * %d at %d, %d", desc,
+                                      fp->pad_width, fp->pad_height,
+                                      fp->x, fp->y);
+        free(desc);
+        desc = tmp;
+    }
+    info->human_readable_desc = desc;
+
     return info;
 }
 
+
+static void crop_scale_close(hb_filter_object_t * filter)
+{
+    hb_filter_private_t * pv = filter->private_data;
+
+    if (pv != NULL && pv->native != NULL)
+    {
+        crop_scale_native_free(&pv->native);
+    }
+    hb_avfilter_alias_close(filter);
+}
+
+/*
+ * Native crop/scale path.  It replaces the avfilter graph in two cases:
+ *
+ * - Exact 2:1 and 4:1 downscales when "fast-downscale" is set.  A box
+ *   filter is far cheaper than lanczos and each output sample is the
+ *   average of a factor * factor block, so slices of the picture are
+ *   scaled in parallel without any overlap.  Luma and centered chroma
+ *   use SSE2 or NEON kernels, co-sited chroma uses shifted taps.
+ * - Pad immediately follows crop/scale.  The avfilter graph would scale
+ *   into one frame and then copy it into a larger padded frame.  Instead
+ *   the padded frame is allocated here and the scaled picture is written
+ *   directly into its interior.  The pad filter becomes a no-op.
+ *
+ * Only software frames in planar YUV formats are handled here.  Anything
+ * else keeps using the avfilter graph.
+ */
+#define DEF_DOWNSCALE_BOX(nbits, factor, shift)                                    \
+static void downscale_box##factor##_row_##nbits(const uint8_t * row,                \
+                                                int src_stride,                     \
+                                                uint8_t * dst, int x, int width)    \
+{                                                                                   \
+    uint##nbits##_t * out = (uint##nbits##_t *)dst;                                 \
+    for (; x < width; x++)                                                          \
+    {                                                                               \
+        uint32_t sum = 0;                                                           \
+        for (int j = 0; j < factor; j++)                                            \
+        {                                                                           \
+            const uint##nbits##_t * in =                                            \
+                (const uint##nbits##_t *)(row + j * src_stride) + x * factor;       \
+            for (int i = 0; i < factor; i++)                                        \
+            {                                                                       \
+                sum += in[i];                                                       \
+            }                                                                       \
+        }                                                                           \
+        out[x] = (sum + (1 << (shift - 1))) >> shift;                               \
+    }                                                                               \
+}                                                                                   \
+                                                                                    \
+static void downscale_box##factor##_##nbits(const uint8_t * src, int src_stride,    \
+                                            uint8_t * dst, int dst_stride,          \
+                                            int width, int start, int stop)         \
+{                                                                                   \
+    for (int y = start; y < stop; y++)                                              \
+    {                                                                               \
+        downscale_box##factor##_row_##nbits(src + y * factor * src_stride,          \
+                                            src_stride, dst + y * dst_stride,       \
+                                            0, width);                              \
+    }                                                                               \
+}                                                                                   \
+
+DEF_DOWNSCALE_BOX(8, 2, 2)
+DEF_DOWNSCALE_BOX(8, 4, 4)
+DEF_DOWNSCALE_BOX(16, 2, 2)
+DEF_DOWNSCALE_BOX(16, 4, 4)
+
+#if defined(ARCH_X86)
+static void downscale_box2_8_sse2(const uint8_t * src, int src_stride,
+                                  uint8_t * dst, int dst_stride,
+                                  int width, int start, int stop)
+{
+    const __m128i mask  = _mm_set1_epi16(0x00ff);
+    const __m128i round = _mm_set1_epi16(2);
+
+    for (int y = start; y < stop; y++)
+    {
+        const uint8_t * r0  = src + y * 2 * src_stride;
+        const uint8_t * r1  = r0 + src_stride;
+        uint8_t       * out = dst + y * dst_stride;
+        int x;
+
+        for (x = 0; x + 8 <= width; x += 8)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(r0 + x * 2));
+            __m128i b = _mm_loadu_si128((const __m128i *)(r1 + x * 2));
+            __m128i sum;
+
+            sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, mask),
+                                              _mm_srli_epi16(a, 8)),
+                                _mm_add_epi16(_mm_and_si128(b, mask),
+                                              _mm_srli_epi16(b, 8)));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+            _mm_storel_epi64((__m128i *)(out + x), _mm_packus_epi16(sum, sum));
+        }
+        downscale_box2_row_8(r0, src_stride, out, x, width);
+    }
+}
+
+static void downscale_box4_8_sse2(const uint8_t * src, int src_stride,
+                                  uint8_t * dst, int dst_stride,
+                                  int width, int start, int stop)
+{
+    const __m128i mask  = _mm_set1_epi16(0x00ff);
+    const __m128i ones  = _mm_set1_epi16(1);
+    const __m128i round = _mm_set1_epi32(8);
+
+    for (int y = start; y < stop; y++)
+    {
+        const uint8_t * row = src + y * 4 * src_stride;
+        uint8_t       * out = dst + y * dst_stride;
+        int x;
+
+        for (x = 0; x + 4 <= width; x += 4)
+        {
+            __m128i sum = _mm_setzero_si128();
+            int32_t packed;
+
+            for (int j = 0; j < 4; j++)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i *)(row + j * src_stride + x * 4));
+                __m128i p = _mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(p, ones));
+            }
+            sum = _mm_srli_epi32(_mm_add_epi32(sum, round), 4);
+            sum = _mm_packs_epi32(sum, sum);
+            sum = _mm_packus_epi16(sum, sum);
+            packed = _mm_cvtsi128_si32(sum);
+            memcpy(out + x, &packed, sizeof(packed));
+        }
+        downscale_box4_row_8(row, src_stride, out, x, width);
+    }
+}
+
+// SSE2 has no unsigned 32 to 16 bit pack, bias into the signed range
+static inline __m128i pack_u32_u16(__m128i v)
+{
+    v = _mm_sub_epi32(v, _mm_set1_epi32(0x8000));
+    v = _mm_packs_epi32(v, v);
+    return _mm_xor_si128(v, _mm_set1_epi16((short)0x8000));
+}
+
+static void downscale_box2_16_sse2(const uint8_t * src, int src_stride,
+                                   uint8_t * dst, int dst_stride,
+                                   int width, int start, int stop)
+{
+    const __m128i mask  = _mm_set1_epi32(0xffff);
+    const __m128i round = _mm_set1_epi32(2);
+
+    for (int y = start; y < stop; y++)
+    {
+        const uint8_t * r0  = src + y * 2 * src_stride;
+        const uint8_t * r1  = r0 + src_stride;
+        uint8_t       * out = dst + y * dst_stride;
+        int x;
+
+        for (x = 0; x + 4 <= width; x += 4)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(r0 + x * 4));
+            __m128i b = _mm_loadu_si128((const __m128i *)(r1 + x * 4));
+            __m128i sum;
+
+            sum = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(a, mask),
+                                              _mm_srli_epi32(a, 16)),
+                                _mm_add_epi32(_mm_and_si128(b, mask),
+                                              _mm_srli_epi32(b, 16)));
+            sum = _mm_srli_epi32(_mm_add_epi32(sum, round), 2);
+            _mm_storel_epi64((__m128i *)(out + x * 2), pack_u32_u16(sum));
+        }
+        downscale_box2_row_16(r0, src_stride, out, x, width);
+    }
+}
+
+static void downscale_box4_16_sse2(const uint8_t * src, int src_stride,
+                                   uint8_t * dst, int dst_stride,
+                                   int width, int start, int stop)
+{
+    const __m128i mask  = _mm_set1_epi32(0xffff);
+    const __m128i round = _mm_set1_epi32(8);
+
+    for (int y = start; y < stop; y++)
+    {
+        const uint8_t * row = src + y * 4 * src_stride;
+        uint8_t       * out = dst + y * dst_stride;
+        int x;
+
+        for (x = 0; x + 2 <= width; x += 2)
+        {
+            __m128i sum = _mm_setzero_si128();
+            int32_t packed;
+
+            for (int j = 0; j < 4; j++)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i *)(row + j * src_stride + x * 8));
+                sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_and_si128(a, mask),
+                                                       _mm_srli_epi32(a, 16)));
+            }
+            // Pair sums 0+1 and 2+3 end up in lanes 0 and 1
+            sum = _mm_add_epi32(sum, _mm_srli_epi64(sum, 32));
+            sum = _mm_shuffle_epi32(sum, _MM_SHUFFLE(3, 1, 2, 0));
+            sum = _mm_srli_epi32(_mm_add_epi32(sum, round), 4);
+            packed = _mm_cvtsi128_si32(pack_u32_u16(sum));
+            memcpy(out + x * 2, &packed, sizeof(packed));
+        }
+        downscale_box4_row_16(row, src_stride, out, x, width);
+    }
+}
+#endif // ARCH_X86
+
+#if defined(__aarch64__)
+static void downscale_box2_8_neon(const uint8_t * src, int src_stride,
+                                  uint8_t * dst, int dst_stride,
+                                  int width, int start, int stop)
+{
+    for (int y = start; y < stop; y++)
+    {
+        const uint8_t * r0  = src + y * 2 * src_stride;
+        const uint8_t * r1  = r0 + src_stride;
+        uint8_t       * out = dst + y * dst_stride;
+        int x;
+
+        for (x = 0; x + 8 <= width; x += 8)
+        {
+            uint16x8_t sum = vpaddlq_u8(vld1q_u8(r0 + x * 2));
+            sum = vpadalq_u8(sum, vld1q_u8(r1 + x * 2));
+            vst1_u8(out + x, vrshrn_n_u16(sum, 2));
+        }
+        downscale_box2_row_8(r0, src_stride, out, x, width);
+    }
+}
+
+static void downscale_box4_8_neon(const uint8_t * src, int src_stride,
+                                  uint8_t * dst, int dst_stride,
+                                  int width, int start, int stop)
+{
+    for (int y = start; y < stop; y++)
+    {
+        const uint8_t * row = src + y * 4 * src_stride;
+        uint8_t       * out = dst + y * dst_stride;
+        int x;
+
+        for (x = 0; x + 4 <= width; x += 4)
+        {
+            uint16x8_t sum = vpaddlq_u8(vld1q_u8(row + x * 4));
+            sum = vpadalq_u8(sum, vld1q_u8(row + src_stride     + x * 4));
+            sum = vpadalq_u8(sum, vld1q_u8(row + src_stride * 2 + x * 4));
+            sum = vpadalq_u8(sum, vld1q_u8(row + src_stride * 3 + x * 4));
+            uint16x4_t avg = vrshrn_n_u32(vpaddlq_u16(sum), 4);
+            uint8x8_t  res = vmovn_u16(vcombine_u16(avg, avg));
+            vst1_lane_u32((uint32_t *)(out + x), vreinterpret_u32_u8(res), 0);
+        }
+        downscale_box4_row_8(row, src_stride, out, x, width);
+    }
+}
+
+static void downscale_box2_16_neon(const uint8_t * src, int src_stride,
+                                   uint8_t * dst, int dst_stride,
+                                   int width, int start, int stop)
+{
+    for (int y = start; y < stop; y++)
+    {
+        const uint8_t * r0  = src + y * 2 * src_stride;
+        const uint8_t * r1  = r0 + src_stride;
+        uint8_t       * out = dst + y * dst_stride;
+        int x;
+
+        for (x = 0; x + 4 <= width; x += 4)
+        {
+            uint32x4_t sum = vpaddlq_u16(vld1q_u16((const uint16_t *)r0 + x * 2));
+            sum = vpadalq_u16(sum, vld1q_u16((const uint16_t *)r1 + x * 2));
+            vst1_u16((uint16_t *)out + x, vrshrn_n_u32(sum, 2));
+        }
+        downscale_box2_row_16(r0, src_stride, out, x, width);
+    }
+}
+
+static void downscale_box4_16_neon(const uint8_t * src, int src_stride,
+                                   uint8_t * dst, int dst_stride,
+                                   int width, int start, int stop)
+{
+    for (int y = start; y < stop; y++)
+    {
+        const uint8_t * row = src + y * 4 * src_stride;
+        uint8_t       * out = dst + y * dst_stride;
+        int x;
+
+        for (x = 0; x + 2 <= width; x += 2)
+        {
+            uint32x4_t sum = vdupq_n_u32(0);
+            for (int j = 0; j < 4; j++)
+            {
+                sum = vpadalq_u16(sum, vld1q_u16((const uint16_t *)(row + j * src_stride) + x * 4));
+            }
+            uint32x2_t pair = vpadd_u32(vget_low_u32(sum), vget_high_u32(sum));
+            uint16x4_t avg  = vrshrn_n_u32(vcombine_u32(pair, pair), 4);
+            vst1_lane_u32((uint32_t *)((uint16_t *)out + x), vreinterpret_u32_u16(avg), 0);
+        }
+        downscale_box4_row_16(row, src_stride, out, x, width);
+    }
+}
+#endif // __aarch64__
+
+// The box is centered on the luma samples it covers.  Chroma samples
+// sited on the left (or top) luma sample of their pair sit a quarter
+// of a chroma sample before that center for 2:1 and three quarters
+// for 4:1, so they use a box shifted by that amount.
+static const downscale_taps_t downscale_taps[2][2] =
+{
+    {
+        { 0, 2, 1, { 1, 1 } },              // 2:1, centered
+        { -1, 3, 3, { 1, 4, 3 } },          // 2:1, co-sited
+    },
+    {
+        { 0, 4, 2, { 1, 1, 1, 1 } },        // 4:1, centered
+        { -1, 5, 4, { 3, 4, 4, 4, 1 } },    // 4:1, co-sited
+    },
+};
+
+#define DEF_DOWNSCALE_TAPS(nbits)                                                   \
+static void downscale_taps_##nbits(const uint8_t * src, int src_stride,             \
+                                   int src_width, int src_height,                   \
+                                   uint8_t * dst, int dst_stride,                   \
+                                   int width, int start, int stop, int factor,      \
+                                   const downscale_taps_t * th,                     \
+                                   const downscale_taps_t * tv)                     \
+{                                                                                   \
+    const int shift = th->shift + tv->shift;                                        \
+    for (int y = start; y < stop; y++)                                              \
+    {                                                                               \
+        uint##nbits##_t * out = (uint##nbits##_t *)(dst + y * dst_stride);          \
+        for (int x = 0; x < width; x++)                                             \
+        {                                                                           \
+            uint32_t sum = 0;                                                       \
+            for (int j = 0; j < tv->count; j++)                                     \
+            {                                                                       \
+                int sy = av_clip(y * factor + tv->offset + j, 0, src_height - 1);   \
+                const uint##nbits##_t * in =                                        \
+                    (const uint##nbits##_t *)(src + sy * src_stride);               \
+                uint32_t row = 0;                                                   \
+                for (int i = 0; i < th->count; i++)                                 \
+                {                                                                   \
+                    int sx = av_clip(x * factor + th->offset + i, 0, src_width - 1);\
+                    row += th->taps[i] * in[sx];                                    \
+                }                                                                   \
+                sum += tv->taps[j] * row;                                           \
+            }                                                                       \
+            out[x] = (sum + (1 << (shift - 1))) >> shift;                           \
+        }                                                                           \
+    }                                                                               \
+}                                                                                   \
+
+DEF_DOWNSCALE_TAPS(8)
+DEF_DOWNSCALE_TAPS(16)
+
+static void crop_scale_downscale_slice(hb_crop_scale_pad_t * fp, int segment)
+{
+    int pp;
+
+    for (pp = 0; pp < 3; pp++)
+    {
+        int sw = pp ? fp->log2_chroma_w : 0;
+        int sh = pp ? fp->log2_chroma_h : 0;
+        int width      = fp->width  >> sw;
+        int height     = fp->height >> sh;
+        int start      = height *  segment      / fp->threads;
+        int stop       = height * (segment + 1) / fp->threads;
+        int src_stride = fp->src_buf->plane[pp].stride;
+        int dst_stride = fp->dst_buf->plane[pp].stride;
+        const uint8_t * src = fp->src_buf->plane[pp].data +
+                              (fp->crop[0] >> sh) * src_stride +
+                              (fp->crop[2] >> sw) * fp->bps;
+        uint8_t       * dst = fp->dst_buf->plane[pp].data +
+                              (fp->y >> sh) * dst_stride +
+                              (fp->x >> sw) * fp->bps;
+
+        if (pp && fp->taps_h != NULL)
+        {
+            int src_width  = fp->cropped_width  >> sw;
+            int src_height = fp->cropped_height >> sh;
+            if (fp->bps == 1)
+                downscale_taps_8(src, src_stride, src_width, src_height,
+                                 dst, dst_stride, width, start, stop,
+                                 fp->factor, fp->taps_h, fp->taps_v);
+            else
+                downscale_taps_16(src, src_stride, src_width, src_height,
+                                  dst, dst_stride, width, start, stop,
+                                  fp->factor, fp->taps_h, fp->taps_v);
+        }
+        else
+        {
+            fp->box(src, src_stride, dst, dst_stride, width, start, stop);
+        }
+    }
+}
+
+static void crop_scale_downscale_work(void * thread_args_v)
+{
+    crop_scale_thread_arg_t * thread_args = thread_args_v;
+
+    crop_scale_downscale_slice(thread_args->fp, thread_args->arg.segment);
+}
+
+static void crop_scale_native_free(hb_crop_scale_pad_t ** _fp)
+{
+    hb_crop_scale_pad_t * fp = *_fp;
+
+    if (fp == NULL)
+    {
+        return;
+    }
+    sws_freeContext(fp->sws);
+    av_frame_free(&fp->src);
+    av_frame_free(&fp->dst);
+    if (fp->threads > 1)
+    {
+        taskset_fini(&fp->taskset);
+    }
+    free(fp);
+    *_fp = NULL;
+}
+
+static const AVPixFmtDescriptor * crop_scale_native_format(hb_filter_private_t * pv)
+{
+    const AVPixFmtDescriptor * desc = av_pix_fmt_desc_get(pv->output.pix_fmt);
+    if (desc == NULL || desc->nb_components != 3 ||
+        !(desc->flags & AV_PIX_FMT_FLAG_PLANAR) ||
+        (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_ALPHA |
+                        AV_PIX_FMT_FLAG_BE  | AV_PIX_FMT_FLAG_HWACCEL)) ||
+        desc->comp[0].plane != 0 || desc->comp[1].plane != 1 ||
+        desc->comp[2].plane != 2 || desc->comp[0].depth > 16)
+    {
+        return NULL;
+    }
+    return desc;
+}
+
+// Scales the cropped picture to pv->output size, pass factor 0
+// to use swscale.  The output is not padded until pad is fused.
+static hb_crop_scale_pad_t * crop_scale_native_init(hb_filter_private_t * pv,
+                                                    const AVPixFmtDescriptor * desc,
+                                                    int factor)
+{
+    int width  = pv->output.geometry.width;
+    int height = pv->output.geometry.height;
+    int cropped_width  = pv->input.geometry.width  - pv->output.crop[2] -
+                                                     pv->output.crop[3];
+    int cropped_height = pv->input.geometry.height - pv->output.crop[0] -
+                                                     pv->output.crop[1];
+
+    hb_crop_scale_pad_t * fp = calloc(1, sizeof(hb_crop_scale_pad_t));
+    if (fp == NULL)
+    {
+        return NULL;
+    }
+
+    fp->pix_fmt       = pv->output.pix_fmt;
+    fp->bps           = desc->comp[0].depth > 8 ? 2 : 1;
+    fp->log2_chroma_w = desc->log2_chroma_w;
+    fp->log2_chroma_h = desc->log2_chroma_h;
+    memcpy(fp->crop, pv->output.crop, sizeof(fp->crop));
+    fp->cropped_width  = cropped_width;
+    fp->cropped_height = cropped_height;
+    fp->width         = width;
+    fp->height        = height;
+    fp->pad_width     = width;
+    fp->pad_height    = height;
+    fp->factor        = factor;
+
+    int threads = hb_job_thread_count(pv->input.job, HB_THREADS_FILTER);
+
+    if (factor == 0)
+    {
+        fp->sws = hb_sws_get_context_threads(
+                        cropped_width, cropped_height, pv->output.pix_fmt, 0,
+                        width, height, pv->output.pix_fmt, 0,
+                        SWS_LANCZOS | SWS_ACCURATE_RND,
+                        hb_sws_get_colorspace(pv->output.color_matrix),
+                        threads);
+        fp->src = av_frame_alloc();
+        fp->dst = av_frame_alloc();
+        if (fp->sws == NULL || fp->src == NULL || fp->dst == NULL)
+        {
+            crop_scale_native_free(&fp);
+        }
+        return fp;
+    }
+
+    if (fp->bps == 1)
+    {
+        fp->box = factor == 2 ? downscale_box2_8 : downscale_box4_8;
+#if defined(ARCH_X86)
+        if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2 && !hb_get_reference_kernels())
+        {
+            fp->box = factor == 2 ? downscale_box2_8_sse2 : downscale_box4_8_sse2;
+        }
+#endif
+#if defined(__aarch64__)
+        if (!hb_get_reference_kernels())
+        {
+            fp->box = factor == 2 ? downscale_box2_8_neon : downscale_box4_8_neon;
+        }
+#endif
+    }
+    else
+    {
+        fp->box = factor == 2 ? downscale_box2_16 : downscale_box4_16;
+#if defined(ARCH_X86)
+        if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2 && !hb_get_reference_kernels())
+        {
+            fp->box = factor == 2 ? downscale_box2_16_sse2 : downscale_box4_16_sse2;
+        }
+#endif
+#if defined(__aarch64__)
+        if (!hb_get_reference_kernels())
+        {
+            fp->box = factor == 2 ? downscale_box2_16_neon : downscale_box4_16_neon;
+        }
+#endif
+    }
+
+    // Keep slices large enough that signalling the threads stays cheap
+    fp->threads = MIN(threads, height / 64);
+    if (fp->threads > 1)
+    {
+        if (taskset_init(&fp->taskset, "crop_scale_segment", fp->threads,
+                         sizeof(crop_scale_thread_arg_t),
+                         crop_scale_downscale_work) == 0)
+        {
+            hb_error("crop_scale: could not initialize taskset");
+            fp->threads = 0;
+            crop_scale_native_free(&fp);
+            return NULL;
+        }
+        for (int ii = 0; ii < fp->threads; ii++)
+        {
+            crop_scale_thread_arg_t * thread_args;
+
+            thread_args = taskset_thread_args(&fp->taskset, ii);
+            thread_args->fp          = fp;
+            thread_args->arg.segment = ii;
+            thread_args->arg.taskset = &fp->taskset;
+        }
+    }
+    else
+    {
+        fp->threads = 1;
+    }
+
+    return fp;
+}
+
+static void crop_scale_native_setup(hb_filter_object_t * filter)
+{
+    hb_filter_private_t * pv = filter->private_data;
+
+    if (pv->input.hw_pix_fmt != AV_PIX_FMT_NONE)
+    {
+        return;
+    }
+
+    const AVPixFmtDescriptor * desc = crop_scale_native_format(pv);
+    if (desc == NULL)
+    {
+        return;
+    }
+
+    int width  = pv->output.geometry.width;
+    int height = pv->output.geometry.height;
+    int cropped_width  = pv->input.geometry.width  - pv->output.crop[2] -
+                                                     pv->output.crop[3];
+    int cropped_height = pv->input.geometry.height - pv->output.crop[0] -
+                                                     pv->output.crop[1];
+    int mask_w = (1 << desc->log2_chroma_w) - 1;
+    int mask_h = (1 << desc->log2_chroma_h) - 1;
+    int factor = 0;
+
+    if (cropped_width == 2 * width && cropped_height == 2 * height)
+    {
+        factor = 2;
+    }
+    else if (cropped_width == 4 * width && cropped_height == 4 * height)
+    {
+        factor = 4;
+    }
+    // Chroma planes must scale by the same ratio as luma
+    if (factor == 0 ||
+        desc->log2_chroma_w > 1 || desc->log2_chroma_h > 1 ||
+        (width  | pv->output.crop[2]) & mask_w ||
+        (height | pv->output.crop[0]) & mask_h)
+    {
+        return;
+    }
+
+    // Subsampled chroma that is not centered between its luma samples
+    // needs taps shifted to its site.  Bottom sited chroma is rare and
+    // left to swscale.
+    int sited_h = 0, sited_v = 0;
+    switch (pv->output.chroma_location)
+    {
+        case AVCHROMA_LOC_UNSPECIFIED:
+        case AVCHROMA_LOC_LEFT:
+            sited_h = 1;
+            break;
+        case AVCHROMA_LOC_TOPLEFT:
+            sited_h = 1;
+            sited_v = 1;
+            break;
+        case AVCHROMA_LOC_TOP:
+            sited_v = 1;
+            break;
+        case AVCHROMA_LOC_BOTTOMLEFT:
+        case AVCHROMA_LOC_BOTTOM:
+            if (desc->log2_chroma_h)
+            {
+                return;
+            }
+            sited_h = pv->output.chroma_location == AVCHROMA_LOC_BOTTOMLEFT;
+            break;
+        default:
+            break;
+    }
+    sited_h &= desc->log2_chroma_w;
+    sited_v &= desc->log2_chroma_h;
+
+    hb_crop_scale_pad_t * fp = crop_scale_native_init(pv, desc, factor);
+    if (fp == NULL)
+    {
+        return;
+    }
+    if (sited_h || sited_v)
+    {
+        fp->taps_h = &downscale_taps[factor == 4][sited_h];
+        fp->taps_v = &downscale_taps[factor == 4][sited_v];
+    }
+    hb_log("crop_scale: %d:1 box downscale%s, %d threads", factor,
+           fp->taps_h != NULL ? " with sited chroma" : "", fp->threads);
+
+    pv->native = fp;
+    hb_value_free(&pv->avfilters);
+    filter->skip = 0;
+    filter->work = crop_scale_native_work;
+}
+
+static void crop_scale_fuse_pad(hb_filter_object_t * filter,
+                                hb_filter_object_t * pad)
+{
+    hb_filter_private_t * pv     = filter->private_data;
+    hb_filter_private_t * pad_pv = pad->private_data;
+
+    if (pv == NULL || pad_pv == NULL ||
+        pv->input.hw_pix_fmt != AV_PIX_FMT_NONE)
+    {
+        return;
+    }
+
+    // The fused path scales and pads in the output pixel format
+    if (pv->input.pix_fmt != pv->output.pix_fmt)
+    {
+        return;
+    }
+
+    hb_crop_scale_pad_t * fp = pv->native;
+    if (fp == NULL)
+    {
+        // Only fuse with the generic swscale path
+        if (pv->avfilters == NULL)
+        {
+            return;
+        }
+        int        count = hb_value_array_len(pv->avfilters);
+        hb_dict_t * last = hb_value_array_get(pv->avfilters, count - 1);
+        if (last == NULL || hb_dict_get(last, "scale") == NULL)
+        {
+            return;
+        }
+        if (pv->output.color_range == AVCOL_RANGE_JPEG)
+        {
+            return;
+        }
+    }
+
+    const AVPixFmtDescriptor * desc = crop_scale_native_format(pv);
+    if (desc == NULL)
+    {
+        return;
+    }
+
+    int pad_width, pad_height, x, y, rgb;
+    if (hb_pad_get_region(pad, &pad_width, &pad_height, &x, &y, &rgb) < 0)
+    {
+        return;
+    }
+
+    int width  = pv->output.geometry.width;
+    int height = pv->output.geometry.height;
+    int mask_w = (1 << desc->log2_chroma_w) - 1;
+    int mask_h = (1 << desc->log2_chroma_h) - 1;
+    if (x < 0)
+    {
+        x = (pad_width - width) / 2;
+    }
+    if (y < 0)
+    {
+        y = (pad_height - height) / 2;
+    }
+    // Same rounding to chroma subsampling as the pad avfilter
+    x &= ~mask_w;
+    y &= ~mask_h;
+    if ((width | pad_width | pv->output.crop[2]) & mask_w ||
+        (height | pad_height | pv->output.crop[0]) & mask_h ||
+        x + width > pad_width || y + height > pad_height)
+    {
+        return;
+    }
+
+    if (fp == NULL)
+    {
+        fp = crop_scale_native_init(pv, desc, 0);
+        if (fp == NULL)
+        {
+            return;
+        }
+        pv->native = fp;
+    }
+
+    hb_csp_convert_f rgb2yuv = hb_get_rgb2yuv_function(pv->output.color_matrix);
+    int yuv   = rgb2yuv(rgb < 0 ? 0 : rgb);
+    int shift = desc->comp[0].depth - 8;
+    int Y     = (yuv >> 16) & 0xff;
+    int Cb    = (yuv      ) & 0xff;
+    int Cr    = (yuv >>  8) & 0xff;
+
+    if (pv->output.color_range == AVCOL_RANGE_JPEG)
+    {
+        // rgb2yuv gives limited range values, expand them to full range
+        Y  = av_clip_uint8(((Y  -  16) * 255 + 109) / 219);
+        Cb = av_clip_uint8(((Cb - 128) * 255 + (Cb < 128 ? -112 : 112)) / 224 + 128);
+        Cr = av_clip_uint8(((Cr - 128) * 255 + (Cr < 128 ? -112 : 112)) / 224 + 128);
+    }
+
+    fp->pad_width     = pad_width;
+    fp->pad_height    = pad_height;
+    fp->x             = x;
+    fp->y             = y;
+    fp->color[0]      = Y  << shift;
+    fp->color[1]      = Cb << shift;
+    fp->color[2]      = Cr << shift;
+    fp->padded        = 1;
+
+    pv->output    = pad_pv->output;
+
+    // Crop/scale now does the work of both filters
+    hb_value_free(&pv->avfilters);
+    hb_value_free(&pad_pv->avfilters);
+    filter->skip = 0;
+    filter->work = crop_scale_native_work;
+}
+
+void hb_crop_scale_fuse_pad(hb_list_t * list)
+{
+    int ii;
+
+    for (ii = 0; ii + 1 < hb_list_count(list); ii++)
+    {
+        hb_filter_object_t * filter = hb_list_item(list, ii);
+        hb_filter_object_t * next   = hb_list_item(list, ii + 1);
+
+        if (filter->id == HB_FILTER_CROP_SCALE && next->id == HB_FILTER_PAD)
+        {
+            crop_scale_fuse_pad(filter, next);
+            return;
+        }
+    }
+}
+
+static void fill_rect(uint8_t * dst, int stride, int bps,
+                      int width, int height, int value)
+{
+    int yy, xx;
+
+    if (width <= 0 || height <= 0)
+    {
+        return;
+    }
+    for (yy = 0; yy < height; yy++)
+    {
+        if (bps == 1)
+        {
+            memset(dst, value, width);
+        }
+        else
+        {
+            uint16_t * dst16 = (uint16_t *)dst;
+            for (xx = 0; xx < width; xx++)
+            {
+                dst16[xx] = value;
+            }
+        }
+        dst += stride;
+    }
+}
+
+static void crop_scale_buffer_free(void * opaque, uint8_t * data)
+{
+    // The picture is owned by the hb_buffer_t, nothing to free
+}
+
+// Wrap a rectangle of an hb_buffer_t picture in an AVFrame without copying.
+// The AVFrame needs a buffer reference so that swscale does not
+// allocate (and copy) its own.
+static int crop_scale_wrap_frame(AVFrame * frame, hb_buffer_t * buf,
+                                 hb_crop_scale_pad_t * fp,
+                                 int x, int y, int width, int height)
+{
+    int pp;
+
+    frame->format = fp->pix_fmt;
+    frame->width  = width;
+    frame->height = height;
+    for (pp = 0; pp < 3; pp++)
+    {
+        int sw = pp ? fp->log2_chroma_w : 0;
+        int sh = pp ? fp->log2_chroma_h : 0;
+
+        frame->data[pp]     = buf->plane[pp].data +
+                              (y >> sh) * buf->plane[pp].stride +
+                              (x >> sw) * fp->bps;
+        frame->linesize[pp] = buf->plane[pp].stride;
+    }
+    frame->buf[0] = av_buffer_create(buf->plane[0].data, buf->plane[0].size,
+                                     crop_scale_buffer_free, NULL, 0);
+
+    return frame->buf[0] != NULL ? 0 : -1;
+}
+
+static int crop_scale_native_work(hb_filter_object_t * filter,
+                                  hb_buffer_t ** buf_in,
+                                  hb_buffer_t ** buf_out)
+{
+    hb_filter_private_t * pv = filter->private_data;
+    hb_crop_scale_pad_t * fp = pv->native;
+    hb_buffer_t         * in = *buf_in, * out;
+    int                   pp, ret;
+
+    if (in->s.flags & HB_BUF_FLAG_EOF)
+    {
+        *buf_out = in;
+        *buf_in = NULL;
+        return HB_FILTER_DONE;
+    }
+
+    out = hb_frame_buffer_init(fp->pix_fmt, fp->pad_width, fp->pad_height);
+    if (out == NULL)
+    {
+        hb_error("crop_scale: frame buffer allocation failure");
+        return HB_FILTER_FAILED;
+    }
+    out->f.color_prim      = pv->output.color_prim;
+    out->f.color_transfer  = pv->output.color_transfer;
+    out->f.color_matrix    = pv->output.color_matrix;
+    out->f.color_range     = pv->output.color_range;
+    out->f.chroma_location = pv->output.chroma_location;
+
+    // Fill only the borders, the interior is written by the scaler
+    for (pp = 0; pp < 3; pp++)
+    {
+        int sw = pp ? fp->log2_chroma_w : 0;
+        int sh = pp ? fp->log2_chroma_h : 0;
+        int x  = fp->x >> sw, w = fp->width  >> sw;
+        int y  = fp->y >> sh, h = fp->height >> sh;
+        int plane_width  = out->plane[pp].width;
+        int plane_height = out->plane[pp].height;
+        int stride       = out->plane[pp].stride;
+        uint8_t * data   = out->plane[pp].data;
+
+        fill_rect(data, stride, fp->bps, plane_width, y, fp->color[pp]);
+        fill_rect(data + (y + h) * stride, stride, fp->bps,
+                  plane_width, plane_height - y - h, fp->color[pp]);
+        fill_rect(data + y * stride, stride, fp->bps, x, h, fp->color[pp]);
+        fill_rect(data + y * stride + (x + w) * fp->bps, stride, fp->bps,
+                  plane_width - x - w, h, fp->color[pp]);
+    }
+
+    if (fp->factor > 0)
+    {
+        fp->src_buf = in;
+        fp->dst_buf = out;
+        if (fp->threads > 1)
+        {
+            taskset_cycle(&fp->taskset);
+        }
+        else
+        {
+            crop_scale_downscale_slice(fp, 0);
+        }
+        fp->src_buf = NULL;
+        fp->dst_buf = NULL;
+        ret = 0;
+    }
+    else
+    {
+        ret = crop_scale_wrap_frame(fp->src, in, fp, fp->crop[2], fp->crop[0],
+                                    fp->cropped_width, fp->cropped_height);
+        if (ret == 0)
+        {
+            ret = crop_scale_wrap_frame(fp->dst, out, fp, fp->x, fp->y,
+                                        fp->width, fp->height);
+        }
+        if (ret == 0)
+        {
+            ret = sws_scale_frame(fp->sws, fp->dst, fp->src);
+        }
+        av_frame_unref(fp->src);
+        av_frame_unref(fp->dst);
+    }
+    if (ret < 0)
+    {
+        hb_error("crop_scale: scaling failed");
+        hb_buffer_close(&out);
+        return HB_FILTER_FAILED;
+    }
+
+    hb_buffer_copy_props(out, in);
+    *buf_out = out;
+
+    return HB_FILTER_OK;
+}
@@ -7,10 +7,92 @@
    For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
  */
 
-#include "handbrake/common.h"
-#include "handbrake/avfilter_priv.h"
+/*****
+Parameters:
+    strength  : weak or strong
+    thresh    : edge threshold, in percent of the sample range (0 = default)
+    blocksize : size of the coding blocks whose edges are smoothed
 
-static int deblock_init(hb_filter_object_t * filter, hb_filter_init_t * init);
+Edge detection, smoothing and edge order follow FFmpeg's deblock filter,
+which goes through the blocks in raster order, filtering the top edge of
+each block and then its left edge.  The top edge of a block row reads the
+3 sample rows above it after and the 3 rows below it before their
+vertical edges are filtered.  With blocks of 6 or more rows the top edges
+of different block rows do not overlap, so the same result is produced
+in three passes that are each split in block row segments across a
+taskset:
+
+  - vertical edges, except in the first 3 rows of each block row
+  - horizontal edges
+  - vertical edges in the first 3 rows of each block row
+
+Smaller blocks are filtered in FFmpeg's order by a single thread.
+Unlike FFmpeg, edges less than 3 samples from the right or bottom of a
+plane are not filtered, FFmpeg reads past the plane there.
+*****/
+
+#include "handbrake/handbrake.h"
+#include "handbrake/taskset.h"
+
+#if defined(ARCH_X86)
+#include <emmintrin.h>
+#include "libavutil/cpu.h"
+#endif
+
+#define DEBLOCK_ALPHA_DEFAULT     0.098
+#define DEBLOCK_BETA_DEFAULT      0.05
+#define DEBLOCK_BLOCKSIZE_DEFAULT 8
+#define DEBLOCK_BLOCKSIZE_MIN     4
+#define DEBLOCK_BLOCKSIZE_MAX     512
+// Rows on each side of a horizontal edge that it reads or changes
+#define DEBLOCK_EDGE_ROWS         3
+
+enum
+{
+    DEBLOCK_PASS_VERTICAL_BODY,
+    DEBLOCK_PASS_HORIZONTAL,
+    DEBLOCK_PASS_VERTICAL_TOP,
+    DEBLOCK_PASS_SEQUENTIAL,
+};
+
+typedef struct deblock_thread_arg_s
+{
+    taskset_thread_arg_t arg;
+    hb_filter_private_t *pv;
+    int segment_start[3];   // first block row of the segment
+    int segment_stop[3];    // one past the last block row
+} deblock_thread_arg_t;
+
+typedef void (*deblock_edge_f)(uint8_t *dst, ptrdiff_t step, ptrdiff_t inc,
+                               int count, const int thresh[4], int max);
+
+struct hb_filter_private_s
+{
+    int             strong;
+    int             block;
+    int             depth;
+    int             max;
+    int             thresh[4];  // alpha, beta, gamma, delta
+
+    int             cpu_count;
+    int             pass;
+    hb_buffer_t   * buf;
+
+    deblock_edge_f  filter_edge;
+    deblock_edge_f  filter_hedge;
+    deblock_edge_f  filter_vedge;   // needs 4 samples after the edge
+
+    taskset_t       deblock_taskset;
+
+    hb_filter_init_t input;
+    hb_filter_init_t output;
+};
+
+static int  deblock_init(hb_filter_object_t * filter, hb_filter_init_t * init);
+static int  deblock_work(hb_filter_object_t * filter,
+                         hb_buffer_t ** buf_in, hb_buffer_t ** buf_out);
+static void deblock_close(hb_filter_object_t * filter);
+static hb_filter_info_t * deblock_info(hb_filter_object_t * filter);
 
 const char deblock_template[] =
     "strength=^"HB_ALL_REG"$:thresh=^"HB_INT_REG"$:blocksize=^"HB_INT_REG"$:"
@@ -20,66 +102,547 @@ hb_filter_object_t hb_filter_deblock =
 {
     .id                = HB_FILTER_DEBLOCK,
     .enforce_order     = 1,
-    .skip              = 1,
     .name              = "Deblock",
     .settings          = NULL,
     .init              = deblock_init,
-    .work              = hb_avfilter_null_work,
-    .close             = hb_avfilter_alias_close,
+    .work              = deblock_work,
+    .close             = deblock_close,
+    .info              = deblock_info,
     .settings_template = deblock_template,
 };
 
-/* Deblock presets and tunes
+/*
+ * Edge filters.
  *
- * There are currently no presets and tunes for deblock
- * The custom deblock string is converted to an avformat filter graph string
+ * dst points to the first sample after the edge, step is the distance
+ * between samples across the edge and inc the distance between samples
+ * along the edge, both in samples.  count samples along the edge are
+ * filtered.
  */
-static int deblock_init(hb_filter_object_t * filter, hb_filter_init_t * init)
+#define DEBLOCK_EDGE(nbits)                                                    \
+static void deblock_edge_strong_##nbits(uint8_t *dstp, ptrdiff_t step,         \
+                                        ptrdiff_t inc, int count,              \
+                                        const int thresh[4], int max)          \
+{                                                                              \
+    uint##nbits##_t *dst = (uint##nbits##_t *)dstp;                            \
+                                                                               \
+    for (int x = 0; x < count; x++, dst += inc)                                \
+    {                                                                          \
+        const int delta = dst[0] - dst[-step];                                 \
+                                                                               \
+        if (abs(delta) >= thresh[0] ||                                         \
+            abs(dst[-step] - dst[-2 * step]) >= thresh[1] ||                   \
+            abs(dst[0] - dst[step]) >= thresh[2] ||                            \
+            abs(dst[step] - dst[2 * step]) >= thresh[3])                       \
+        {                                                                      \
+            continue;                                                          \
+        }                                                                      \
+        dst[-3 * step] = av_clip(dst[-3 * step] + delta / 8, 0, max);          \
+        dst[-2 * step] = av_clip(dst[-2 * step] + delta / 4, 0, max);          \
+        dst[-1 * step] = av_clip(dst[-1 * step] + delta / 2, 0, max);          \
+        dst[ 0 * step] = av_clip(dst[ 0 * step] - delta / 2, 0, max);          \
+        dst[ 1 * step] = av_clip(dst[ 1 * step] - delta / 4, 0, max);          \
+        dst[ 2 * step] = av_clip(dst[ 2 * step] - delta / 8, 0, max);          \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void deblock_edge_weak_##nbits(uint8_t *dstp, ptrdiff_t step,           \
+                                      ptrdiff_t inc, int count,                \
+                                      const int thresh[4], int max)            \
+{                                                                              \
+    uint##nbits##_t *dst = (uint##nbits##_t *)dstp;                            \
+                                                                               \
+    for (int x = 0; x < count; x++, dst += inc)                                \
+    {                                                                          \
+        const int delta = dst[0] - dst[-step];                                 \
+                                                                               \
+        if (abs(delta) >= thresh[0] ||                                         \
+            abs(dst[-step] - dst[-2 * step]) >= thresh[1] ||                   \
+            abs(dst[0] - dst[step]) >= thresh[2])                              \
+        {                                                                      \
+            continue;                                                          \
+        }                                                                      \
+        dst[-2 * step] = av_clip(dst[-2 * step] + delta / 8, 0, max);          \
+        dst[-1 * step] = av_clip(dst[-1 * step] + delta / 2, 0, max);          \
+        dst[ 0 * step] = av_clip(dst[ 0 * step] - delta / 2, 0, max);          \
+        dst[ 1 * step] = av_clip(dst[ 1 * step] - delta / 8, 0, max);          \
+    }                                                                          \
+}
+
+DEBLOCK_EDGE(8)
+DEBLOCK_EDGE(16)
+
+#if defined(ARCH_X86)
+
+// Signed division by 1 << shift, rounding towards zero like C
+#define DIV_POW2(v, shift) \
+    _mm_srai_epi16(_mm_add_epi16(v, _mm_and_si128(_mm_srai_epi16(v, 15), \
+                                 _mm_set1_epi16((1 << (shift)) - 1))), shift)
+
+static inline __m128i abs_epi16_sse2(__m128i v)
 {
-    hb_filter_private_t * pv = NULL;
+    return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
 
-    pv = calloc(1, sizeof(struct hb_filter_private_s));
-    filter->private_data = pv;
-    if (pv == NULL)
+// s[0..5] are the samples at -3..2 across the edge, widened to 16 bit,
+// for 8 positions along the edge.  Returns 0 if no position is filtered.
+static inline int deblock_strong_sse2(__m128i s[6], const int thresh[4])
+{
+    __m128i diff = _mm_sub_epi16(s[3], s[2]);
+    __m128i mask;
+
+    mask = _mm_cmpgt_epi16(_mm_set1_epi16(thresh[0]), abs_epi16_sse2(diff));
+    mask = _mm_and_si128(mask, _mm_cmpgt_epi16(_mm_set1_epi16(thresh[1]),
+                               abs_epi16_sse2(_mm_sub_epi16(s[2], s[1]))));
+    mask = _mm_and_si128(mask, _mm_cmpgt_epi16(_mm_set1_epi16(thresh[2]),
+                               abs_epi16_sse2(_mm_sub_epi16(s[3], s[4]))));
+    mask = _mm_and_si128(mask, _mm_cmpgt_epi16(_mm_set1_epi16(thresh[3]),
+                               abs_epi16_sse2(_mm_sub_epi16(s[4], s[5]))));
+    if (_mm_movemask_epi8(mask) == 0)
     {
-        return 1;
+        return 0;
     }
-    pv->input = *init;
+    diff = _mm_and_si128(diff, mask);
+
+    __m128i d8 = DIV_POW2(diff, 3);
+    __m128i d4 = DIV_POW2(diff, 2);
+    __m128i d2 = DIV_POW2(diff, 1);
+
+    s[0] = _mm_add_epi16(s[0], d8);
+    s[1] = _mm_add_epi16(s[1], d4);
+    s[2] = _mm_add_epi16(s[2], d2);
+    s[3] = _mm_sub_epi16(s[3], d2);
+    s[4] = _mm_sub_epi16(s[4], d4);
+    s[5] = _mm_sub_epi16(s[5], d8);
+    return 1;
+}
+
+static inline int deblock_weak_sse2(__m128i s[6], const int thresh[4])
+{
+    __m128i diff = _mm_sub_epi16(s[3], s[2]);
+    __m128i mask;
+
+    mask = _mm_cmpgt_epi16(_mm_set1_epi16(thresh[0]), abs_epi16_sse2(diff));
+    mask = _mm_and_si128(mask, _mm_cmpgt_epi16(_mm_set1_epi16(thresh[1]),
+                               abs_epi16_sse2(_mm_sub_epi16(s[2], s[1]))));
+    mask = _mm_and_si128(mask, _mm_cmpgt_epi16(_mm_set1_epi16(thresh[2]),
+                               abs_epi16_sse2(_mm_sub_epi16(s[3], s[4]))));
+    if (_mm_movemask_epi8(mask) == 0)
+    {
+        return 0;
+    }
+    diff = _mm_and_si128(diff, mask);
+
+    __m128i d8 = DIV_POW2(diff, 3);
+    __m128i d2 = DIV_POW2(diff, 1);
+
+    s[1] = _mm_add_epi16(s[1], d8);
+    s[2] = _mm_add_epi16(s[2], d2);
+    s[3] = _mm_sub_epi16(s[3], d2);
+    s[4] = _mm_sub_epi16(s[4], d8);
+    return 1;
+}
+
+// Transposes the 8x8 block of bytes in the low halves of in[] into
+// out[], rows 2 * n and 2 * n + 1 in the low and high half of out[n]
+static inline void transpose8x8_epi8_sse2(const __m128i in[8], __m128i out[4])
+{
+    __m128i t0 = _mm_unpacklo_epi8(in[0], in[1]);
+    __m128i t1 = _mm_unpacklo_epi8(in[2], in[3]);
+    __m128i t2 = _mm_unpacklo_epi8(in[4], in[5]);
+    __m128i t3 = _mm_unpacklo_epi8(in[6], in[7]);
+    __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+    __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+    __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+    __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+
+    out[0] = _mm_unpacklo_epi32(u0, u2);
+    out[1] = _mm_unpackhi_epi32(u0, u2);
+    out[2] = _mm_unpacklo_epi32(u1, u3);
+    out[3] = _mm_unpackhi_epi32(u1, u3);
+}
+
+#define LOAD8(p)     _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p)), zero)
+#define STORE8(p, v) _mm_storel_epi64((__m128i *)(p), _mm_packus_epi16(v, v))
+
+// Edges of 8 bit planes, 8 samples along the edge at a time.
+// Out of range results are clipped to 0..255 by the saturating pack.
+#define DEBLOCK_EDGE_SSE2(name)                                                \
+static void deblock_hedge_##name##_sse2(uint8_t *dst, ptrdiff_t step,         \
+                                        ptrdiff_t inc, int count,              \
+                                        const int thresh[4], int max)          \
+{                                                                              \
+    const __m128i zero = _mm_setzero_si128();                                  \
+    int x;                                                                     \
+                                                                               \
+    for (x = 0; x + 8 <= count; x += 8)                                        \
+    {                                                                          \
+        uint8_t *p = dst + x;                                                  \
+        __m128i  s[6];                                                         \
+                                                                               \
+        for (int ii = 0; ii < 6; ii++)                                         \
+        {                                                                      \
+            s[ii] = LOAD8(p + (ii - 3) * step);                                \
+        }                                                                      \
+        if (deblock_##name##_sse2(s, thresh))                                  \
+        {                                                                      \
+            for (int ii = 0; ii < 6; ii++)                                     \
+            {                                                                  \
+                STORE8(p + (ii - 3) * step, s[ii]);                            \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+    if (x < count)                                                             \
+    {                                                                          \
+        deblock_edge_##name##_8(dst + x, step, inc, count - x, thresh, max);   \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void deblock_vedge_##name##_sse2(uint8_t *dst, ptrdiff_t step,         \
+                                        ptrdiff_t inc, int count,              \
+                                        const int thresh[4], int max)          \
+{                                                                              \
+    const __m128i zero = _mm_setzero_si128();                                  \
+    int y;                                                                     \
+                                                                               \
+    for (y = 0; y + 8 <= count; y += 8)                                        \
+    {                                                                          \
+        uint8_t *p = dst + y * inc - 4;                                        \
+        __m128i  rows[8], cols[4], s[6];                                       \
+                                                                               \
+        for (int ii = 0; ii < 8; ii++)                                         \
+        {                                                                      \
+            rows[ii] = _mm_loadl_epi64((const __m128i *)(p + ii * inc));       \
+        }                                                                      \
+        transpose8x8_epi8_sse2(rows, cols);                                    \
+        s[0] = _mm_unpackhi_epi8(cols[0], zero);                               \
+        s[1] = _mm_unpacklo_epi8(cols[1], zero);                               \
+        s[2] = _mm_unpackhi_epi8(cols[1], zero);                               \
+        s[3] = _mm_unpacklo_epi8(cols[2], zero);                               \
+        s[4] = _mm_unpackhi_epi8(cols[2], zero);                               \
+        s[5] = _mm_unpacklo_epi8(cols[3], zero);                               \
+        if (!deblock_##name##_sse2(s, thresh))                                 \
+        {                                                                      \
+            continue;                                                          \
+        }                                                                      \
+        rows[0] = cols[0];                                                     \
+        rows[1] = _mm_packus_epi16(s[0], s[0]);                                \
+        rows[2] = _mm_packus_epi16(s[1], s[1]);                                \
+        rows[3] = _mm_packus_epi16(s[2], s[2]);                                \
+        rows[4] = _mm_packus_epi16(s[3], s[3]);                                \
+        rows[5] = _mm_packus_epi16(s[4], s[4]);                                \
+        rows[6] = _mm_packus_epi16(s[5], s[5]);                                \
+        rows[7] = _mm_unpackhi_epi64(cols[3], cols[3]);                        \
+        transpose8x8_epi8_sse2(rows, cols);                                    \
+        for (int ii = 0; ii < 4; ii++)                                         \
+        {                                                                      \
+            _mm_storel_epi64((__m128i *)(p + 2 * ii * inc), cols[ii]);         \
+            _mm_storel_epi64((__m128i *)(p + (2 * ii + 1) * inc),              \
+                             _mm_unpackhi_epi64(cols[ii], cols[ii]));          \
+        }                                                                      \
+    }                                                                          \
+    if (y < count)                                                             \
+    {                                                                          \
+        deblock_edge_##name##_8(dst + y * inc, step, inc, count - y,           \
+                                thresh, max);                                  \
+    }                                                                          \
+}
+
+DEBLOCK_EDGE_SSE2(strong)
+DEBLOCK_EDGE_SSE2(weak)
+
+#undef LOAD8
+#undef STORE8
+#undef DIV_POW2
+
+#endif // ARCH_X86
+
+static void deblock_vedges(hb_filter_private_t *pv, hb_buffer_t *buf,
+                           int pp, int y0, int y1)
+{
+    const int       width  = buf->plane[pp].width;
+    const ptrdiff_t stride = buf->plane[pp].stride;
+    const int       bps    = pv->depth > 8 ? 2 : 1;
+    uint8_t       * data   = buf->plane[pp].data + y0 * stride;
+
+    if (y1 <= y0)
+    {
+        return;
+    }
+    for (int x = pv->block; x < width - 2; x += pv->block)
+    {
+        deblock_edge_f filter = x + 4 <= width ? pv->filter_vedge :
+                                                 pv->filter_edge;
+
+        filter(data + x * bps, 1, stride / bps, y1 - y0, pv->thresh, pv->max);
+    }
+}
+
+static void deblock_hedge(hb_filter_private_t *pv, hb_buffer_t *buf,
+                          int pp, int y)
+{
+    const ptrdiff_t stride = buf->plane[pp].stride;
+    const int       bps    = pv->depth > 8 ? 2 : 1;
+
+    if (y >= buf->plane[pp].height - 2)
+    {
+        return;
+    }
+    pv->filter_hedge(buf->plane[pp].data + y * stride, stride / bps, 1,
+                     buf->plane[pp].width, pv->thresh, pv->max);
+}
+
+static void deblock_plane_segment(hb_filter_private_t *pv, hb_buffer_t *buf,
+                                  int pp, int start, int stop)
+{
+    const int block  = pv->block;
+    const int height = buf->plane[pp].height;
+
+    for (int row = start; row < stop; row++)
+    {
+        const int y0  = row * block;
+        const int y1  = FFMIN(y0 + block, height);
+        // Rows read by the top edge of the block row before their
+        // vertical edges are filtered
+        const int top = row > 0 ? FFMIN(y0 + DEBLOCK_EDGE_ROWS, y1) : y0;
+
+        switch (pv->pass)
+        {
+            case DEBLOCK_PASS_VERTICAL_BODY:
+                deblock_vedges(pv, buf, pp, top, y1);
+                break;
+
+            case DEBLOCK_PASS_HORIZONTAL:
+                if (row > 0)
+                {
+                    deblock_hedge(pv, buf, pp, y0);
+                }
+                break;
+
+            case DEBLOCK_PASS_VERTICAL_TOP:
+                deblock_vedges(pv, buf, pp, y0, top);
+                break;
 
-    hb_dict_t        * settings = filter->settings;
+            default:
+                if (row > 0)
+                {
+                    deblock_hedge(pv, buf, pp, y0);
+                }
+                deblock_vedges(pv, buf, pp, y0, y1);
+                break;
+        }
+    }
+}
 
-    int      thresh   = -1, blocksize = 8;
-    char  *  strength = NULL;
+static void deblock_filter_work(void *thread_args_v)
+{
+    deblock_thread_arg_t *thread_args = thread_args_v;
+    hb_filter_private_t  *pv = thread_args->pv;
+
+    for (int pp = 0; pp < 3; pp++)
+    {
+        deblock_plane_segment(pv, pv->buf, pp,
+                              thread_args->segment_start[pp],
+                              thread_args->segment_stop[pp]);
+    }
+}
+
+static int deblock_init(hb_filter_object_t * filter, hb_filter_init_t * init)
+{
+    filter->private_data = calloc(1, sizeof(struct hb_filter_private_s));
+    if (filter->private_data == NULL)
+    {
+        hb_error("deblock: calloc failed");
+        return -1;
+    }
+    hb_filter_private_t * pv = filter->private_data;
+    pv->input = *init;
+
+    hb_dict_t * settings = filter->settings;
+    int         thresh   = -1, blocksize = DEBLOCK_BLOCKSIZE_DEFAULT;
+    char      * strength = NULL;
 
     hb_dict_extract_string(&strength, settings, "strength");
     hb_dict_extract_int(&thresh, settings, "thresh");
     hb_dict_extract_int(&blocksize, settings, "blocksize");
 
-    hb_dict_t * avfilter = hb_dict_init();
-    hb_dict_t * avsettings = hb_dict_init();
+    pv->strong = strength == NULL || strcmp(strength, "weak");
+    free(strength);
 
-    if (strength != NULL)
+    if (blocksize < DEBLOCK_BLOCKSIZE_MIN || blocksize > DEBLOCK_BLOCKSIZE_MAX)
     {
-        hb_dict_set_string(avsettings, "filter", strength);
-        free(strength);
+        hb_log("deblock: invalid block size %d, using %d",
+               blocksize, DEBLOCK_BLOCKSIZE_DEFAULT);
+        blocksize = DEBLOCK_BLOCKSIZE_DEFAULT;
     }
-    hb_dict_set_int(avsettings, "block", blocksize);
+    pv->block = blocksize;
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(init->pix_fmt);
+    pv->depth = desc->comp[0].depth;
+    pv->max   = (1 << pv->depth) - 1;
 
+    double alpha = DEBLOCK_ALPHA_DEFAULT, beta = DEBLOCK_BETA_DEFAULT;
     if (thresh > 0)
     {
-        double alpha, beta, gamma, delta;
-
         alpha = thresh * 0.010;
-        beta  = gamma = delta = alpha / 2;
-        hb_dict_set_double(avsettings, "alpha", alpha);
-        hb_dict_set_double(avsettings, "beta", beta);
-        hb_dict_set_double(avsettings, "gamma", gamma);
-        hb_dict_set_double(avsettings, "delta", delta);
+        beta  = alpha / 2;
+    }
+    pv->thresh[0] = alpha * pv->max;
+    pv->thresh[1] = pv->thresh[2] = pv->thresh[3] = beta * pv->max;
+
+    if (pv->depth > 8)
+    {
+        pv->filter_edge = pv->strong ? deblock_edge_strong_16 :
+                                       deblock_edge_weak_16;
+    }
+    else
+    {
+        pv->filter_edge = pv->strong ? deblock_edge_strong_8 :
+                                       deblock_edge_weak_8;
+    }
+    pv->filter_hedge = pv->filter_edge;
+    pv->filter_vedge = pv->filter_edge;
+#if defined(ARCH_X86)
+    if (pv->depth == 8 && av_get_cpu_flags() & AV_CPU_FLAG_SSE2 &&
+        !hb_get_reference_kernels())
+    {
+        pv->filter_hedge = pv->strong ? deblock_hedge_strong_sse2 :
+                                        deblock_hedge_weak_sse2;
+        pv->filter_vedge = pv->strong ? deblock_vedge_strong_sse2 :
+                                        deblock_vedge_weak_sse2;
+    }
+#endif
+
+    /*
+     * Split the frame in segments of whole block rows.  The top edges of
+     * smaller blocks overlap, they are filtered by one thread.
+     */
+    int block_rows = (init->geometry.height + pv->block - 1) / pv->block;
+    pv->cpu_count = FFMAX(1, FFMIN(hb_get_thread_count(), block_rows));
+    if (pv->block < 2 * DEBLOCK_EDGE_ROWS)
+    {
+        pv->cpu_count = 1;
+    }
+
+    if (taskset_init(&pv->deblock_taskset, "deblock_filter_segment",
+                     pv->cpu_count, sizeof(deblock_thread_arg_t),
+                     deblock_filter_work) == 0)
+    {
+        hb_error("deblock could not initialize taskset");
+        return -1;
+    }
+
+    for (int ii = 0; ii < pv->cpu_count; ii++)
+    {
+        deblock_thread_arg_t *thread_args;
+
+        thread_args = taskset_thread_args(&pv->deblock_taskset, ii);
+        thread_args->pv = pv;
+        thread_args->arg.segment = ii;
+        thread_args->arg.taskset = &pv->deblock_taskset;
+
+        for (int pp = 0; pp < 3; pp++)
+        {
+            int height = hb_image_height(init->pix_fmt,
+                                         init->geometry.height, pp);
+            int rows   = (height + pv->block - 1) / pv->block;
+
+            thread_args->segment_start[pp] = rows * ii / pv->cpu_count;
+            thread_args->segment_stop[pp]  = rows * (ii + 1) / pv->cpu_count;
+        }
     }
-    hb_dict_set(avfilter, "deblock", avsettings);
-    pv->avfilters = avfilter;
 
     pv->output = *init;
 
     return 0;
 }
+
+static hb_filter_info_t * deblock_info(hb_filter_object_t * filter)
+{
+    hb_filter_private_t * pv = filter->private_data;
+    hb_filter_info_t    * info;
+
+    if (pv == NULL)
+    {
+        return NULL;
+    }
+
+    info = calloc(1, sizeof(hb_filter_info_t));
+    if (info == NULL)
+    {
+        hb_error("deblock_info: allocation failure");
+        return NULL;
+    }
+    info->output = pv->output;
+    info->human_readable_desc = hb_strdup_printf(
+        "strength: %s, block: %d, alpha: %d, beta: %d",
+        pv->strong ? "strong" : "weak", pv->block,
+        pv->thresh[0], pv->thresh[1]);
+
+    return info;
+}
+
+static void deblock_close(hb_filter_object_t * filter)
+{
+    hb_filter_private_t * pv = filter->private_data;
+
+    if (pv == NULL)
+    {
+        return;
+    }
+
+    taskset_fini(&pv->deblock_taskset);
+
+    free(pv);
+    filter->private_data = NULL;
+}
+
+static int deblock_work(hb_filter_object_t * filter,
+                        hb_buffer_t ** buf_in, hb_buffer_t ** buf_out)
+{
+    hb_filter_private_t * pv = filter->private_data;
+    hb_buffer_t         * in = *buf_in, * out;
+
+    if (in->s.flags & HB_BUF_FLAG_EOF)
+    {
+        *buf_out = in;
+        *buf_in = NULL;
+        return HB_FILTER_DONE;
+    }
+
+    if (hb_buffer_is_writable(in))
+    {
+        out = in;
+        *buf_in = NULL;
+    }
+    else
+    {
+        out = hb_buffer_dup(in);
+        if (out == NULL)
+        {
+            hb_error("deblock: buffer allocation failure");
+            return HB_FILTER_FAILED;
+        }
+    }
+
+    pv->buf = out;
+    if (pv->block < 2 * DEBLOCK_EDGE_ROWS)
+    {
+        pv->pass = DEBLOCK_PASS_SEQUENTIAL;
+        taskset_cycle(&pv->deblock_taskset);
+    }
+    else
+    {
+        pv->pass = DEBLOCK_PASS_VERTICAL_BODY;
+        taskset_cycle(&pv->deblock_taskset);
+        pv->pass = DEBLOCK_PASS_HORIZONTAL;
+        taskset_cycle(&pv->deblock_taskset);
+        pv->pass = DEBLOCK_PASS_VERTICAL_TOP;
+        taskset_cycle(&pv->deblock_taskset);
+    }
+    pv->buf = NULL;
+
+    *buf_out = out;
+
+    return HB_FILTER_OK;
+}
@@ -137,6 +137,7 @@ struct hb_work_private_s
     uint32_t               decode_errors;
     packet_info_t          packet_info;
     uint8_t                unfinished;
+    uint8_t                parse_tail[2 * AV_INPUT_BUFFER_PADDING_SIZE];
     reordered_data_t     * reordered_hash[REORDERED_HASH_SZ];
     int64_t                sequence;
     int                    last_scr_sequence;
@@ -156,6 +157,52 @@ struct hb_work_private_s
 
 static void decodeAudio( hb_work_private_t *pv, packet_info_t * packet_info );
 
+/***********************************************************************
+ * Parser input padding
+ ***********************************************************************
+ * libavcodec/mpeg12dec.c requires buffers to be zero padded.
+ * If not zero padded, it can get stuck in an infinite loop.
+ * It's likely there are other decoders and parsers that expect the same.
+ *
+ * Buffers sharing another buffer's data (e.g. DVD video sliced out of
+ * the pack buffer) have no padding of their own.  Their last bytes are
+ * given to the parser from a zero padded copy instead, so reads past
+ * the end of the parser input always hit zeroed memory.
+ *
+ * parse_pad returns the size of the part of 'in' that is parsed in
+ * place.
+ **********************************************************************/
+static int parse_pad( hb_work_private_t * pv, hb_buffer_t * in )
+{
+    int tail;
+
+    if (in->data == NULL)
+    {
+        return 0;
+    }
+    if (in->alloc >= in->size + AV_INPUT_BUFFER_PADDING_SIZE)
+    {
+        memset(in->data + in->size, 0, in->alloc - in->size);
+        return in->size;
+    }
+    tail = MIN(in->size, AV_INPUT_BUFFER_PADDING_SIZE);
+    memcpy(pv->parse_tail, in->data + in->size - tail, tail);
+    memset(pv->parse_tail + tail, 0, sizeof(pv->parse_tail) - tail);
+    return in->size - tail;
+}
+
+static uint8_t * parse_data( hb_work_private_t * pv, hb_buffer_t * in,
+                             int padded, int pos, int * size )
+{
+    if (pos < padded)
+    {
+        *size = padded - pos;
+        return in->data + pos;
+    }
+    *size = in->size - pos;
+    return pv->parse_tail + pos - padded;
+}
+
 #define HB_AV_CH_SIDE_MASK (AV_CH_SIDE_LEFT|AV_CH_SIDE_RIGHT)
 #define HB_AV_CH_BACK_MASK (AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT)
 #define HB_AV_CH_BOTH_MASK (HB_AV_CH_SIDE_MASK|HB_AV_CH_BACK_MASK)
@@ -644,14 +691,7 @@ static int decavcodecaWork( hb_work_object_t * w, hb_buffer_t ** buf_in,
 {
     hb_work_private_t * pv = w->private_data;
     hb_buffer_t * in = *buf_in;
-
-    // libavcodec/mpeg12dec.c requires buffers to be zero padded.
-    // If not zero padded, it can get stuck in an infinite loop.
-    // It's likely there are other decoders that expect the same.
-    if (in->data != NULL)
-    {
-        memset(in->data + in->size, 0, in->alloc - in->size);
-    }
+    int padded = parse_pad(pv, in);
 
     if (in->s.flags & HB_BUF_FLAG_EOF)
     {
@@ -697,9 +737,12 @@ static int decavcodecaWork( hb_work_object_t * w, hb_buffer_t ** buf_in,
 
         if ( pv->parser != NULL )
         {
+            uint8_t * data;
+            int       size;
+
+            data = parse_data(pv, in, padded, pos, &size);
             len = av_parser_parse2(pv->parser, pv->context, &pout, &pout_len,
-                                   in->data + pos, in->size - pos,
-                                   pts, pts, 0 );
+                                   data, size, pts, pts, 0 );
             parser_pts = pv->parser->pts;
             pts = AV_NOPTS_VALUE;
         }
@@ -2179,16 +2222,10 @@ static int decavcodecvWork( hb_work_object_t * w, hb_buffer_t ** buf_in,
     hb_work_private_t * pv     = w->private_data;
     hb_buffer_t       * in     = *buf_in;
     int                 result = HB_WORK_OK;
+    int                 padded = parse_pad(pv, in);
 
     *buf_out = NULL;
 
-    // libavcodec/mpeg12dec.c requires buffers to be zero padded.
-    // If not zero padded, it can get stuck in an infinite loop.
-    // It's likely there are other decoders that expect the same.
-    if (in->data != NULL)
-    {
-        memset(in->data + in->size, 0, in->alloc - in->size);
-    }
     if (in->palette != NULL)
     {
         pv->palette = in->palette;
@@ -2268,9 +2305,12 @@ static int decavcodecvWork( hb_work_object_t * w, hb_buffer_t ** buf_in,
         if (pv->parser)
         {
             int codec_id = pv->context->codec_id;
+            uint8_t * data;
+            int       size;
+
+            data = parse_data(pv, in, padded, pos, &size);
             len = av_parser_parse2(pv->parser, pv->context, &pout, &pout_len,
-                                   in->data + pos, in->size - pos,
-                                   pts, dts, 0 );
+                                   data, size, pts, dts, 0 );
             parser_pts = pv->parser->pts;
             parser_dts = pv->parser->dts;
             pts = AV_NOPTS_VALUE;
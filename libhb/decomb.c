@@ -271,7 +271,7 @@ static int hb_decomb_init(hb_filter_object_t *filter,
         }
     }
 
-    pv->cpu_count = hb_get_cpu_count();
+    pv->cpu_count = hb_get_thread_count();
 
     // Make segment sizes an even number of lines
     int height = hb_image_height(init->pix_fmt, init->geometry.height, 0);
@@ -540,6 +540,8 @@ static void process_frame(hb_filter_private_t *pv)
 
             // Copy buffered settings to output buffer settings
             hb_buffer_copy_props(buf, pv->ref[1]);
+            // Analysis was made on the combed picture
+            buf->s.analysis.flags = 0;
 
             hb_buffer_list_append(&pv->out_list, buf);
         }
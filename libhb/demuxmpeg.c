@@ -70,18 +70,84 @@ static inline void restore_chap( hb_psdemux_t *state, hb_buffer_t *buf )
     }
 }
 
+static void release_pack( void *opaque, uint8_t *data )
+{
+    hb_buffer_t *buf = opaque;
+    hb_buffer_close( &buf );
+}
+
+// Make an ES buffer that shares the payload with the pack buffer when
+// it is reference counted, copy it otherwise.  A slice keeps the whole
+// pack buffer alive, so only video, which makes up most of a pack buffer
+// and is consumed promptly by the decoder, is sliced.  Small audio and
+// subtitle payloads can be queued for a long time and are copied.
+static hb_buffer_t * es_slice( AVBufferRef *pack_ref,
+                               const uint8_t *data, int size )
+{
+    hb_buffer_t *buf_es = NULL;
+
+    if ( pack_ref != NULL )
+    {
+        AVBufferRef *ref = av_buffer_ref( pack_ref );
+        if ( ref != NULL )
+        {
+            buf_es = hb_buffer_wrap_avbuffer( ref );
+        }
+        if ( buf_es != NULL )
+        {
+            buf_es->data = (uint8_t *)data;
+            buf_es->size = size;
+            return buf_es;
+        }
+    }
+    buf_es = hb_buffer_init( size );
+    memcpy( buf_es->data, data, size );
+    return buf_es;
+}
+
 /* Basic MPEG demuxer */
 
+// A buffer holds one or more consecutive DVD packs, each exactly
+// HB_DVD_READ_BUFFER_SIZE bytes long. Video payloads are slices of it,
+// and it is released when the last of them is closed.
 static void demux_dvd_ps( hb_buffer_t * buf, hb_buffer_list_t * list_es,
                           hb_psdemux_t* state )
 {
     hb_buffer_t * buf_es;
-    int           pos = 0;
+    hb_buffer_t * next = NULL;
+    AVBufferRef * pack_ref = NULL;
+    int           pack = 0, pack_end;
+    int           pos;
 
     while ( buf )
     {
+        if ( pack == 0 )
+        {
+            next      = buf->next;
+            buf->next = NULL;
+            pack_ref  = av_buffer_create( buf->data, buf->size, release_pack,
+                                          buf, AV_BUFFER_FLAG_READONLY );
+        }
+        if ( pack >= buf->size )
+        {
+            if ( pack_ref != NULL )
+            {
+                av_buffer_unref( &pack_ref );
+            }
+            else
+            {
+                hb_buffer_close( &buf );
+            }
+            buf  = next;
+            pack = 0;
+            continue;
+        }
         save_chap( state, buf );
 
+        pos      = pack;
+        pack_end = MIN( pack + HB_DVD_READ_BUFFER_SIZE, buf->size );
+        pack     = pack_end;
+
 #define d (buf->data)
         /* pack_header */
         if( d[pos] != 0 || d[pos+1] != 0 ||
@@ -89,10 +155,6 @@ static void demux_dvd_ps( hb_buffer_t * buf, hb_buffer_list_t * list_es,
         {
             hb_log( "demux_dvd_ps: not a PS packet (%02x%02x%02x%02x)",
                     d[pos], d[pos+1], d[pos+2], d[pos+3] );
-            hb_buffer_t *tmp = buf->next;
-            buf->next = NULL;
-            hb_buffer_close( &buf );
-            buf = tmp;
             continue;
         }
         pos += 4;                    /* pack_start_code */
@@ -125,7 +187,7 @@ static void demux_dvd_ps( hb_buffer_t * buf, hb_buffer_list_t * list_es,
         }
 
         /* pes */
-        while( pos + 6 < buf->size &&
+        while( pos + 6 < pack_end &&
                d[pos] == 0 && d[pos+1] == 0 && d[pos+2] == 0x1 )
         {
             int      id;
@@ -159,7 +221,7 @@ static void demux_dvd_ps( hb_buffer_t * buf, hb_buffer_list_t * list_es,
 
             pes_packet_length  = ( d[pos] << 8 ) + d[pos+1];
             pos               += 2;               /* pes_packet_length */
-            pes_packet_end     = pos + pes_packet_length;
+            pes_packet_end     = MIN( pos + pes_packet_length, pack_end );
 
             if( id != 0xE0 && id != 0xBD &&
                 ( id & 0xC0 ) != 0xC0  )
@@ -221,7 +283,8 @@ static void demux_dvd_ps( hb_buffer_t * buf, hb_buffer_list_t * list_es,
             }
 
             /* Here we hit we ES payload */
-            buf_es = hb_buffer_init( pes_packet_end - pos );
+            buf_es = es_slice( id == 0xE0 ? pack_ref : NULL,
+                               d + pos, pes_packet_end - pos );
 
             buf_es->s.id           = id;
             buf_es->s.start        = pts;
@@ -233,16 +296,11 @@ static void demux_dvd_ps( hb_buffer_t * buf, hb_buffer_list_t * list_es,
                 // Consume a chapter break, and apply it to the ES.
                 restore_chap( state, buf_es );
             }
-            memcpy( buf_es->data, d + pos, pes_packet_end - pos );
 
             hb_buffer_list_append(list_es, buf_es);
 
             pos = pes_packet_end;
         }
-        hb_buffer_t *tmp = buf->next;
-        buf->next = NULL;
-        hb_buffer_close( &buf );
-        buf = tmp;
     }
 #undef d
 }
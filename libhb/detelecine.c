@@ -1258,6 +1258,8 @@ static int hb_detelecine_work( hb_filter_object_t * filter,
     pullup_release_frame( frame );
 
     hb_buffer_copy_props(out, in);
+    // The frame was reassembled from fields, analysis of 'in' is stale
+    out->s.analysis.flags = 0;
     *buf_out = out;
 
 output_frame:
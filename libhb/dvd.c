@@ -25,6 +25,7 @@ static hb_title_t  * hb_dvdread_title_scan( hb_dvd_t * d, int t, uint64_t min_du
 static int           hb_dvdread_start( hb_dvd_t * d, hb_title_t *title, int chapter );
 static void          hb_dvdread_stop( hb_dvd_t * d );
 static int           hb_dvdread_seek( hb_dvd_t * d, float f );
+static int64_t       hb_dvdread_seek_pts( hb_dvd_t * d, int64_t pts );
 static hb_buffer_t * hb_dvdread_read( hb_dvd_t * d );
 static int           hb_dvdread_chapter( hb_dvd_t * d );
 static int           hb_dvdread_angle_count( hb_dvd_t * d );
@@ -41,6 +42,7 @@ hb_dvd_func_t hb_dvdread_func =
     hb_dvdread_start,
     hb_dvdread_stop,
     hb_dvdread_seek,
+    hb_dvdread_seek_pts,
     hb_dvdread_read,
     hb_dvdread_chapter,
     hb_dvdread_angle_count,
@@ -847,6 +849,16 @@ static void hb_dvdread_stop( hb_dvd_t * e )
     }
 }
 
+/***********************************************************************
+ * hb_dvdread_seek_pts
+ ***********************************************************************
+ * Not supported by the dvdread backend; sync.c skips to the start time.
+ **********************************************************************/
+static int64_t hb_dvdread_seek_pts( hb_dvd_t * e, int64_t pts )
+{
+    return -1;
+}
+
 /***********************************************************************
  * hb_dvdread_seek
  ***********************************************************************
@@ -1419,6 +1431,11 @@ int hb_dvd_seek( hb_dvd_t * d, float f )
     return dvd_methods->seek(d, f);
 }
 
+int64_t hb_dvd_seek_pts( hb_dvd_t * d, int64_t pts )
+{
+    return dvd_methods->seek_pts(d, pts);
+}
+
 hb_buffer_t * hb_dvd_read( hb_dvd_t * d )
 {
     return dvd_methods->read(d);
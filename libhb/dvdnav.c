@@ -27,6 +27,7 @@ static hb_title_t  * hb_dvdnav_title_scan( hb_dvd_t * d, int t, uint64_t min_dur
 static int           hb_dvdnav_start( hb_dvd_t * d, hb_title_t *title, int chapter );
 static void          hb_dvdnav_stop( hb_dvd_t * d );
 static int           hb_dvdnav_seek( hb_dvd_t * d, float f );
+static int64_t       hb_dvdnav_seek_pts( hb_dvd_t * d, int64_t pts );
 static hb_buffer_t * hb_dvdnav_read( hb_dvd_t * d );
 static int           hb_dvdnav_chapter( hb_dvd_t * d );
 static void          hb_dvdnav_close( hb_dvd_t ** _d );
@@ -44,6 +45,7 @@ hb_dvd_func_t hb_dvdnav_func =
     hb_dvdnav_start,
     hb_dvdnav_stop,
     hb_dvdnav_seek,
+    hb_dvdnav_seek_pts,
     hb_dvdnav_read,
     hb_dvdnav_chapter,
     hb_dvdnav_angle_count,
@@ -65,6 +67,9 @@ static int FindNextCell( pgc_t *pgc, int cell_cur );
 static int dvdtime2msec( dvd_time_t * );
 static int TitleOpenIfo(hb_dvdnav_t * d, int t);
 static void TitleCloseIfo(hb_dvdnav_t * d);
+static void ReadReset( hb_dvdnav_t * d );
+static int  NavOpen( hb_dvdnav_t * d, const char * path );
+static void NavClose( hb_dvdnav_t * d );
 
 hb_dvd_func_t * hb_dvdnav_methods( void )
 {
@@ -103,11 +108,10 @@ static char * hb_dvdnav_name( char * path )
  **********************************************************************/
 static int hb_dvdnav_reset( hb_dvdnav_t * d )
 {
-    if ( d->dvdnav )
-        dvdnav_close( d->dvdnav );
+    NavClose( d );
 
     /* Open device */
-    if( dvdnav_open(&d->dvdnav, d->path) != DVDNAV_STATUS_OK )
+    if( !NavOpen( d, d->path ) )
     {
         /*
          * Not an error, may be a stream - which we'll try in a moment.
@@ -139,7 +143,7 @@ static int hb_dvdnav_reset( hb_dvdnav_t * d )
     return 1;
 
 fail:
-    if( d->dvdnav ) dvdnav_close( d->dvdnav );
+    NavClose( d );
     return 0;
 }
 
@@ -169,7 +173,7 @@ static hb_dvd_t * hb_dvdnav_init( hb_handle_t * h, const char * path )
     }
 
     /* Open device */
-    if( dvdnav_open(&d->dvdnav, path) != DVDNAV_STATUS_OK )
+    if( !NavOpen( d, path ) )
     {
         /*
          * Not an error, may be a stream - which we'll try in a moment.
@@ -220,7 +224,7 @@ static hb_dvd_t * hb_dvdnav_init( hb_handle_t * h, const char * path )
     return e;
 
 fail:
-    if( d->dvdnav ) dvdnav_close( d->dvdnav );
+    NavClose( d );
     if( d->vmg )    ifoClose( d->vmg );
     if( d->reader ) DVDClose( d->reader );
     free( e );
@@ -877,6 +881,185 @@ static int find_title( hb_list_t * list_title, int title )
     return -1;
 }
 
+// Menu walking only needs navigation events.  Read through libdvdnav's
+// block cache so that data blocks are not copied out, and hand them
+// straight back.  Event payloads are still written to 'buf'.
+static dvdnav_status_t nav_next_block( dvdnav_t * dvdnav, uint8_t * buf,
+                                       int32_t * event, int32_t * len )
+{
+    uint8_t * block = buf;
+    dvdnav_status_t result;
+
+    result = dvdnav_get_next_cache_block( dvdnav, &block, event, len );
+    if ( result == DVDNAV_STATUS_OK && block != buf )
+    {
+        dvdnav_free_cache_block( dvdnav, block );
+    }
+    return result;
+}
+
+// Once playback enters the title domain, only read this many more blocks
+// before judging the title.  This is still enough to catch "fake" titles
+// that jump to the real one right after they start.
+#define TITLE_CONFIRM_BLOCKS 256
+
+/***********************************************************************
+ * Main feature cache
+ ***********************************************************************
+ * Walking the menus is slow, so the result is remembered per disc in
+ * the user config directory, keyed by the libdvdread disc id.
+ *
+ * Several scans may update the cache at once (queue, watch folder), so
+ * updates hold a lock file and replace the cache with a rename.  Only
+ * the most recently used entries are kept.
+ **********************************************************************/
+#define MAIN_FEATURE_CACHE_DIR  "HandBrake"
+#define MAIN_FEATURE_CACHE_FILE "HandBrake/dvd-main-feature.json"
+#define MAIN_FEATURE_CACHE_MAX  256
+// A lock file older than this was left by a crash
+#define MAIN_FEATURE_LOCK_STALE 30
+#define MAIN_FEATURE_LOCK_TRIES 100
+
+static int main_feature_key( hb_dvdnav_t * d, char key[33] )
+{
+    unsigned char discid[16];
+    int ii;
+
+    if ( DVDDiscID( d->reader, discid ) < 0 )
+    {
+        return 0;
+    }
+    for ( ii = 0; ii < 16; ii++ )
+    {
+        snprintf( &key[ii * 2], 3, "%02x", discid[ii] );
+    }
+    return 1;
+}
+
+static int main_feature_cache_lock( const char * lock_path )
+{
+    int ii;
+
+    for ( ii = 0; ii < MAIN_FEATURE_LOCK_TRIES; ii++ )
+    {
+        FILE * file = hb_fopen( lock_path, "wx" );
+        hb_stat_t sb;
+
+        if ( file != NULL )
+        {
+            fclose( file );
+            return 1;
+        }
+        if ( hb_stat( lock_path, &sb ) == 0 &&
+             time( NULL ) - sb.st_mtime > MAIN_FEATURE_LOCK_STALE )
+        {
+            hb_unlink( lock_path );
+            continue;
+        }
+        hb_snooze( 20 );
+    }
+    return 0;
+}
+
+// Entries are {Title, Time}, Time being when the entry was last used
+static int main_feature_cache_title( hb_value_t * entry, int64_t * used )
+{
+    if ( entry == NULL || hb_value_type( entry ) != HB_VALUE_TYPE_DICT )
+    {
+        return -1;
+    }
+    if ( used != NULL )
+    {
+        *used = hb_dict_get_int( entry, "Time" );
+    }
+    return hb_dict_get_int( entry, "Title" );
+}
+
+static void main_feature_cache_evict( hb_dict_t * cache )
+{
+    while ( hb_dict_elements( cache ) > MAIN_FEATURE_CACHE_MAX )
+    {
+        hb_dict_iter_t iter = hb_dict_iter_init( cache );
+        const char   * key, * oldest = NULL;
+        hb_value_t   * entry;
+        int64_t        used, oldest_used = INT64_MAX;
+
+        while ( hb_dict_iter_next_ex( cache, &iter, &key, &entry ) )
+        {
+            if ( main_feature_cache_title( entry, &used ) < 0 )
+            {
+                used = INT64_MIN;
+            }
+            if ( used < oldest_used )
+            {
+                oldest      = key;
+                oldest_used = used;
+            }
+        }
+        if ( oldest == NULL )
+        {
+            break;
+        }
+        hb_dict_remove( cache, oldest );
+    }
+}
+
+static int main_feature_cache_get( const char * key )
+{
+    char path[1024];
+    hb_value_t * cache;
+    int title = -1;
+
+    hb_get_user_config_filename( path, "%s", MAIN_FEATURE_CACHE_FILE );
+    cache = hb_value_read_json( path );
+    if ( cache != NULL && hb_value_type( cache ) == HB_VALUE_TYPE_DICT )
+    {
+        title = main_feature_cache_title( hb_dict_get( cache, key ), NULL );
+    }
+    hb_value_free( &cache );
+    return title;
+}
+
+static void main_feature_cache_set( const char * key, int title )
+{
+    char path[1024], tmp_path[1024 + 16], lock_path[1024 + 16];
+    hb_value_t * cache;
+    hb_dict_t  * entry;
+
+    hb_get_user_config_filename( path, "%s", MAIN_FEATURE_CACHE_DIR );
+    hb_mkdir( path );
+    hb_get_user_config_filename( path, "%s", MAIN_FEATURE_CACHE_FILE );
+    snprintf( lock_path, sizeof(lock_path), "%s.lock", path );
+    if ( !main_feature_cache_lock( lock_path ) )
+    {
+        hb_deep_log( 2, "dvdnav: %s is locked, not caching", path );
+        return;
+    }
+
+    cache = hb_value_read_json( path );
+    if ( cache == NULL || hb_value_type( cache ) != HB_VALUE_TYPE_DICT )
+    {
+        hb_value_free( &cache );
+        cache = hb_dict_init();
+    }
+    entry = hb_dict_init();
+    hb_dict_set_int( entry, "Title", title );
+    hb_dict_set_int( entry, "Time", time( NULL ) );
+    hb_dict_set( cache, key, entry );
+    main_feature_cache_evict( cache );
+
+    // Readers never see a partly written cache
+    snprintf( tmp_path, sizeof(tmp_path), "%s.tmp", path );
+    if ( hb_value_write_json( cache, tmp_path ) < 0 ||
+         hb_rename( tmp_path, path ) < 0 )
+    {
+        hb_deep_log( 2, "dvdnav: failed to write %s", path );
+        hb_unlink( tmp_path );
+    }
+    hb_value_free( &cache );
+    hb_unlink( lock_path );
+}
+
 static int skip_to_menu( dvdnav_t * dvdnav, int blocks )
 {
     int ii;
@@ -885,7 +1068,7 @@ static int skip_to_menu( dvdnav_t * dvdnav, int blocks )
 
     for ( ii = 0; ii < blocks; ii++ )
     {
-        result = dvdnav_get_next_block( dvdnav, buf, &event, &len );
+        result = nav_next_block( dvdnav, buf, &event, &len );
         if ( result == DVDNAV_STATUS_ERR )
         {
             hb_error("dvdnav: Read Error, %s", dvdnav_err_to_string(dvdnav));
@@ -1007,9 +1190,11 @@ static int try_button( dvdnav_t * dvdnav, int button, hb_list_t * list_title )
 
     for (jj = 0; jj < 10; jj++)
     {
-        for (ii = 0; ii < 2000; ii++)
+        int blocks = 2000;
+
+        for (ii = 0; ii < blocks; ii++)
         {
-            result = dvdnav_get_next_block( dvdnav, buf, &event, &len );
+            result = nav_next_block( dvdnav, buf, &event, &len );
             if ( result == DVDNAV_STATUS_ERR )
             {
                 hb_error("dvdnav: Read Error, %s", dvdnav_err_to_string(dvdnav));
@@ -1031,6 +1216,10 @@ static int try_button( dvdnav_t * dvdnav, int button, hb_list_t * list_title )
                 // but then jump to the real title early in playback.
                 // So keep reading after finding a long title to detect
                 // such cases.
+                if ( cur_title > 0 )
+                {
+                    blocks = MIN( blocks, ii + TITLE_CONFIRM_BLOCKS );
+                }
             } break;
 
             case DVDNAV_STILL_FRAME:
@@ -1071,6 +1260,10 @@ static int try_button( dvdnav_t * dvdnav, int button, hb_list_t * list_title )
                 // but then jump to the real title early in playback.
                 // So keep reading after finding a long title to detect
                 // such cases.
+                if ( cur_title > 0 )
+                {
+                    blocks = MIN( blocks, ii + TITLE_CONFIRM_BLOCKS );
+                }
             } break;
 
             case DVDNAV_HIGHLIGHT:
@@ -1179,7 +1372,7 @@ static int try_menu(
     {
         for (ii = 0; ii < 4000; ii++)
         {
-            result = dvdnav_get_next_block( d->dvdnav, buf, &event, &len );
+            result = nav_next_block( d->dvdnav, buf, &event, &len );
             if ( result == DVDNAV_STATUS_ERR )
             {
                 hb_error("dvdnav: Read Error, %s", dvdnav_err_to_string(d->dvdnav));
@@ -1330,6 +1523,20 @@ static int hb_dvdnav_main_feature( hb_dvd_t * e, hb_list_t * list_title )
     int avg_cnt = 0;
     hb_title_t * title;
     int index;
+    int longest;
+
+    char key[33];
+    int have_key = main_feature_key( d, key );
+    if ( have_key )
+    {
+        longest = main_feature_cache_get( key );
+        if ( longest >= 0 && find_title( list_title, longest ) >= 0 )
+        {
+            hb_deep_log( 2, "dvdnav: Using cached main feature title %d",
+                         longest );
+            return longest;
+        }
+    }
 
     hb_deep_log( 2, "dvdnav: Searching menus for main feature" );
     for ( ii = 0; ii < hb_list_count( list_title ); ii++ )
@@ -1423,7 +1630,6 @@ static int hb_dvdnav_main_feature( hb_dvd_t * e, hb_list_t * list_title )
     }
 
     uint64_t longest_duration;
-    int longest;
 
     if ( longest_duration_root > longest_duration_title )
     {
@@ -1447,6 +1653,10 @@ static int hb_dvdnav_main_feature( hb_dvd_t * e, hb_list_t * list_title )
             hb_deep_log( 2, "dvdnav: Using longest title %d", longest );
         }
     }
+    if ( have_key && longest >= 0 )
+    {
+        main_feature_cache_set( key, longest );
+    }
     return longest;
 }
 
@@ -1485,6 +1695,7 @@ static int hb_dvdnav_start( hb_dvd_t * e, hb_title_t *title, int c )
     d->stopped = 0;
     d->chapter = 0;
     d->cell = 0;
+    ReadReset(d);
     return 1;
 }
 
@@ -1498,66 +1709,37 @@ static void hb_dvdnav_stop( hb_dvd_t * e )
 }
 
 /***********************************************************************
- * hb_dvdnav_seek
+ * SeekSector
  ***********************************************************************
- *
+ * Position dvdnav at a PGC relative sector.  If 'chapter' is set and
+ * lies in a different PGC than the one currently playing, switch to it
+ * first.
  **********************************************************************/
-static int hb_dvdnav_seek( hb_dvd_t * e, float f )
+static int SeekSector( hb_dvdnav_t * d, hb_dvd_chapter_t * chapter,
+                       uint64_t sector )
 {
-    hb_dvdnav_t * d = &(e->dvdnav);
-    uint64_t sector = f * d->title_block_count;
     int result, event, len;
     uint8_t buf[HB_DVD_READ_BUFFER_SIZE];
     int done = 0, ii;
 
-    if (d->stopped)
-    {
-        return 0;
-    }
-
-    // XXX the current version of libdvdnav can't seek outside the current
-    // PGC. Check if the place we're seeking to is in a different
-    // PGC. Position there & adjust the offset if so.
-    uint64_t pgc_offset = 0;
-    uint64_t chap_offset = 0;
-    hb_dvd_chapter_t *pgc_change = hb_list_item(d->list_dvd_chapter, 0 );
-    for ( ii = 0; ii < hb_list_count( d->list_dvd_chapter ); ++ii )
+    if ( chapter != NULL )
     {
-        hb_dvd_chapter_t *chapter = hb_list_item( d->list_dvd_chapter, ii );
-        uint64_t chap_len = chapter->block_end - chapter->block_start + 1;
+        int32_t title, pgcn, pgn;
+        if (dvdnav_current_title_program( d->dvdnav, &title, &pgcn, &pgn ) != DVDNAV_STATUS_OK)
+            hb_log("dvdnav cur pgcn err: %s", dvdnav_err_to_string(d->dvdnav));
+        // If we find ourselves in a new title, it means a title
+        // transition was made while reading data.  Jumping between
+        // titles can cause the vm to get into a bad state.  So
+        // reset the vm in this case.
+        if ( d->title != title )
+            dvdnav_reset( d->dvdnav );
 
-        if ( chapter->pgcn != pgc_change->pgcn )
+        if ( d->title != title || chapter->pgcn != pgcn )
         {
-            // this chapter's in a different pgc from the previous - note the
-            // change so we can make sector offset's be pgc relative.
-            pgc_offset = chap_offset;
-            pgc_change = chapter;
+            // this chapter is in a different pgc - switch to it.
+            if (dvdnav_program_play(d->dvdnav, d->title, chapter->pgcn, chapter->pgn) != DVDNAV_STATUS_OK)
+                hb_log("dvdnav prog play err: %s", dvdnav_err_to_string(d->dvdnav));
         }
-        if ( chap_offset <= sector && sector < chap_offset + chap_len )
-        {
-            // this chapter contains the sector we want - see if it's in a
-            // different pgc than the one we're currently in.
-            int32_t title, pgcn, pgn;
-            if (dvdnav_current_title_program( d->dvdnav, &title, &pgcn, &pgn ) != DVDNAV_STATUS_OK)
-                hb_log("dvdnav cur pgcn err: %s", dvdnav_err_to_string(d->dvdnav));
-            // If we find ourselves in a new title, it means a title
-            // transition was made while reading data.  Jumping between
-            // titles can cause the vm to get into a bad state.  So
-            // reset the vm in this case.
-            if ( d->title != title )
-                dvdnav_reset( d->dvdnav );
-
-            if ( d->title != title || chapter->pgcn != pgcn )
-            {
-                // this chapter is in a different pgc - switch to it.
-                if (dvdnav_program_play(d->dvdnav, d->title, chapter->pgcn, chapter->pgn) != DVDNAV_STATUS_OK)
-                    hb_log("dvdnav prog play err: %s", dvdnav_err_to_string(d->dvdnav));
-            }
-            // seek sectors are pgc-relative so remove the pgc start sector.
-            sector -= pgc_offset;
-            break;
-        }
-        chap_offset += chap_len;
     }
 
     // dvdnav will not let you seek or poll current position
@@ -1613,9 +1795,459 @@ static int hb_dvdnav_seek( hb_dvd_t * e, float f )
     }
     d->chapter = 0;
     d->cell = 0;
+    ReadReset(d);
     return 1;
 }
 
+/***********************************************************************
+ * hb_dvdnav_seek
+ ***********************************************************************
+ *
+ **********************************************************************/
+static int hb_dvdnav_seek( hb_dvd_t * e, float f )
+{
+    hb_dvdnav_t * d = &(e->dvdnav);
+    uint64_t sector = f * d->title_block_count;
+    int ii;
+
+    if (d->stopped)
+    {
+        return 0;
+    }
+
+    // XXX the current version of libdvdnav can't seek outside the current
+    // PGC. Check if the place we're seeking to is in a different
+    // PGC. Position there & adjust the offset if so.
+    uint64_t pgc_offset = 0;
+    uint64_t chap_offset = 0;
+    hb_dvd_chapter_t *pgc_change = hb_list_item(d->list_dvd_chapter, 0 );
+    hb_dvd_chapter_t *seek_chapter = NULL;
+    for ( ii = 0; ii < hb_list_count( d->list_dvd_chapter ); ++ii )
+    {
+        hb_dvd_chapter_t *chapter = hb_list_item( d->list_dvd_chapter, ii );
+        uint64_t chap_len = chapter->block_end - chapter->block_start + 1;
+
+        if ( chapter->pgcn != pgc_change->pgcn )
+        {
+            // this chapter's in a different pgc from the previous - note the
+            // change so we can make sector offset's be pgc relative.
+            pgc_offset = chap_offset;
+            pgc_change = chapter;
+        }
+        if ( chap_offset <= sector && sector < chap_offset + chap_len )
+        {
+            // this chapter contains the sector we want.
+            // seek sectors are pgc-relative so remove the pgc start sector.
+            seek_chapter = chapter;
+            sector -= pgc_offset;
+            break;
+        }
+        chap_offset += chap_len;
+    }
+
+    return SeekSector(d, seek_chapter, sector);
+}
+
+/***********************************************************************
+ * hb_dvdnav_seek_pts
+ ***********************************************************************
+ * Seek to the VOBU that starts at or before title time 'pts'.  The cell
+ * holding 'pts' is found from the cell playback times and the VOBU
+ * within that cell from the VTS time map.  Returns the title time of
+ * the VOBU, or -1 if the seek could not be done.
+ **********************************************************************/
+static int64_t hb_dvdnav_seek_pts( hb_dvd_t * e, int64_t pts )
+{
+    hb_dvdnav_t      * d = &(e->dvdnav);
+    hb_dvd_chapter_t * chapter = NULL;
+    pgc_t            * pgc;
+    cell_playback_t  * cp = NULL;
+    int64_t            title_time = 0, chapter_time = 0, pgc_time = 0;
+    int64_t            cell_dur, target, landing = 0;
+    uint64_t           offset = 0;
+    uint32_t           sector;
+    int                ii, count, cell, cell_start;
+
+    if (d->stopped || d->ifo == NULL)
+    {
+        return -1;
+    }
+
+    count = hb_list_count(d->list_dvd_chapter);
+    for (ii = 0; ii < count; ii++)
+    {
+        chapter = hb_list_item(d->list_dvd_chapter, ii);
+        if (title_time + chapter->duration > pts)
+        {
+            break;
+        }
+        title_time += chapter->duration;
+    }
+    if (ii >= count)
+    {
+        return -1;
+    }
+
+    // Walk the cells of the PGC up to the one holding pts. Track the PGC
+    // relative time (what the time map is indexed by) and the PGC relative
+    // sector (what dvdnav_sector_search expects).  Like dvdnav, only the
+    // first cell of an angle block is counted.
+    pgc        = d->ifo->vts_pgcit->pgci_srp[chapter->pgcn - 1].pgc;
+    cell_start = pgc->program_map[chapter->pgn - 1] - 1;
+    target     = pts - title_time;
+    for (cell = 0; cell < pgc->nr_of_cells; cell++)
+    {
+        cp = &pgc->cell_playback[cell];
+        if (cp->block_type == BLOCK_TYPE_ANGLE_BLOCK &&
+            cp->block_mode != BLOCK_MODE_FIRST_CELL)
+        {
+            continue;
+        }
+        cell_dur = 90LL * dvdtime2msec(&cp->playback_time);
+        if (cell == cell_start)
+        {
+            chapter_time = pgc_time;
+        }
+        if (cell >= cell_start &&
+            (target < cell_dur || cell == pgc->nr_of_cells - 1))
+        {
+            break;
+        }
+        if (cell >= cell_start)
+        {
+            target -= cell_dur;
+        }
+        pgc_time += cell_dur;
+        offset   += cp->last_sector - cp->first_sector + 1;
+    }
+    if (cp == NULL || cell >= pgc->nr_of_cells)
+    {
+        return -1;
+    }
+
+    // Time map entry n holds the VOBU that plays at (n + 1) time units
+    // into the PGC.  Use the last entry at or before pts that lies in
+    // this cell, otherwise start at the beginning of the cell.
+    sector = cp->first_sector;
+    if (d->ifo->vts_tmapt != NULL &&
+        chapter->pgcn <= d->ifo->vts_tmapt->nr_of_tmaps)
+    {
+        vts_tmap_t * tmap = &d->ifo->vts_tmapt->tmap[chapter->pgcn - 1];
+        if (tmap->tmu > 0 && tmap->nr_of_entries > 0)
+        {
+            int64_t unit = 90000LL * tmap->tmu;
+            int64_t idx  = (pgc_time + target) / unit - 1;
+
+            idx = MIN(idx, tmap->nr_of_entries - 1);
+            for (; idx >= 0 && (idx + 1) * unit >= pgc_time; idx--)
+            {
+                uint32_t s = tmap->map_ent[idx] & 0x7fffffff;
+                if (s >= cp->first_sector && s <= cp->last_sector)
+                {
+                    sector  = s;
+                    landing = (idx + 1) * unit - pgc_time;
+                    break;
+                }
+            }
+        }
+    }
+    offset += sector - cp->first_sector;
+
+    if (!SeekSector(d, chapter, offset))
+    {
+        return -1;
+    }
+
+    landing += title_time + pgc_time - chapter_time;
+    hb_deep_log(2, "dvdnav: seek to %"PRId64" landed at %"PRId64
+                " (sector %"PRIu32")", pts, landing, sector);
+    return landing;
+}
+
+// Largest buffer hb_dvdnav_read hands out.  A VOBU rarely spans more
+// than a few hundred blocks, so most buffers hold one whole VOBU.
+#define DVD_READ_BLOCKS 512
+
+// Buffers holding blocks of libdvdnav's read-ahead cache keep that part
+// of the cache busy until they are closed.  Past this count blocks are
+// copied instead, so that libdvdnav always has cache left to read into.
+#define DVD_MAX_WRAPPED 8
+
+/***********************************************************************
+ * NavOpen, NavClose
+ ***********************************************************************
+ * hb_dvdnav_read hands out buffers that point into libdvdnav's cache.
+ * Their blocks are released when they are closed, possibly after the
+ * title was closed, so the dvdnav handle is closed by whoever drops the
+ * last reference to it.  libdvdnav locks its cache internally, so blocks
+ * may be released from any thread.
+ **********************************************************************/
+struct hb_dvdnav_ref_s
+{
+    hb_lock_t * lock;
+    dvdnav_t  * dvdnav;
+    int         refs;
+    int         wrapped;    // buffers holding cache blocks
+};
+
+typedef struct
+{
+    hb_dvdnav_ref_t * ref;
+    uint8_t         * blocks;
+    int               count;
+} dvd_cache_run_t;
+
+static int NavOpen( hb_dvdnav_t * d, const char * path )
+{
+    if ( dvdnav_open( &d->dvdnav, path ) != DVDNAV_STATUS_OK )
+    {
+        d->dvdnav = NULL;
+        return 0;
+    }
+    // Without a reference, blocks are copied out of the cache
+    d->nav_ref = calloc( 1, sizeof(hb_dvdnav_ref_t) );
+    if ( d->nav_ref != NULL )
+    {
+        d->nav_ref->lock   = hb_lock_init();
+        d->nav_ref->dvdnav = d->dvdnav;
+        d->nav_ref->refs   = 1;
+    }
+    return 1;
+}
+
+static void NavUnref( hb_dvdnav_ref_t * ref )
+{
+    int refs;
+
+    hb_lock( ref->lock );
+    refs = --ref->refs;
+    hb_unlock( ref->lock );
+
+    if ( refs == 0 )
+    {
+        dvdnav_close( ref->dvdnav );
+        hb_lock_close( &ref->lock );
+        free( ref );
+    }
+}
+
+static void NavClose( hb_dvdnav_t * d )
+{
+    ReadReset( d );
+    if ( d->nav_ref != NULL )
+    {
+        NavUnref( d->nav_ref );
+        d->nav_ref = NULL;
+    }
+    else if ( d->dvdnav != NULL )
+    {
+        dvdnav_close( d->dvdnav );
+    }
+    d->dvdnav = NULL;
+}
+
+static void release_cache_run( void * opaque, uint8_t * data )
+{
+    dvd_cache_run_t * run = opaque;
+    hb_dvdnav_ref_t * ref = run->ref;
+    int ii;
+
+    for ( ii = 0; ii < run->count; ii++ )
+    {
+        dvdnav_free_cache_block( ref->dvdnav,
+                                 run->blocks + ii * HB_DVD_READ_BUFFER_SIZE );
+    }
+    free( run );
+
+    hb_lock( ref->lock );
+    ref->wrapped--;
+    hb_unlock( ref->lock );
+    NavUnref( ref );
+}
+
+/***********************************************************************
+ * ReadReset
+ ***********************************************************************
+ * Drop read state carried between hb_dvdnav_read calls.  Needed
+ * whenever the read position changes.
+ **********************************************************************/
+static void ReadReset( hb_dvdnav_t * d )
+{
+    if ( d->read_next != NULL && d->read_next != d->read_scratch )
+    {
+        dvdnav_free_cache_block( d->dvdnav, d->read_next );
+    }
+    d->read_next = NULL;
+    d->read_chap = 0;
+    d->read_eof  = 0;
+}
+
+/***********************************************************************
+ * ReadBlock
+ ***********************************************************************
+ * Read the next block or event.  *block points into libdvdnav's cache
+ * when the block was found there, and has to be released.  Otherwise
+ * the block or event data was read into d->read_scratch.
+ **********************************************************************/
+static dvdnav_status_t ReadBlock( hb_dvdnav_t * d, uint8_t ** block,
+                                  int * event, int * len )
+{
+    *block = d->read_scratch;
+    return dvdnav_get_next_cache_block( d->dvdnav, block, event, len );
+}
+
+/***********************************************************************
+ * ReadAdd, ReadFinish
+ ***********************************************************************
+ * Blocks are collected either as a run of cache blocks that follow each
+ * other in memory, which is shared with libdvdnav, or copied into a
+ * pooled buffer.  ReadAdd returns 1 when 'block' does not continue the
+ * run and has to start the next buffer.
+ **********************************************************************/
+typedef struct
+{
+    hb_buffer_t * buf;      // copied blocks
+    uint8_t     * run;      // or the first of 'count' cache blocks
+    int           count;
+} dvd_read_t;
+
+static int ReadAdd( hb_dvdnav_t * d, dvd_read_t * r, uint8_t * block )
+{
+    int cached = block != d->read_scratch;
+
+    if ( r->run != NULL )
+    {
+        if ( cached && r->count < DVD_READ_BLOCKS &&
+             block == r->run + r->count * HB_DVD_READ_BUFFER_SIZE )
+        {
+            r->count++;
+            return 0;
+        }
+        return 1;
+    }
+    if ( r->buf == NULL )
+    {
+        hb_dvdnav_ref_t * ref = d->nav_ref;
+        int wrap = 0;
+
+        if ( cached && ref != NULL )
+        {
+            hb_lock( ref->lock );
+            wrap = ref->wrapped < DVD_MAX_WRAPPED;
+            if ( wrap )
+            {
+                ref->wrapped++;
+                ref->refs++;
+            }
+            hb_unlock( ref->lock );
+        }
+        if ( wrap )
+        {
+            r->run   = block;
+            r->count = 1;
+            return 0;
+        }
+        r->buf = hb_buffer_init( DVD_READ_BLOCKS * HB_DVD_READ_BUFFER_SIZE );
+        r->buf->size = 0;
+    }
+    memcpy( r->buf->data + r->buf->size, block, HB_DVD_READ_BUFFER_SIZE );
+    r->buf->size += HB_DVD_READ_BUFFER_SIZE;
+    if ( cached )
+    {
+        dvdnav_free_cache_block( d->dvdnav, block );
+    }
+    return 0;
+}
+
+static int ReadEmpty( dvd_read_t * r )
+{
+    return r->run == NULL && r->buf == NULL;
+}
+
+static int ReadFull( dvd_read_t * r )
+{
+    if ( r->run != NULL )
+    {
+        return r->count >= DVD_READ_BLOCKS;
+    }
+    return r->buf != NULL &&
+           r->buf->size + HB_DVD_READ_BUFFER_SIZE > r->buf->alloc;
+}
+
+static hb_buffer_t * ReadFinish( hb_dvdnav_t * d, dvd_read_t * r,
+                                 int new_chap )
+{
+    hb_buffer_t * b = r->buf;
+
+    if ( r->run != NULL )
+    {
+        dvd_cache_run_t * run = malloc( sizeof(dvd_cache_run_t) );
+        AVBufferRef     * ref = NULL;
+        int               size = r->count * HB_DVD_READ_BUFFER_SIZE;
+
+        if ( run != NULL )
+        {
+            run->ref    = d->nav_ref;
+            run->blocks = r->run;
+            run->count  = r->count;
+            ref = av_buffer_create( r->run, size, release_cache_run, run,
+                                    AV_BUFFER_FLAG_READONLY );
+        }
+        if ( ref != NULL )
+        {
+            // hb_buffer_wrap_avbuffer releases the reference on failure
+            b = hb_buffer_wrap_avbuffer( ref );
+        }
+        else
+        {
+            int ii;
+
+            b = hb_buffer_init( size );
+            memcpy( b->data, r->run, size );
+            for ( ii = 0; ii < r->count; ii++ )
+            {
+                dvdnav_free_cache_block( d->dvdnav,
+                                         r->run + ii * HB_DVD_READ_BUFFER_SIZE );
+            }
+            free( run );
+            hb_lock( d->nav_ref->lock );
+            d->nav_ref->wrapped--;
+            hb_unlock( d->nav_ref->lock );
+            NavUnref( d->nav_ref );
+        }
+    }
+    r->buf   = NULL;
+    r->run   = NULL;
+    r->count = 0;
+    if ( b != NULL )
+    {
+        b->s.new_chap = new_chap;
+    }
+    return b;
+}
+
+/***********************************************************************
+ * ReadDone
+ ***********************************************************************
+ * The end of the title was reached.  Blocks still collected are
+ * returned first and the next hb_dvdnav_read call returns NULL.
+ **********************************************************************/
+static hb_buffer_t * ReadDone( hb_dvdnav_t * d, dvd_read_t * r,
+                               int new_chap, int error_count )
+{
+    if (error_count > 0)
+    {
+        // Last read attempt failed
+        hb_set_work_error(d->h, HB_ERROR_READ);
+    }
+    if (!ReadEmpty(r))
+    {
+        d->read_eof = 1;
+        return ReadFinish(d, r, new_chap);
+    }
+    return NULL;
+}
+
 /***********************************************************************
  * hb_dvdnav_read
  ***********************************************************************
@@ -1625,18 +2257,33 @@ static hb_buffer_t * hb_dvdnav_read( hb_dvd_t * e )
 {
     hb_dvdnav_t * d = &(e->dvdnav);
     int result, event, len;
-    int chapter = 0;
     int error_count = 0;
-    hb_buffer_t *b = hb_buffer_init( HB_DVD_READ_BUFFER_SIZE );
+    int new_chap;
+    dvd_read_t r = { NULL, NULL, 0 };
+    uint8_t *block;
+
+    if (d->read_eof)
+    {
+        ReadReset(d);
+        return NULL;
+    }
+    new_chap = d->read_chap;
+    d->read_chap = 0;
+    if (d->read_next != NULL)
+    {
+        // Block that did not fit in the previous buffer.  A block in
+        // d->read_scratch stays valid until the next ReadBlock.
+        ReadAdd(d, &r, d->read_next);
+        d->read_next = NULL;
+    }
 
     while ( 1 )
     {
         if (d->stopped)
         {
-            hb_buffer_close( &b );
-            return NULL;
+            return ReadDone(d, &r, new_chap, 0);
         }
-        result = dvdnav_get_next_block( d->dvdnav, b->data, &event, &len );
+        result = ReadBlock( d, &block, &event, &len );
         if ( result == DVDNAV_STATUS_ERR )
         {
             hb_error("dvdnav: Read Error, %s", dvdnav_err_to_string(d->dvdnav));
@@ -1644,17 +2291,15 @@ static hb_buffer_t * hb_dvdnav_read( hb_dvd_t * e )
             {
                 hb_error( "dvd: dvdnav_sector_search failed - %s",
                         dvdnav_err_to_string(d->dvdnav) );
-                hb_buffer_close( &b );
                 hb_set_work_error(d->h, HB_ERROR_READ);
-                return NULL;
+                return ReadDone(d, &r, new_chap, 0);
             }
             error_count++;
             if (error_count > 500)
             {
                 hb_error("dvdnav: Error, too many consecutive read errors");
-                hb_buffer_close( &b );
                 hb_set_work_error(d->h, HB_ERROR_READ);
-                return NULL;
+                return ReadDone(d, &r, new_chap, 0);
             }
             continue;
         }
@@ -1662,9 +2307,19 @@ static hb_buffer_t * hb_dvdnav_read( hb_dvd_t * e )
         {
         case DVDNAV_BLOCK_OK:
             // We have received a regular block of the currently playing
-            // MPEG stream.
-            b->s.new_chap = chapter;
-            return b;
+            // MPEG stream.  Keep collecting blocks until the VOBU ends
+            // or the buffer is full.
+            error_count = 0;
+            if (ReadAdd(d, &r, block))
+            {
+                d->read_next = block;
+                return ReadFinish(d, &r, new_chap);
+            }
+            if (ReadFull(&r))
+            {
+                return ReadFinish(d, &r, new_chap);
+            }
+            break;
 
         case DVDNAV_NOP:
             /*
@@ -1739,14 +2394,8 @@ static hb_buffer_t * hb_dvdnav_read( hb_dvd_t * e )
                 if (tt != d->title)
                 {
                     // Transition to another title signals that we are done.
-                    hb_buffer_close( &b );
                     hb_deep_log(2, "dvdnav: vts change, found next title");
-                    if (error_count > 0)
-                    {
-                        // Last read attempt failed
-                        hb_set_work_error(d->h, HB_ERROR_READ);
-                    }
-                    return NULL;
+                    return ReadDone(d, &r, new_chap, error_count);
                 }
             }
             break;
@@ -1762,20 +2411,14 @@ static hb_buffer_t * hb_dvdnav_read( hb_dvd_t * e )
                 dvdnav_cell_change_event_t * cell_event;
                 int tt = 0, pgcn = 0, pgn = 0, c;
 
-                cell_event = (dvdnav_cell_change_event_t*)b->data;
+                cell_event = (dvdnav_cell_change_event_t*)block;
 
                 dvdnav_current_title_program(d->dvdnav, &tt, &pgcn, &pgn);
                 if (tt != d->title)
                 {
                     // Transition to another title signals that we are done.
-                    hb_buffer_close( &b );
                     hb_deep_log(2, "dvdnav: cell change, found next title");
-                    if (error_count > 0)
-                    {
-                        // Last read attempt failed
-                        hb_set_work_error(d->h, HB_ERROR_READ);
-                    }
-                    return NULL;
+                    return ReadDone(d, &r, new_chap, error_count);
                 }
                 c = FindChapterIndex(d->list_dvd_chapter, pgcn, pgn);
                 if (c != d->chapter)
@@ -1784,27 +2427,24 @@ static hb_buffer_t * hb_dvdnav_read( hb_dvd_t * e )
                     {
                         // Some titles end with a 'link' back to the beginning so
                         // a transition to an earlier chapter means we're done.
-                        hb_buffer_close( &b );
                         hb_deep_log(2, "dvdnav: cell change, previous chapter");
-                        if (error_count > 0)
-                        {
-                            // Last read attempt failed
-                            hb_set_work_error(d->h, HB_ERROR_READ);
-                        }
-                        return NULL;
+                        return ReadDone(d, &r, new_chap, error_count);
                     }
-                    chapter = d->chapter = c;
+                    d->chapter = c;
+                    if (!ReadEmpty(&r))
+                    {
+                        // Data read so far belongs to the previous
+                        // chapter. Mark the next buffer instead.
+                        d->cell = cell_event->cellN;
+                        d->read_chap = c;
+                        return ReadFinish(d, &r, new_chap);
+                    }
+                    new_chap = c;
                 }
                 else if ( cell_event->cellN <= d->cell )
                 {
-                    hb_buffer_close( &b );
                     hb_deep_log(2, "dvdnav: cell change, previous cell");
-                    if (error_count > 0)
-                    {
-                        // Last read attempt failed
-                        hb_set_work_error(d->h, HB_ERROR_READ);
-                    }
-                    return NULL;
+                    return ReadDone(d, &r, new_chap, error_count);
                 }
                 d->cell = cell_event->cellN;
             }
@@ -1822,9 +2462,17 @@ static hb_buffer_t * hb_dvdnav_read( hb_dvd_t * e )
 
             // mpegdemux expects to get these.  I don't think it does
             // anything useful with them however.
-            b->s.new_chap = chapter;
-            return b;
-
+            //
+            // A NAV packet starts a new VOBU.  If blocks of the previous
+            // VOBU have been collected, ship those and start the next
+            // buffer with this packet.
+            error_count = 0;
+            if (!ReadEmpty(&r))
+            {
+                d->read_next = block;
+                return ReadFinish(d, &r, new_chap);
+            }
+            ReadAdd(d, &r, block);
             break;
 
         case DVDNAV_HOP_CHANNEL:
@@ -1840,21 +2488,14 @@ static hb_buffer_t * hb_dvdnav_read( hb_dvd_t * e )
             * Playback should end here.
             */
             d->stopped = 1;
-            hb_buffer_close( &b );
             hb_deep_log(2, "dvdnav: stop");
-            if (error_count > 0)
-            {
-                // Last read attempt failed
-                hb_set_work_error(d->h, HB_ERROR_READ);
-            }
-            return NULL;
+            return ReadDone(d, &r, new_chap, error_count);
 
         default:
             break;
         }
     }
-    hb_buffer_close( &b );
-    return NULL;
+    return ReadDone(d, &r, new_chap, 0);
 }
 
 /***********************************************************************
@@ -1886,7 +2527,7 @@ static void hb_dvdnav_close( hb_dvd_t ** _d )
 {
     hb_dvdnav_t      * d = &((*_d)->dvdnav);
 
-    if (d->dvdnav) dvdnav_close( d->dvdnav );
+    NavClose(d);
     if (d->vmg)    ifoClose( d->vmg );
     TitleCloseIfo(d);
     if (d->reader) DVDClose( d->reader );
@@ -981,7 +981,7 @@ int encavcodecInit( hb_work_object_t * w, hb_job_t * job )
     else if (job->vcodec == HB_VCODEC_FFMPEG_FFV1)
     {
         int slices[] = {4, 6, 9, 12, 16, 24, 30};
-        context->slices = hb_get_cpu_count();
+        context->slices = hb_get_thread_count();
 
         int slice_index = 0;
         for (int i = 0; i < sizeof(slices) / sizeof(int); i++)
@@ -1590,6 +1590,65 @@ static int apply_options(hb_job_t *job, AVCodecContext *context, AVDictionary **
     return 0;
 }
 
+/*
+ * libvpx only scales across cores through tile columns (each at least 256
+ * pixels wide) and row-mt. Pick the widest tile layout the output allows,
+ * bounded by the encoder's share of the cpus, and give each tile column
+ * two threads so that row-mt has rows to overlap. Anything the user set
+ * in encopts wins.
+ */
+static void apply_vp9_threads(hb_job_t *job, AVDictionary **av_opts,
+                              hb_dict_t *lavc_opts)
+{
+    int budget = hb_job_thread_count(job, HB_THREADS_ENCODER);
+    int log2_cols, log2_rows, tiles, threads;
+    char str[8];
+
+    if (hb_dict_get(lavc_opts, "tile-columns") != NULL)
+    {
+        log2_cols = hb_value_get_int(hb_dict_get(lavc_opts, "tile-columns"));
+    }
+    else
+    {
+        log2_cols = 0;
+        while (log2_cols < 6 && (256 << (log2_cols + 1)) <= job->width &&
+               (1 << (log2_cols + 1)) <= budget)
+        {
+            log2_cols++;
+        }
+        snprintf(str, sizeof(str), "%d", log2_cols);
+        av_dict_set(av_opts, "tile-columns", str, 0);
+    }
+
+    if (hb_dict_get(lavc_opts, "tile-rows") != NULL)
+    {
+        log2_rows = hb_value_get_int(hb_dict_get(lavc_opts, "tile-rows"));
+    }
+    else
+    {
+        // Only worth it when there are cores left over at 2160p and above
+        log2_rows = job->height >= 2160 && (2 << log2_cols) < budget;
+        snprintf(str, sizeof(str), "%d", log2_rows);
+        av_dict_set(av_opts, "tile-rows", str, 0);
+    }
+
+    tiles = 1 << (FFMAX(0, log2_cols) + FFMAX(0, log2_rows));
+    if (hb_dict_get(lavc_opts, "threads") == NULL)
+    {
+        // libvpx caps the encoder at 64 threads
+        threads = FFMAX(1, FFMIN(FFMIN(budget, 64), tiles * 2));
+        snprintf(str, sizeof(str), "%d", threads);
+        av_dict_set(av_opts, "threads", str, 0);
+    }
+    else
+    {
+        threads = hb_value_get_int(hb_dict_get(lavc_opts, "threads"));
+    }
+
+    hb_log("encavcodec: VP9 tile-columns %d, tile-rows %d, threads %d",
+           log2_cols, log2_rows, threads);
+}
+
 static int apply_encoder_options(hb_job_t *job, AVCodecContext *context, AVDictionary **av_opts)
 {
 #if HB_PROJECT_FEATURE_QSV
@@ -1612,6 +1671,11 @@ static int apply_encoder_options(hb_job_t *job, AVCodecContext *context, AVDicti
 
     switch (job->vcodec)
     {
+        case HB_VCODEC_FFMPEG_VP9:
+        case HB_VCODEC_FFMPEG_VP9_10BIT:
+            apply_vp9_threads(job, av_opts, lavc_opts);
+            apply_options(job, context, av_opts, lavc_opts);
+            break;
         default:
             apply_options(job, context, av_opts, lavc_opts);
             break;
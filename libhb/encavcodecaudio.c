@@ -11,6 +11,12 @@
 #include "handbrake/hbffmpeg.h"
 #include "handbrake/extradata.h"
 
+typedef struct
+{
+    int64_t position;   // first sample of the buffer
+    int64_t pts;
+} ring_ts_t;
+
 struct hb_work_private_s
 {
     hb_job_t       * job;
@@ -19,20 +25,36 @@ struct hb_work_private_s
 
     int              out_discrete_channels;
     int              samples_per_frame;
-    unsigned long    max_output_bytes;
-    unsigned long    input_samples;
-    float          * output_buf;
-    float          * input_buf;
-    hb_list_t      * list;
 
     SwrContext     * swresample;
 
+    // Pending samples, stored in the codec's sample format and layout so
+    // that frames can be handed to the codec without further conversion.
+    // Samples [ring_read, ring_write) are valid in every plane.
+    uint8_t       ** ring;
+    uint8_t       ** frame_data;
+    int              ring_planes;
+    int              ring_sample_size;
+    int              ring_size;
+    int              ring_read;
+    int              ring_write;
+
+    // Start of each input buffer that still has samples in the ring.
+    // Positions count samples since the start of the stream, so frames
+    // get the pts of the buffer holding their first sample.
+    ring_ts_t      * ring_ts;
+    int              ring_ts_count;
+    int              ring_ts_alloc;
+    int64_t          samples_in;
+    int64_t          samples_out;
+
     int64_t          last_pts;
 };
 
 static int  encavcodecaInit( hb_work_object_t *, hb_job_t * );
 static int  encavcodecaWork( hb_work_object_t *, hb_buffer_t **, hb_buffer_t ** );
 static void encavcodecaClose( hb_work_object_t * );
+static int  ring_grow( hb_work_private_t *, int );
 
 hb_work_object_t hb_encavcodeca =
 {
@@ -52,7 +74,6 @@ static int encavcodecaInit(hb_work_object_t *w, hb_job_t *job)
     hb_work_private_t *pv = calloc(1, sizeof(hb_work_private_t));
     w->private_data       = pv;
     pv->job               = job;
-    pv->list              = hb_list_init();
     pv->last_pts          = AV_NOPTS_VALUE;
     pv->pkt               = av_packet_alloc();
 
@@ -268,13 +289,17 @@ static int encavcodecaInit(hb_work_object_t *w, hb_job_t *job)
     pv->context           = context;
     audio->config.out.samples_per_frame =
     pv->samples_per_frame = context->frame_size;
-    pv->input_samples     = context->frame_size * context->ch_layout.nb_channels;
-    pv->input_buf         = malloc(pv->input_samples * sizeof(float));
-    // Some encoders in libav (e.g. fdk-aac) fail if the output buffer
-    // size is not some minimum value.  8K seems to be enough :(
-    pv->max_output_bytes  = MAX(16384,
-                                (pv->input_samples *
-                                 av_get_bytes_per_sample(context->sample_fmt)));
+
+    pv->ring_planes       = av_sample_fmt_is_planar(context->sample_fmt) ?
+                            context->ch_layout.nb_channels : 1;
+    pv->ring_sample_size  = av_get_bytes_per_sample(context->sample_fmt) *
+                            context->ch_layout.nb_channels / pv->ring_planes;
+    pv->frame_data        = calloc(pv->ring_planes, sizeof(uint8_t *));
+    if (pv->frame_data == NULL || ring_grow(pv, 4 * MAX(pv->samples_per_frame, 1024)))
+    {
+        hb_error("encavcodecaInit: failed to allocate sample buffer");
+        return 1;
+    }
 
     int needs_resample = context->sample_fmt != AV_SAMPLE_FMT_FLT;
     int needs_remap    = av_channel_layout_compare(&in_ch_layout, &out_ch_layout) &&
@@ -283,7 +308,6 @@ static int encavcodecaInit(hb_work_object_t *w, hb_job_t *job)
     // sample_fmt or remap conversion
     if (needs_resample || needs_remap)
     {
-        pv->output_buf = malloc(pv->max_output_bytes);
         pv->swresample = swr_alloc();
         if (pv->swresample == NULL)
         {
@@ -319,7 +343,6 @@ static int encavcodecaInit(hb_work_object_t *w, hb_job_t *job)
     else
     {
         pv->swresample = NULL;
-        pv->output_buf = pv->input_buf;
     }
 
     av_channel_layout_uninit(&in_ch_layout);
@@ -370,29 +393,183 @@ static void encavcodecaClose(hb_work_object_t * w)
 
         av_packet_free(&pv->pkt);
 
-        if (pv->output_buf != NULL)
+        if (pv->ring != NULL)
         {
-            free(pv->output_buf);
+            av_freep(&pv->ring[0]);
+            av_freep(&pv->ring);
         }
-        if (pv->input_buf != NULL && pv->input_buf != pv->output_buf)
+        free(pv->frame_data);
+        free(pv->ring_ts);
+
+        if (pv->swresample != NULL)
         {
-            free(pv->input_buf);
+            swr_free(&pv->swresample);
         }
-        pv->output_buf = pv->input_buf = NULL;
 
-        if (pv->list != NULL)
+        free(pv);
+        w->private_data = NULL;
+    }
+}
+
+static void ring_pointers(hb_work_private_t *pv, int pos, uint8_t **data)
+{
+    int ii;
+
+    for (ii = 0; ii < pv->ring_planes; ii++)
+    {
+        data[ii] = pv->ring[ii] + pos * pv->ring_sample_size;
+    }
+}
+
+// Make room for at least nb_samples samples after ring_write.
+// Pending samples are moved back to the start of the buffer first, and
+// the buffer is only reallocated when that is not enough.
+static int ring_grow(hb_work_private_t *pv, int nb_samples)
+{
+    int pending = pv->ring_write - pv->ring_read;
+    int ii;
+
+    if (pv->ring != NULL && pv->ring_write + nb_samples <= pv->ring_size)
+    {
+        return 0;
+    }
+    if (pv->ring != NULL && pending + nb_samples <= pv->ring_size)
+    {
+        if (pending > 0)
         {
-            hb_list_empty(&pv->list);
+            for (ii = 0; ii < pv->ring_planes; ii++)
+            {
+                memmove(pv->ring[ii],
+                        pv->ring[ii] + pv->ring_read * pv->ring_sample_size,
+                        pending * pv->ring_sample_size);
+            }
         }
+        pv->ring_read  = 0;
+        pv->ring_write = pending;
+        return 0;
+    }
 
-        if (pv->swresample != NULL)
+    uint8_t **ring = NULL;
+    int       size = MAX(2 * pv->ring_size, pending + nb_samples);
+
+    if (av_samples_alloc_array_and_samples(&ring, NULL,
+                                           pv->context->ch_layout.nb_channels,
+                                           size, pv->context->sample_fmt,
+                                           0) < 0)
+    {
+        return -1;
+    }
+    if (pv->ring != NULL)
+    {
+        for (ii = 0; ii < pv->ring_planes && pending > 0; ii++)
         {
-            swr_free(&pv->swresample);
+            memcpy(ring[ii],
+                   pv->ring[ii] + pv->ring_read * pv->ring_sample_size,
+                   pending * pv->ring_sample_size);
         }
+        av_freep(&pv->ring[0]);
+        av_freep(&pv->ring);
+    }
+    pv->ring       = ring;
+    pv->ring_size  = size;
+    pv->ring_read  = 0;
+    pv->ring_write = pending;
 
-        free(pv);
-        w->private_data = NULL;
+    return 0;
+}
+
+// Append the interleaved float samples of 'in' to the sample buffer,
+// converting them to the codec's sample format and layout on the way in.
+static int ring_add(hb_work_object_t *w, hb_buffer_t *in)
+{
+    hb_work_private_t * pv = w->private_data;
+    int nb_samples = in->size / (sizeof(float) * pv->out_discrete_channels);
+
+    if (nb_samples <= 0)
+    {
+        return 0;
+    }
+    if (ring_grow(pv, nb_samples))
+    {
+        hb_error("encavcodecaudio: failed to grow sample buffer");
+        return -1;
+    }
+    if (pv->ring_ts_count == pv->ring_ts_alloc)
+    {
+        int        alloc = MAX(2 * pv->ring_ts_alloc, 16);
+        ring_ts_t *ts    = realloc(pv->ring_ts, alloc * sizeof(ring_ts_t));
+        if (ts == NULL)
+        {
+            hb_error("encavcodecaudio: failed to grow timestamp list");
+            return -1;
+        }
+        pv->ring_ts       = ts;
+        pv->ring_ts_alloc = alloc;
+    }
+
+    ring_pointers(pv, pv->ring_write, pv->frame_data);
+    if (pv->swresample != NULL)
+    {
+        const uint8_t *in_data = in->data;
+        int            out_samples;
+
+        out_samples = swr_convert(pv->swresample,
+                                  pv->frame_data, nb_samples,
+                                  &in_data,       nb_samples);
+        if (out_samples < 0)
+        {
+            hb_error("encavcodecaudio: swr_convert() failed: %s, "
+                     "dropping %d samples at %"PRId64,
+                     av_err2str(out_samples), nb_samples, in->s.start);
+            return -1;
+        }
+        if (out_samples != nb_samples)
+        {
+            // we're not doing sample rate conversion,
+            // so this shouldn't happen
+            hb_error("encavcodecaudio: swr_convert() returned %d of %d "
+                     "samples at %"PRId64, out_samples, nb_samples,
+                     in->s.start);
+            nb_samples = out_samples;
+        }
     }
+    else
+    {
+        memcpy(pv->frame_data[0], in->data,
+               nb_samples * pv->ring_sample_size);
+    }
+
+    pv->ring_ts[pv->ring_ts_count].position = pv->samples_in;
+    pv->ring_ts[pv->ring_ts_count].pts      = in->s.start;
+    pv->ring_ts_count++;
+    pv->ring_write += nb_samples;
+    pv->samples_in += nb_samples;
+
+    return 0;
+}
+
+// pts of the next frame, from the input buffer holding its first sample
+static int64_t ring_frame_pts(hb_work_private_t *pv, int samplerate)
+{
+    int ii;
+
+    // Drop buffers that were read completely
+    for (ii = 0; ii + 1 < pv->ring_ts_count; ii++)
+    {
+        if (pv->ring_ts[ii + 1].position > pv->samples_out)
+        {
+            break;
+        }
+    }
+    if (ii > 0)
+    {
+        pv->ring_ts_count -= ii;
+        memmove(pv->ring_ts, pv->ring_ts + ii,
+                pv->ring_ts_count * sizeof(ring_ts_t));
+    }
+
+    return pv->ring_ts[0].pts + 90000LL *
+           (pv->samples_out - pv->ring_ts[0].position) / samplerate;
 }
 
 static void get_packets( hb_work_object_t * w, hb_buffer_list_t * list )
@@ -448,52 +625,33 @@ static void Encode(hb_work_object_t *w, hb_buffer_list_t *list)
 {
     hb_work_private_t * pv = w->private_data;
     hb_audio_t        * audio = w->audio;
-    uint64_t            pts, pos;
 
-    while (hb_list_bytes(pv->list) >= pv->input_samples * sizeof(float))
+    while (pv->ring_write - pv->ring_read >= pv->samples_per_frame)
     {
-        int ret;
+        int ret, ii;
 
-        hb_list_getbytes(pv->list, (uint8_t *)pv->input_buf,
-                         pv->input_samples * sizeof(float), &pts, &pos);
-
-        // Prepare input frame
-        int     out_size;
+        // Prepare input frame, pointing directly into the sample buffer.
+        // libavcodec copies non-refcounted frames it needs to keep.
         AVFrame frame = { .nb_samples = pv->samples_per_frame,
                           .format = pv->context->sample_fmt,
                           .ch_layout = pv->context->ch_layout
         };
 
-        out_size = av_samples_get_buffer_size(NULL,
-                                              pv->context->ch_layout.nb_channels,
-                                              pv->samples_per_frame,
-                                              pv->context->sample_fmt, 1);
-        avcodec_fill_audio_frame(&frame,
-                                 pv->context->ch_layout.nb_channels, pv->context->sample_fmt,
-                                 (uint8_t *)pv->output_buf, out_size, 1);
-        if (pv->swresample != NULL)
+        ring_pointers(pv, pv->ring_read, pv->frame_data);
+        for (ii = 0; ii < pv->ring_planes && ii < AV_NUM_DATA_POINTERS; ii++)
         {
-            int out_samples;
-
-            out_samples = swr_convert(pv->swresample,
-                                      frame.extended_data, frame.nb_samples,
-                    (const uint8_t **)&pv->input_buf,      frame.nb_samples);
-            if (out_samples != pv->samples_per_frame)
-            {
-                // we're not doing sample rate conversion,
-                // so this shouldn't happen
-                hb_log("encavcodecaWork: swr_convert() failed");
-                continue;
-            }
+            frame.data[ii] = pv->frame_data[ii];
         }
+        frame.extended_data = pv->frame_data;
+        frame.linesize[0]   = pv->samples_per_frame * pv->ring_sample_size;
 
-        frame.pts = pts + (90000LL * pos / (sizeof(float) *
-                                          pv->out_discrete_channels *
-                                          audio->config.out.samplerate));
-
+        frame.pts = ring_frame_pts(pv, audio->config.out.samplerate);
         frame.pts = av_rescale_q(frame.pts, (AVRational){1, 90000},
                                  pv->context->time_base);
 
+        pv->ring_read   += pv->samples_per_frame;
+        pv->samples_out += pv->samples_per_frame;
+
         // Encode
         ret = avcodec_send_frame(pv->context, &frame);
         if (ret < 0)
@@ -541,10 +699,10 @@ static int encavcodecaWork( hb_work_object_t * w, hb_buffer_t ** buf_in,
         return HB_WORK_DONE;
     }
 
-    hb_list_add( pv->list, in );
-    *buf_in = NULL;
-
-    Encode(w, &list);
+    if (ring_add(w, in) == 0)
+    {
+        Encode(w, &list);
+    }
     *buf_out = hb_buffer_list_clear(&list);
 
     return HB_WORK_OK;
@@ -27,6 +27,13 @@ void encsvtClose(hb_work_object_t *);
 #define FRAME_INFO_SIZE 2048
 #define FRAME_INFO_MASK (FRAME_INFO_SIZE - 1)
 
+// Output packets reference SVT-AV1's packet buffers until the muxer is
+// done with them. Holding too many would stall the encoder on its own
+// output pool, whose size SVT-AV1 does not report, so past this count
+// packets are copied instead. The muxer copies the packets it has to
+// queue, which keeps the borrowed ones to those in flight.
+#define MAX_WRAPPED_PACKETS 8
+
 hb_work_object_t hb_encsvtav1 =
 {
     WORK_ENCSVTAV1,
@@ -36,6 +43,16 @@ hb_work_object_t hb_encsvtav1 =
     encsvtClose
 };
 
+// The encoder handle must outlive any packet still referencing its
+// buffers, so it is released by whoever drops the last reference.
+typedef struct
+{
+    hb_lock_t       *lock;
+    EbComponentType *svt_handle;
+    int              refs;
+    int              wrapped;
+} svt_output_t;
+
 struct hb_work_private_s
 {
     hb_job_t           *job;
@@ -44,6 +61,7 @@ struct hb_work_private_s
     EbSvtAv1EncConfiguration    enc_params;
     EbComponentType            *svt_handle;
     EbBufferHeaderType         *in_buf;
+    svt_output_t               *output;
 
     struct {
         int64_t duration;
@@ -67,6 +85,111 @@ static int64_t get_frame_duration(hb_work_private_t *pv)
     return pv->frame_info[i].duration;
 }
 
+/*
+ * SVT-AV1 sizes its thread pools for every logical cpu unless told
+ * otherwise, which oversubscribes the host on top of the decoder and
+ * the filter threads. Map the encoder's share of the cpus onto a level
+ * of parallelism, each level roughly doubling the cores SVT-AV1 targets.
+ * The levels count physical cores, SMT siblings add little to SVT-AV1's
+ * vector heavy kernels, so the share is scaled to the physical cores.
+ * "lp" and "pin" in the encoder options still take precedence.
+ */
+static void apply_thread_budget(hb_job_t *job, EbSvtAv1EncConfiguration *param)
+{
+    int cpu_count = hb_get_cpu_count();
+    int budget    = hb_job_thread_count(job, HB_THREADS_ENCODER);
+    int cores     = budget;
+    int level;
+    hb_cpu_topology_t topology;
+
+    hb_get_cpu_topology(&topology);
+    if (topology.physical > 0 && topology.physical < topology.online)
+    {
+        cores = MAX(1, budget * topology.physical / topology.online);
+    }
+
+    for (level = 1; level < 6 && (1 << (level - 1)) < cores; level++);
+
+    param->level_of_parallelism = level;
+    // Pinning would put concurrent jobs on the same cores
+    param->pin_threads = 0;
+
+    hb_log("encsvtav1: thread budget %d of %d cpus (%d cores), level of parallelism %d",
+           budget, cpu_count, cores, level);
+}
+
+static void output_unref(svt_output_t *output)
+{
+    int refs;
+
+    hb_lock(output->lock);
+    refs = --output->refs;
+    hb_unlock(output->lock);
+
+    if (refs == 0)
+    {
+        svt_av1_enc_deinit(output->svt_handle);
+        svt_av1_enc_deinit_handle(output->svt_handle);
+        hb_lock_close(&output->lock);
+        free(output);
+    }
+}
+
+static void release_packet(void *opaque, uint8_t *data)
+{
+    EbBufferHeaderType *headerPtr = opaque;
+    svt_output_t       *output    = headerPtr->p_app_private;
+
+    svt_av1_enc_release_out_buffer(&headerPtr);
+
+    hb_lock(output->lock);
+    output->wrapped--;
+    hb_unlock(output->lock);
+    output_unref(output);
+}
+
+static hb_buffer_t * wrap_packet(svt_output_t *output,
+                                 EbBufferHeaderType *headerPtr)
+{
+    hb_buffer_t *buf;
+    AVBufferRef *ref;
+    int          wrap;
+
+    hb_lock(output->lock);
+    wrap = output->wrapped < MAX_WRAPPED_PACKETS;
+    if (wrap)
+    {
+        output->wrapped++;
+        output->refs++;
+    }
+    hb_unlock(output->lock);
+
+    if (wrap)
+    {
+        headerPtr->p_app_private = output;
+        ref = av_buffer_create(headerPtr->p_buffer, headerPtr->n_filled_len,
+                               release_packet, headerPtr,
+                               AV_BUFFER_FLAG_READONLY);
+        if (ref != NULL)
+        {
+            // hb_buffer_wrap_avbuffer releases the reference on failure
+            return hb_buffer_wrap_avbuffer(ref);
+        }
+        hb_lock(output->lock);
+        output->wrapped--;
+        output->refs--;
+        hb_unlock(output->lock);
+    }
+
+    buf = hb_buffer_init(headerPtr->n_filled_len);
+    if (buf != NULL)
+    {
+        memcpy(buf->data, headerPtr->p_buffer, headerPtr->n_filled_len);
+    }
+    svt_av1_enc_release_out_buffer(&headerPtr);
+    return buf;
+}
+
 static int alloc_buffer(EbSvtAv1EncConfiguration *config, hb_work_private_t *pv)
 {
     EbSvtIOFormat *in_data;
@@ -254,6 +377,8 @@ int encsvtInit(hb_work_object_t *w, hb_job_t *job)
         }
     }
 
+    apply_thread_budget(job, param);
+
     hb_dict_t *encoder_options = NULL;
     if (job->encoder_options != NULL && *job->encoder_options)
     {
@@ -313,6 +438,16 @@ int encsvtInit(hb_work_object_t *w, hb_job_t *job)
         return 1;
     }
 
+    pv->output = calloc(1, sizeof(svt_output_t));
+    if (pv->output == NULL)
+    {
+        hb_error("encsvtav1: error allocating output state");
+        return 1;
+    }
+    pv->output->lock       = hb_lock_init();
+    pv->output->svt_handle = pv->svt_handle;
+    pv->output->refs       = 1;
+
     EbBufferHeaderType *headerPtr = NULL;
 
     svt_ret = svt_av1_enc_stream_header(pv->svt_handle, &headerPtr);
@@ -379,7 +514,12 @@ void encsvtClose(hb_work_object_t *w)
 
     hb_chapter_queue_close(&pv->chapter_queue);
 
-    if (pv->svt_handle)
+    if (pv->output)
+    {
+        // Packets still held downstream keep the handle alive
+        output_unref(pv->output);
+    }
+    else if (pv->svt_handle)
     {
         svt_av1_enc_deinit(pv->svt_handle);
         svt_av1_enc_deinit_handle(pv->svt_handle);
@@ -549,28 +689,29 @@ static int receive(hb_work_object_t *w, hb_buffer_t **out, int done)
         return 2;
     }
 
-    buf = hb_buffer_init(headerPtr->n_filled_len);
+    // The header may be released by wrap_packet, keep what is needed
+    int64_t pts      = headerPtr->pts;
+    int64_t dts      = headerPtr->dts;
+    int     pic_type = headerPtr->pic_type;
+
+    buf = wrap_packet(pv->output, headerPtr);
     if (buf == NULL)
     {
         hb_error("encsvtav1: failed to allocate output packet");
-        svt_av1_enc_release_out_buffer(&headerPtr);
         *out = NULL;
         return 2;
     }
 
-    memcpy(buf->data, headerPtr->p_buffer, headerPtr->n_filled_len);
-
-    buf->size            = headerPtr->n_filled_len;
-    buf->s.start         = headerPtr->pts;
+    buf->s.start         = pts;
     buf->s.duration      = get_frame_duration(pv);
     buf->s.stop          = buf->s.start + buf->s.duration;
-    buf->s.renderOffset  = headerPtr->dts;
+    buf->s.renderOffset  = dts;
 
     // SVT-AV1 doesn't always respect forced keyframes,
     // so always check for chapters
     hb_chapter_dequeue(pv->chapter_queue, buf);
 
-    switch (headerPtr->pic_type)
+    switch (pic_type)
     {
         case EB_AV1_KEY_PICTURE:
             buf->s.flags |= HB_FLAG_FRAMETYPE_KEY;
@@ -583,13 +724,11 @@ static int receive(hb_work_object_t *w, hb_buffer_t **out, int done)
             break;
     }
 
-    if (headerPtr->pic_type != EB_AV1_NON_REF_PICTURE)
+    if (pic_type != EB_AV1_NON_REF_PICTURE)
     {
         buf->s.flags |= HB_FLAG_FRAMETYPE_REF;
     }
 
-    svt_av1_enc_release_out_buffer(&headerPtr);
-
     *out = buf;
     return 0;
 }
@@ -445,6 +445,23 @@ hb_buffer_t * hb_buffer_wrapper_init()
     return hb_buffer_init_internal(0);
 }
 
+// Wrap a reference counted buffer without copying. The buffer takes
+// ownership of the reference and releases it when it is closed.
+hb_buffer_t * hb_buffer_wrap_avbuffer(AVBufferRef *ref)
+{
+    hb_buffer_t *buf = hb_buffer_init_internal(0);
+    if (buf == NULL)
+    {
+        av_buffer_unref(&ref);
+        return NULL;
+    }
+    buf->storage      = ref;
+    buf->storage_type = AVBUFFER;
+    buf->data         = ref->data;
+    buf->size         = ref->size;
+    return buf;
+}
+
 hb_buffer_t * hb_buffer_init( int size )
 {
     return hb_buffer_init_internal(size);
@@ -457,8 +474,44 @@ hb_buffer_t * hb_buffer_eof_init(void)
     return buf;
 }
 
+// Move data held in reference counted storage into a buffer of our own
+static void buffer_realloc_avbuffer( hb_buffer_t * b, int size )
+{
+    hb_buffer_t * tmp = hb_buffer_init(MAX(size, b->size));
+
+    if (tmp == NULL)
+    {
+        return;
+    }
+    if (b->size > 0)
+    {
+        memcpy(tmp->data, b->data, b->size);
+    }
+    av_buffer_unref((AVBufferRef **)&b->storage);
+    b->storage_type = STANDARD;
+    b->data         = tmp->data;
+    b->alloc        = tmp->alloc;
+
+    // Hand tmp the empty state b had as a wrapper so that closing it
+    // only recycles the hb_buffer_t
+    tmp->data  = NULL;
+    tmp->size  = 0;
+    tmp->alloc = 0;
+    hb_buffer_close(&tmp);
+}
+
 void hb_buffer_realloc( hb_buffer_t * b, int size )
 {
+    if (b->storage_type == AVBUFFER)
+    {
+        buffer_realloc_avbuffer(b, size);
+        return;
+    }
+    if (b->storage_type != STANDARD)
+    {
+        hb_error("hb_buffer_realloc: can't reallocate frame storage");
+        return;
+    }
     if ( size > b->alloc || b->data == NULL )
     {
         uint8_t   * tmp;
@@ -629,6 +682,8 @@ int hb_buffer_is_writable(const hb_buffer_t *buf)
             return av_frame_is_writable((AVFrame *)buf->storage);
         case STANDARD:
             return 1;
+        case AVBUFFER:
+            return av_buffer_is_writable((AVBufferRef *)buf->storage);
 #ifdef __APPLE__
         case COREMEDIA:
             return hb_cv_get_io_surface_usage_count(buf) == 1;
@@ -731,7 +786,7 @@ hb_buffer_t * hb_buffer_dup(const hb_buffer_t *src)
         return NULL;
     }
 
-    if (src->storage_type == STANDARD)
+    if (src->storage_type == STANDARD || src->storage_type == AVBUFFER)
     {
         buf = hb_buffer_init(src->size);
         if (buf)
@@ -1020,6 +1075,11 @@ static void free_buffer_resources(hb_buffer_t *b)
         av_frame_unref((AVFrame *)b->storage);
         av_frame_free((AVFrame **)&b->storage);
     }
+    else if (b->storage_type == AVBUFFER)
+    {
+        av_buffer_unref((AVBufferRef **)&b->storage);
+        b->data = NULL;
+    }
 #ifdef __APPLE__
     else if (b->storage_type == COREMEDIA && b->storage != NULL)
     {
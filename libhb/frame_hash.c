@@ -0,0 +1,406 @@
+/* frame_hash.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/* Frame hash logs.
+ *
+ * When job->frame_hash_file is set, every frame a video filter outputs
+ * is hashed and logged, one line per frame:
+ *
+ *   <filter position> <frame> <pts> <combed> <adler32> <plane means> <name>
+ *
+ * The filter position is the index of the filter in job->list_filter,
+ * the frame is the count of frames that filter output before this one.
+ * Combed is the comb detection result carried by the frame, which is
+ * all that comb detect changes.
+ * The hash covers the visible samples of each plane, not the padding,
+ * like ffmpeg's framecrc.  The mean sample value of each plane is kept
+ * too, so that frames which are not bit exact can still be checked to
+ * be close.
+ *
+ * Logs of two encodes of the same job, typically one of them with
+ * hb_set_reference_kernels(1), are compared with hb_frame_hash_compare().
+ */
+
+#include "handbrake/handbrake.h"
+#include "handbrake/hbffmpeg.h"
+#include "libavutil/adler32.h"
+
+#define FRAME_HASH_HEADER     "HandBrake frame hashes 1"
+#define FRAME_HASH_MAX_PLANES 4
+
+struct hb_frame_hash_s
+{
+    FILE                * file;
+    hb_lock_t           * lock;
+    int                   count;
+    hb_filter_object_t ** filters;
+    int                 * frames;
+};
+
+typedef struct
+{
+    int      position;
+    int      frame;
+    int64_t  pts;
+    int      combed;
+    uint32_t hash;
+    double   mean[FRAME_HASH_MAX_PLANES];
+    char     name[64];
+} frame_hash_record_t;
+
+int hb_frame_hash_init(hb_job_t *job)
+{
+    hb_frame_hash_t *fh;
+
+    fh = calloc(1, sizeof(hb_frame_hash_t));
+    if (fh == NULL)
+    {
+        return -1;
+    }
+    fh->count   = hb_list_count(job->list_filter);
+    fh->filters = calloc(fh->count + 1, sizeof(hb_filter_object_t *));
+    fh->frames  = calloc(fh->count + 1, sizeof(int));
+    fh->lock    = hb_lock_init();
+    if (fh->filters == NULL || fh->frames == NULL || fh->lock == NULL)
+    {
+        goto fail;
+    }
+    for (int ii = 0; ii < fh->count; ii++)
+    {
+        fh->filters[ii] = hb_list_item(job->list_filter, ii);
+    }
+
+    fh->file = hb_fopen(job->frame_hash_file, "w");
+    if (fh->file == NULL)
+    {
+        hb_error("frame hash: failed to open %s", job->frame_hash_file);
+        goto fail;
+    }
+    fprintf(fh->file, "%s\n", FRAME_HASH_HEADER);
+    fprintf(fh->file, "# %s, %s kernels\n", HB_PROJECT_TITLE,
+            hb_get_reference_kernels() ? "reference" : "optimized");
+    hb_log("frame hash: logging filter output to %s", job->frame_hash_file);
+
+    job->frame_hash = fh;
+    for (int ii = 0; ii < fh->count; ii++)
+    {
+        fh->filters[ii]->frame_hash = fh;
+    }
+    return 0;
+
+fail:
+    hb_lock_close(&fh->lock);
+    free(fh->filters);
+    free(fh->frames);
+    free(fh);
+    return -1;
+}
+
+static void hash_frame(const hb_buffer_t *buf, uint32_t *hash, double *mean)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(buf->f.fmt);
+    int planes = av_pix_fmt_count_planes(buf->f.fmt);
+    int wide   = desc->comp[0].depth > 8;
+
+    *hash = 1;
+    for (int pp = 0; pp < FRAME_HASH_MAX_PLANES; pp++)
+    {
+        mean[pp] = 0.;
+        if (pp >= planes || buf->plane[pp].data == NULL)
+        {
+            continue;
+        }
+
+        const uint8_t *row   = buf->plane[pp].data;
+        int            bytes = av_image_get_linesize(buf->f.fmt, buf->f.width, pp);
+        int            count = wide ? bytes / 2 : bytes;
+        uint64_t       sum   = 0;
+
+        for (int yy = 0; yy < buf->plane[pp].height; yy++)
+        {
+            *hash = av_adler32_update(*hash, row, bytes);
+            for (int xx = 0; xx < count; xx++)
+            {
+                sum += wide ? ((const uint16_t *)row)[xx] : row[xx];
+            }
+            row += buf->plane[pp].stride;
+        }
+        if (count > 0 && buf->plane[pp].height > 0)
+        {
+            mean[pp] = (double)sum / count / buf->plane[pp].height;
+        }
+    }
+}
+
+void hb_frame_hash_filter(hb_frame_hash_t *fh, hb_filter_object_t *filter,
+                          const hb_buffer_t *buf)
+{
+    int position;
+
+    for (position = 0; position < fh->count; position++)
+    {
+        if (fh->filters[position] == filter)
+        {
+            break;
+        }
+    }
+
+    for (; buf != NULL; buf = buf->next)
+    {
+        uint32_t hash;
+        double   mean[FRAME_HASH_MAX_PLANES];
+
+        if (buf->s.flags & HB_BUF_FLAG_EOF || buf->size <= 0)
+        {
+            continue;
+        }
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(buf->f.fmt);
+        if (desc == NULL || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL))
+        {
+            continue;
+        }
+        hash_frame(buf, &hash, mean);
+
+        hb_lock(fh->lock);
+        fprintf(fh->file, "%d %d %"PRId64" %d %08"PRIx32" %.6f %.6f %.6f %.6f %s\n",
+                position, fh->frames[position]++, buf->s.start, buf->s.combed,
+                hash, mean[0], mean[1], mean[2], mean[3], filter->name);
+        hb_unlock(fh->lock);
+    }
+}
+
+void hb_frame_hash_close(hb_job_t *job)
+{
+    hb_frame_hash_t *fh = job->frame_hash;
+
+    if (fh == NULL)
+    {
+        return;
+    }
+    for (int ii = 0; ii < fh->count; ii++)
+    {
+        fh->filters[ii]->frame_hash = NULL;
+    }
+    if (fclose(fh->file) != 0)
+    {
+        hb_error("frame hash: failed to write %s", job->frame_hash_file);
+    }
+    hb_lock_close(&fh->lock);
+    free(fh->filters);
+    free(fh->frames);
+    free(fh);
+    job->frame_hash = NULL;
+}
+
+static int record_cmp(const void *a, const void *b)
+{
+    const frame_hash_record_t *ra = a, *rb = b;
+
+    if (ra->position != rb->position)
+    {
+        return ra->position < rb->position ? -1 : 1;
+    }
+    if (ra->frame != rb->frame)
+    {
+        return ra->frame < rb->frame ? -1 : 1;
+    }
+    return 0;
+}
+
+static frame_hash_record_t * read_log(const char *path, int *count)
+{
+    frame_hash_record_t *records = NULL, *tmp;
+    int                  alloc = 0, line = 0;
+    char                 buf[256];
+    FILE                *file;
+
+    *count = 0;
+    file = hb_fopen(path, "r");
+    if (file == NULL)
+    {
+        hb_error("frame hash: failed to open %s", path);
+        return NULL;
+    }
+    if (fgets(buf, sizeof(buf), file) == NULL ||
+        strncmp(buf, FRAME_HASH_HEADER, strlen(FRAME_HASH_HEADER)))
+    {
+        hb_error("frame hash: %s is not a frame hash log", path);
+        fclose(file);
+        return NULL;
+    }
+
+    while (fgets(buf, sizeof(buf), file) != NULL)
+    {
+        frame_hash_record_t rec;
+        int                 pos;
+
+        line++;
+        if (buf[0] == '#')
+        {
+            continue;
+        }
+        if (sscanf(buf, "%d %d %"SCNd64" %d %"SCNx32" %lf %lf %lf %lf %n",
+                   &rec.position, &rec.frame, &rec.pts, &rec.combed, &rec.hash,
+                   &rec.mean[0], &rec.mean[1], &rec.mean[2], &rec.mean[3],
+                   &pos) < 9)
+        {
+            hb_error("frame hash: %s line %d is invalid", path, line + 1);
+            free(records);
+            fclose(file);
+            return NULL;
+        }
+        snprintf(rec.name, sizeof(rec.name), "%s", buf + pos);
+        rec.name[strcspn(rec.name, "\r\n")] = 0;
+
+        if (*count == alloc)
+        {
+            alloc = alloc ? alloc * 2 : 1024;
+            tmp   = realloc(records, alloc * sizeof(frame_hash_record_t));
+            if (tmp == NULL)
+            {
+                free(records);
+                fclose(file);
+                return NULL;
+            }
+            records = tmp;
+        }
+        records[(*count)++] = rec;
+    }
+    fclose(file);
+
+    if (records == NULL)
+    {
+        // An empty log is valid, the job may have had no frames
+        records = malloc(sizeof(frame_hash_record_t));
+    }
+    qsort(records, *count, sizeof(frame_hash_record_t), record_cmp);
+    return records;
+}
+
+static double max_mean_diff(const frame_hash_record_t *a,
+                            const frame_hash_record_t *b)
+{
+    double diff = 0.;
+
+    for (int pp = 0; pp < FRAME_HASH_MAX_PLANES; pp++)
+    {
+        diff = MAX(diff, fabs(a->mean[pp] - b->mean[pp]));
+    }
+    return diff;
+}
+
+int hb_frame_hash_compare(const char *path_a, const char *path_b,
+                          double tolerance)
+{
+    frame_hash_record_t *a, *b;
+    int                  count_a, count_b, ia = 0, ib = 0;
+    int                  result = 0;
+
+    a = read_log(path_a, &count_a);
+    b = read_log(path_b, &count_b);
+    if (a == NULL || b == NULL)
+    {
+        free(a);
+        free(b);
+        return -1;
+    }
+
+    // One filter at a time, logs are sorted by filter position then frame
+    while (ia < count_a || ib < count_b)
+    {
+        int         position;
+        const char *name;
+        int         frames = 0, exact = 0, within = 0, differ = 0;
+        int         only_a = 0, only_b = 0;
+        int         first = -1;
+        int64_t     first_pts = 0;
+        double      worst = 0.;
+
+        if (ib >= count_b || (ia < count_a && a[ia].position <= b[ib].position))
+        {
+            position = a[ia].position;
+            name     = a[ia].name;
+        }
+        else
+        {
+            position = b[ib].position;
+            name     = b[ib].name;
+        }
+
+        while ((ia < count_a && a[ia].position == position) ||
+               (ib < count_b && b[ib].position == position))
+        {
+            int in_a = ia < count_a && a[ia].position == position;
+            int in_b = ib < count_b && b[ib].position == position;
+
+            if (in_a && (!in_b || a[ia].frame < b[ib].frame))
+            {
+                only_a++;
+                ia++;
+                continue;
+            }
+            if (in_b && (!in_a || b[ib].frame < a[ia].frame))
+            {
+                only_b++;
+                ib++;
+                continue;
+            }
+
+            frames++;
+            if (a[ia].hash == b[ib].hash && a[ia].combed == b[ib].combed)
+            {
+                exact++;
+            }
+            else
+            {
+                double diff = max_mean_diff(&a[ia], &b[ib]);
+
+                worst = MAX(worst, diff);
+                if (diff <= tolerance && a[ia].combed == b[ib].combed)
+                {
+                    within++;
+                }
+                else
+                {
+                    differ++;
+                }
+                if (first < 0)
+                {
+                    first     = a[ia].frame;
+                    first_pts = a[ia].pts;
+                }
+            }
+            ia++;
+            ib++;
+        }
+
+        hb_log("frame hash: filter %d (%s): %d frames, %d bit exact, "
+               "%d within tolerance, %d differ",
+               position, name, frames, exact, within, differ);
+        if (first >= 0)
+        {
+            hb_log("frame hash:     first difference at frame %d (pts %"PRId64
+                   "), largest plane mean difference %.6f",
+                   first, first_pts, worst);
+        }
+        if (only_a || only_b)
+        {
+            hb_log("frame hash:     frame count differs, %d only in %s, "
+                   "%d only in %s", only_a, path_a, only_b, path_b);
+        }
+        if (differ || only_a || only_b)
+        {
+            result = 1;
+        }
+    }
+
+    free(a);
+    free(b);
+    return result;
+}
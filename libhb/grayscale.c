@@ -14,6 +14,8 @@ const char grayscale_template[] =
     "cb=^"HB_FLOAT_REG"$:cr=^"HB_FLOAT_REG"$:size=^"HB_FLOAT_REG"$:high=^"HB_FLOAT_REG"$";
 
 static int grayscale_init(hb_filter_object_t *filter, hb_filter_init_t *init);
+static int grayscale_work(hb_filter_object_t *filter,
+                          hb_buffer_t **buf_in, hb_buffer_t **buf_out);
 
 hb_filter_object_t hb_filter_grayscale =
 {
@@ -39,9 +41,23 @@ static int grayscale_init(hb_filter_object_t * filter, hb_filter_init_t *init)
         return 1;
     }
     pv->input = *init;
+    pv->output = *init;
 
     hb_dict_t *settings = filter->settings;
 
+    // Without color filter parameters, grayscale only has to
+    // neutralise the chroma planes. Do it natively, in place.
+    if (hb_dict_get(settings, "cb") == NULL &&
+        hb_dict_get(settings, "cr") == NULL &&
+        hb_dict_get(settings, "size") == NULL &&
+        hb_dict_get(settings, "high") == NULL &&
+        init->hw_pix_fmt == AV_PIX_FMT_NONE)
+    {
+        filter->skip = 0;
+        filter->work = grayscale_work;
+        return 0;
+    }
+
     double cb = 0, cr = 0, size = 1, high = 0;
 
     hb_dict_extract_double(&cb, settings, "cb");
@@ -61,7 +77,82 @@ static int grayscale_init(hb_filter_object_t * filter, hb_filter_init_t *init)
 
     pv->avfilters = avfilter;
 
-    pv->output = *init;
-
     return 0;
 }
+
+static void fill_plane(uint8_t *dst, int stride, int width, int height,
+                       int bps, int value)
+{
+    for (int y = 0; y < height; y++)
+    {
+        if (bps == 1)
+        {
+            memset(dst, value, width);
+        }
+        else
+        {
+            uint16_t *dst16 = (uint16_t *)dst;
+            for (int x = 0; x < width; x++)
+            {
+                dst16[x] = value;
+            }
+        }
+        dst += stride;
+    }
+}
+
+static int grayscale_work(hb_filter_object_t *filter,
+                          hb_buffer_t **buf_in, hb_buffer_t **buf_out)
+{
+    hb_filter_private_t *pv = filter->private_data;
+    hb_buffer_t *in = *buf_in, *out;
+
+    if (in->s.flags & HB_BUF_FLAG_EOF)
+    {
+        *buf_out = in;
+        *buf_in = NULL;
+        return HB_FILTER_DONE;
+    }
+
+    if (hb_buffer_is_writable(in))
+    {
+        out = in;
+        *buf_in = NULL;
+    }
+    else
+    {
+        // Only the luma plane has to be copied
+        out = hb_frame_buffer_init(in->f.fmt, in->f.width, in->f.height);
+        if (out == NULL)
+        {
+            hb_error("grayscale: frame buffer allocation failure");
+            return HB_FILTER_FAILED;
+        }
+        out->f.color_prim      = pv->output.color_prim;
+        out->f.color_transfer  = pv->output.color_transfer;
+        out->f.color_matrix    = pv->output.color_matrix;
+        out->f.color_range     = pv->output.color_range;
+        out->f.chroma_location = pv->output.chroma_location;
+        hb_image_copy_plane(out->plane[0].data, in->plane[0].data,
+                            out->plane[0].stride, in->plane[0].stride,
+                            out->plane[0].height);
+        hb_buffer_copy_props(out, in);
+    }
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(out->f.fmt);
+    const AVComponentDescriptor *comp = &desc->comp[1];
+    int bps   = comp->depth + comp->shift > 8 ? 2 : 1;
+    int value = (1 << (comp->depth - 1)) << comp->shift;
+
+    // Semi-planar formats store both chroma components in plane 1
+    for (int pp = 1; pp <= out->f.max_plane && pp < 3; pp++)
+    {
+        int width = out->plane[pp].stride / bps;
+        fill_plane(out->plane[pp].data, out->plane[pp].stride,
+                   width, out->plane[pp].height, bps, value);
+    }
+
+    *buf_out = out;
+
+    return HB_FILTER_OK;
+}
@@ -0,0 +1,61 @@
+/* audio_loudness.h
+ *
+ * Copyright (c) 2003-2025 HandBrake Team
+ * This file is part of the HandBrake source code
+ * Homepage: <http://handbrake.fr/>
+ * It may be used under the terms of the GNU General Public License v2.
+ * For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/* Single pass loudness normalization.
+ *
+ * Loudness is measured as described in ITU-R BS.1770 / EBU R128
+ * (K-weighting, 400 ms blocks with 75% overlap, absolute and relative
+ * gating).  Buffers are held back for a lookahead window, so the gain
+ * applied to a buffer is based on the integrated loudness of everything
+ * up to the end of that window.  Gain changes are slew limited, and the
+ * gain is lowered where needed to keep peaks below the ceiling. */
+
+#ifndef HANDBRAKE_AUDIO_LOUDNESS_H
+#define HANDBRAKE_AUDIO_LOUDNESS_H
+
+#include <stdint.h>
+
+/* Range of the loudness target (LUFS) */
+#define HB_LOUDNESS_TARGET_MIN     -70.0
+#define HB_LOUDNESS_TARGET_MAX      -5.0
+/* Default lookahead window (90 kHz ticks) */
+#define HB_LOUDNESS_LOOKAHEAD_DEFAULT (10 * 90000)
+
+typedef struct hb_audio_loudness_s hb_audio_loudness_t;
+
+/* Initialize loudness normalization of interleaved float samples in the
+ * channel layout of the given mixdown.
+ *
+ * target is the integrated loudness to normalize to, in LUFS.
+ */
+hb_audio_loudness_t * hb_audio_loudness_init(int sample_rate, int hb_amixdown,
+                                             double target, int64_t lookahead);
+
+/* Free an hb_audio_loudness_t and any buffers it still holds. */
+void                  hb_audio_loudness_free(hb_audio_loudness_t **loudness);
+
+/* Measure buf and queue it.
+ *
+ * Returns the oldest queued buffer with gain applied once the lookahead
+ * window is full, NULL otherwise.
+ */
+hb_buffer_t         * hb_audio_loudness_process(hb_audio_loudness_t *loudness,
+                                                hb_buffer_t *buf);
+
+/* Returns the remaining queued buffers one at a time with gain applied,
+ * NULL once the queue is empty. */
+hb_buffer_t         * hb_audio_loudness_flush(hb_audio_loudness_t *loudness);
+
+/* Integrated loudness measured so far (LUFS), -HUGE_VAL if none. */
+double                hb_audio_loudness_integrated(hb_audio_loudness_t *loudness);
+
+/* Gain (dB) applied to the last buffer returned. */
+double                hb_audio_loudness_gain(hb_audio_loudness_t *loudness);
+
+#endif /* HANDBRAKE_AUDIO_LOUDNESS_H */
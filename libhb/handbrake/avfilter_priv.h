@@ -25,10 +25,18 @@ struct hb_filter_private_s
     hb_value_t          * avfilters;
     hb_filter_init_t      input;
     hb_filter_init_t      output;
+
+    // Native crop/scale, used for integer ratio downscales and when
+    // pad immediately follows crop/scale.  See cropscale.c
+    struct hb_crop_scale_pad_s * native;
 };
 
 int  hb_avfilter_null_work( hb_filter_object_t * filter,
                             hb_buffer_t ** buf_in, hb_buffer_t ** buf_out );
 void hb_avfilter_alias_close( hb_filter_object_t * filter );
 
+int  hb_pad_get_region(hb_filter_object_t * filter,
+                       int * width, int * height, int * x, int * y, int * rgb);
+void hb_crop_scale_fuse_pad(hb_list_t * list);
+
 #endif // HANDBRAKE_AVFILTER_PRIV_H
@@ -154,6 +154,7 @@ void hb_job_set_encoder_options(hb_job_t *job, const char *options);
 void hb_job_set_encoder_profile(hb_job_t *job, const char *profile);
 void hb_job_set_encoder_level  (hb_job_t *job, const char *level);
 void hb_job_set_file           (hb_job_t *job, const char *file);
+void hb_job_set_frame_hash_file(hb_job_t *job, const char *file);
 
 hb_audio_t *hb_audio_copy(const hb_audio_t *src);
 hb_list_t *hb_audio_list_copy(const hb_list_t *src);
@@ -644,6 +645,7 @@ struct hb_job_s
     // Video filters
     int             grayscale;      // Black and white encoding
     hb_list_t     * list_filter;
+    char          * frame_hash_file;    // log of filter output frame hashes
 
     PRIVATE int             crop[4];
     PRIVATE int             width;
@@ -731,12 +733,24 @@ struct hb_job_s
 #define HB_VCODEC_FFMPEG_VAAPI_H265        (0x00000081 | HB_VCODEC_FFMPEG_MASK | HB_VCODEC_H265_MASK)
 #define HB_VCODEC_FFMPEG_VAAPI_H265_10BIT  (0x00000082 | HB_VCODEC_FFMPEG_MASK | HB_VCODEC_H265_MASK)
 
+// Copies the source video stream as-is (remux)
+#define HB_VCODEC_PASSTHRU           0x00000090
+
 /* define an invalid CQ value compatible with all CQ-capable codecs */
 #define HB_INVALID_VIDEO_QUALITY (-1000.)
 
     int             vcodec;
     double          vquality;
     int             vbitrate;
+    // Constant quality search: before the encode, sample segments are
+    // encoded and measured to find the lowest quality that meets the
+    // target score (SSIM 0-1 or PSNR dB).  0 disables the search.
+#define HB_QUALITY_METRIC_SSIM  0
+#define HB_QUALITY_METRIC_PSNR  1
+    double          quality_target;
+    int             quality_metric;
+    int             quality_samples;          // number of sample segments
+    int             quality_sample_duration;  // seconds per sample segment
     hb_rational_t   vrate;
     // Some parameters that depend on vrate (like keyint) can't change
     // between encoding passes. So orig_vrate is used to store the
@@ -887,6 +901,8 @@ struct hb_job_s
                                         // added or initial frames dropped.
     int             optimize;
     int             ipod_atom;
+    int             checkpoint;         // seconds between resumable
+                                        // checkpoints, 0 to disable
 
     int                     indepth_scan;
     hb_subtitle_config_t    select_subtitle_config;
@@ -934,10 +950,14 @@ struct hb_job_s
     hb_fifo_t     * fifo_sync;    /* Raw pictures, framerate corrected */
     hb_fifo_t     * fifo_render;  /* Raw pictures, scaled */
     hb_fifo_t     * fifo_out;     /* Encoder video output, input to mux */
+    hb_fifo_t     * fifo_quality_ref; /* Encoder input copies, quality search */
+    double          quality_score;    /* Result of a quality search sample */
 
     hb_list_t     * list_work;
 
     hb_mux_data_t * mux_data;
+    hb_checkpoint_t * checkpoint_state;
+    hb_frame_hash_t * frame_hash;
 
     int64_t         reader_pts_offset; // Reader can discard some video.
                                        // Other pipeline stages need to know
@@ -1054,6 +1074,7 @@ struct hb_audio_config_s
         double   compression_level;  /* Output compression level (encoder-specific) */
         double   dynamic_range_compression; /* Amount of DRC applied to this track */
         double   gain; /* Gain (in dB), negative is quieter */
+        double   loudness_target; /* Normalize to this loudness (LUFS), 0 is off */
         int      normalize_mix_level; /* mix level normalization (boolean) */
         int      dither_method; /* dither algorithm */
         const char * name; /* Output track name */
@@ -1389,6 +1410,7 @@ struct hb_state_s
         struct
         {
             /* HB_STATE_WORKING || HB_STATE_SEARCHING || HB_STATE_WORKDONE */
+#define HB_PASS_QUALITY_SEARCH -2
 #define HB_PASS_SUBTITLE    -1
 #define HB_PASS_ENCODE      0
 #define HB_PASS_ENCODE_ANALYSIS  1   // Some code depends on these values being
@@ -1522,6 +1544,8 @@ extern hb_work_object_t hb_encx264;
 extern hb_work_object_t hb_enctheora;
 extern hb_work_object_t hb_encx265;
 extern hb_work_object_t hb_encsvtav1;
+extern hb_work_object_t hb_decpassthru;
+extern hb_work_object_t hb_encpassthru;
 extern hb_work_object_t hb_decavcodeca;
 extern hb_work_object_t hb_decavcodecv;
 extern hb_work_object_t hb_declpcm;
@@ -1531,6 +1555,8 @@ extern hb_work_object_t hb_encca_aac;
 extern hb_work_object_t hb_encca_haac;
 extern hb_work_object_t hb_encavcodeca;
 extern hb_work_object_t hb_reader;
+extern hb_work_object_t hb_quality_reference;
+extern hb_work_object_t hb_quality_measure;
 
 #define HB_FILTER_OK      0
 #define HB_FILTER_DELAY   1
@@ -1602,6 +1628,7 @@ struct hb_filter_object_s
     int64_t               chapter_time;
 
     hb_filter_object_t  * sub_filter;
+    hb_frame_hash_t     * frame_hash;
 #endif
 };
 
@@ -61,6 +61,8 @@ struct hb_dvdread_s
     int            chapter;
 };
 
+typedef struct hb_dvdnav_ref_s hb_dvdnav_ref_t;
+
 struct hb_dvdnav_s
 {
     char         * path;
@@ -81,6 +83,13 @@ struct hb_dvdnav_s
     int            pgn;
     int64_t        duration;
     hb_list_t    * list_dvd_chapter;
+
+    hb_dvdnav_ref_t * nav_ref;  // keeps dvdnav open while buffers
+                                // hold blocks of its cache
+    uint8_t      * read_next;   // block that starts the next buffer
+    int            read_chap;   // chapter mark for the next buffer
+    int            read_eof;    // end of title reached after last buffer
+    uint8_t        read_scratch[HB_DVD_READ_BUFFER_SIZE];
 };
 
 typedef struct hb_dvd_chapter_s hb_dvd_chapter_t;
@@ -104,6 +113,7 @@ struct hb_dvd_func_s
     int           (* start)       ( hb_dvd_t *, hb_title_t *, int );
     void          (* stop)        ( hb_dvd_t * );
     int           (* seek)        ( hb_dvd_t *, float );
+    int64_t       (* seek_pts)    ( hb_dvd_t *, int64_t );
     hb_buffer_t * (* read)        ( hb_dvd_t * );
     int           (* chapter)     ( hb_dvd_t * );
     int           (* angle_count) ( hb_dvd_t * );
@@ -159,6 +159,21 @@ int hb_get_instance_id( hb_handle_t * h );
 
 int hb_is_hardware_disabled(void);
 
+/* hb_set_reference_kernels()
+   Makes filters use their plain C code instead of SIMD versions, so the
+   frame hashes of the two can be compared with hb_frame_hash_compare().
+   Also masks the CPU flags seen by libavfilter and libswscale. */
+void hb_set_reference_kernels(int enable);
+int  hb_get_reference_kernels(void);
+
+/* hb_frame_hash_compare()
+   Compares two frame hash logs (job->frame_hash_file) of the same job,
+   filter by filter.  Frames that are not bit exact match when the mean
+   of each plane is within tolerance.  Returns 0 if the logs match, 1 if
+   they do not, -1 on error. */
+int  hb_frame_hash_compare(const char *path_a, const char *path_b,
+                           double tolerance);
+
 #ifdef __cplusplus
 }
 #endif
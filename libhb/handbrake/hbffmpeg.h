@@ -58,9 +58,16 @@ hb_sws_get_context(int srcW, int srcH, enum AVPixelFormat srcFormat, int srcRang
                    int dstW, int dstH, enum AVPixelFormat dstFormat, int dstRange,
                    int flags, int colorspace);
 
+struct SwsContext*
+hb_sws_get_context_threads(int srcW, int srcH, enum AVPixelFormat srcFormat, int srcRange,
+                           int dstW, int dstH, enum AVPixelFormat dstFormat, int dstRange,
+                           int flags, int colorspace, int threads);
+
 void            hb_video_buffer_to_avframe(AVFrame *frame, hb_buffer_t **buf);
 hb_buffer_t   * hb_avframe_to_video_buffer(AVFrame *frame,
                                            AVRational time_base);
+hb_buffer_t   * hb_avframe_move_to_video_buffer(AVFrame *frame,
+                                                AVRational time_base);
 void            hb_avframe_set_video_buffer_flags(hb_buffer_t * buf,
                                            AVFrame *frame,
                                            AVRational time_base);
@@ -37,6 +37,8 @@ typedef struct hb_metadata_s hb_metadata_t;
 typedef struct hb_coverart_s hb_coverart_t;
 typedef struct hb_state_s hb_state_t;
 typedef struct hb_data_s hb_data_t;
+typedef struct hb_checkpoint_s hb_checkpoint_t;
+typedef struct hb_frame_hash_s hb_frame_hash_t;
 typedef struct hb_work_private_s hb_work_private_t;
 typedef struct hb_work_object_s  hb_work_object_t;
 typedef struct hb_filter_private_s hb_filter_private_t;
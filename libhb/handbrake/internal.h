@@ -47,6 +47,8 @@ int  hb_get_pid( hb_handle_t * );
 void hb_set_state( hb_handle_t *, hb_state_t * );
 void hb_set_work_error( hb_handle_t * h, hb_error_code err );
 void hb_job_setup_passes(hb_handle_t *h, hb_job_t *job, hb_list_t *list_pass);
+void hb_job_setup_quality_search(hb_handle_t *h, hb_job_t *job,
+                                 double quality, hb_list_t *list_pass);
 
 /***********************************************************************
  * fifo.c
@@ -109,6 +111,18 @@ struct hb_buffer_settings_s
 #define HB_COMB_LIGHT 1
 #define HB_COMB_HEAVY 2
     uint8_t       combed;
+
+    // Per-frame analysis shared between filters. comb_detect measures
+    // the motion metric vfr uses for drop decisions while it scans the
+    // frame, so vfr does not scan it again. Filters that change the
+    // picture must clear it.
+#define HB_ANALYSIS_MOTION 0x01
+    struct
+    {
+        uint8_t   flags;
+        float     motion;       // motion metric against motion_ref
+        int64_t   motion_ref;   // start time of the frame compared to
+    } analysis;
 };
 
 struct hb_image_format_s
@@ -148,7 +162,7 @@ struct hb_buffer_s
     } plane[4]; // 3 Color components + alpha
 
     void  *storage;
-    enum  { STANDARD, AVFRAME, COREMEDIA } storage_type;
+    enum  { STANDARD, AVFRAME, COREMEDIA, AVBUFFER } storage_type;
 
     // libav may attach AV_PKT_DATA_PALETTE side data to some AVPackets
     // Store this data here when read and pass to decoder.
@@ -166,6 +180,7 @@ void hb_buffer_pool_init( void );
 void hb_buffer_pool_free( void );
 
 hb_buffer_t * hb_buffer_wrapper_init();
+hb_buffer_t * hb_buffer_wrap_avbuffer(AVBufferRef *ref);
 hb_buffer_t * hb_buffer_init( int size );
 hb_buffer_t * hb_buffer_eof_init( void );
 hb_buffer_t * hb_frame_buffer_init( int pix_fmt, int w, int h);
@@ -293,6 +308,14 @@ hb_work_object_t * hb_audio_encoder( hb_handle_t *, int );
 hb_work_object_t * hb_video_decoder( hb_handle_t *, int, int, void *, hb_hwaccel_t *hw_accel);
 hb_work_object_t * hb_video_encoder( hb_handle_t *, int );
 
+// Thread pool size of a pipeline stage, see hb_job_thread_count
+enum
+{
+    HB_THREADS_ENCODER,
+    HB_THREADS_FILTER,
+};
+int hb_job_thread_count( hb_job_t * job, int stage );
+
 /***********************************************************************
  * sync.c
  **********************************************************************/
@@ -342,6 +365,7 @@ hb_title_t * hb_dvd_title_scan( hb_dvd_t *, int title, uint64_t min_duration, ui
 int          hb_dvd_start( hb_dvd_t *, hb_title_t *title, int chapter );
 void         hb_dvd_stop( hb_dvd_t * );
 int          hb_dvd_seek( hb_dvd_t *, float );
+int64_t      hb_dvd_seek_pts( hb_dvd_t *, int64_t pts );
 hb_buffer_t * hb_dvd_read( hb_dvd_t * );
 int          hb_dvd_chapter( hb_dvd_t * );
 int          hb_dvd_is_break( hb_dvd_t * d );
@@ -373,6 +397,7 @@ hb_title_t * hb_stream_title_scan( hb_stream_t *, hb_title_t *);
 hb_buffer_t * hb_stream_read( hb_stream_t * );
 int          hb_stream_seek( hb_stream_t *, float );
 int          hb_stream_seek_ts( hb_stream_t * stream, int64_t ts );
+int64_t      hb_stream_seek_pts( hb_stream_t * stream );
 int          hb_stream_seek_chapter( hb_stream_t *, int );
 int          hb_stream_chapter( hb_stream_t * );
 
@@ -433,7 +458,11 @@ enum
     WORK_MUX,
     WORK_READER,
     WORK_DECAVSUB,
-    WORK_ENCAVSUB
+    WORK_ENCAVSUB,
+    WORK_DECPASSTHRU,
+    WORK_ENCPASSTHRU,
+    WORK_QUALITY_REFERENCE,
+    WORK_QUALITY_MEASURE
 };
 
 extern hb_filter_object_t hb_filter_detelecine;
@@ -481,6 +510,14 @@ extern hb_motion_metric_object_t hb_motion_metric_vt;
 extern hb_blend_object_t hb_blend_vt;
 #endif
 
+hb_motion_metric_object_t * hb_motion_metric_init(hb_filter_init_t *init);
+void  hb_motion_metric_close(hb_motion_metric_object_t **metric);
+uint64_t hb_motion_metric_rows(hb_motion_metric_object_t *metric,
+                               hb_buffer_t *buf_a, hb_buffer_t *buf_b,
+                               int start, int stop);
+float hb_motion_metric_finish(hb_motion_metric_object_t *metric,
+                              hb_buffer_t *buf, uint64_t sum);
+
 
 extern hb_work_object_t * hb_objects;
 
@@ -499,7 +536,8 @@ typedef struct hb_mux_data_s   hb_mux_data_t;
     int (*init)      ( hb_mux_object_t * ); \
     int (*mux)       ( hb_mux_object_t *, hb_mux_data_t *, \
                        hb_buffer_t * ); \
-    int (*end)       ( hb_mux_object_t * );
+    int (*end)       ( hb_mux_object_t * ); \
+    int64_t (*flush) ( hb_mux_object_t * );
 
 #define DECLARE_MUX( a ) \
     hb_mux_object_t  * hb_mux_##a##_init( hb_job_t * );
@@ -509,6 +547,27 @@ DECLARE_MUX( mkv );
 DECLARE_MUX( webm );
 DECLARE_MUX( avformat );
 
+/***********************************************************************
+ * checkpoint.c
+ **********************************************************************/
+int          hb_checkpoint_init(hb_job_t *job);
+const char * hb_checkpoint_part_path(hb_checkpoint_t *cp);
+void         hb_checkpoint_video(hb_checkpoint_t *cp, hb_buffer_t *buf);
+int          hb_checkpoint_due(hb_checkpoint_t *cp, hb_buffer_t *buf);
+void         hb_checkpoint_commit(hb_checkpoint_t *cp, int64_t start,
+                                  int64_t size);
+int          hb_checkpoint_join(hb_job_t *job);
+void         hb_checkpoint_close(hb_job_t *job);
+
+/***********************************************************************
+ * frame_hash.c
+ **********************************************************************/
+int          hb_frame_hash_init(hb_job_t *job);
+void         hb_frame_hash_filter(hb_frame_hash_t *fh,
+                                  hb_filter_object_t *filter,
+                                  const hb_buffer_t *buf);
+void         hb_frame_hash_close(hb_job_t *job);
+
 struct hb_chapter_queue_item_s
 {
     int64_t start;
@@ -88,7 +88,22 @@ enum hb_cpu_platform
     HB_CPU_PLATFORM_INTEL_DG2,
     HB_CPU_PLATFORM_INTEL_LNL,
 };
+typedef struct hb_cpu_topology_s
+{
+    int logical;   // usable logical processors, same as hb_get_cpu_count()
+    int online;    // logical processors in the affinity mask
+    int physical;  // physical cores backing the affinity mask
+    int packages;  // processor packages backing the affinity mask
+    int quota;     // cpu quota of the control group, 0 when unlimited
+} hb_cpu_topology_t;
+
+// Most threads a single thread pool (a taskset, codec or filter graph)
+// starts, however many cpus hb_get_cpu_count() reports
+#define HB_THREAD_POOL_MAX 64
+
 int         hb_get_cpu_count(void);
+int         hb_get_thread_count(void);
+void        hb_get_cpu_topology(hb_cpu_topology_t *topology);
 int         hb_get_cpu_platform(void);
 const char* hb_get_cpu_name(void);
 const char* hb_get_cpu_platform_name(void);
@@ -127,6 +142,10 @@ struct dirent * hb_readdir(HB_DIR *dir);
 int hb_mkdir(const char *name);
 int hb_stat(const char *path, hb_stat_t *sb);
 FILE * hb_fopen(const char *path, const char *mode);
+int hb_unlink(const char *path);
+int hb_rename(const char *src, const char *dst);
+int hb_fsync(FILE *f);
+int hb_ftruncate(FILE *f, int64_t size);
 char * hb_strr_dir_sep(const char *path);
 
 /************************************************************************
@@ -170,6 +189,9 @@ typedef struct hb_thread_s hb_thread_t;
 #elif defined( SYS_MINGW )
 #  define HB_LOW_PRIORITY    0
 #  define HB_NORMAL_PRIORITY 0
+#elif defined( SYS_LINUX )
+#  define HB_LOW_PRIORITY    0
+#  define HB_NORMAL_PRIORITY 1
 #endif
 
 #ifndef HB_LOW_PRIORITY
@@ -186,6 +208,15 @@ hb_thread_t * hb_thread_init( const char * name, thread_func_t *function,
 void          hb_thread_close( hb_thread_t ** );
 int           hb_thread_has_exited( hb_thread_t * );
 
+// Scheduling class applied to HB_LOW_PRIORITY threads (Linux only)
+enum
+{
+    HB_THREAD_POLICY_NORMAL = 0,
+    HB_THREAD_POLICY_BATCH,
+    HB_THREAD_POLICY_IDLE,
+};
+void          hb_thread_set_policy( int policy );
+
 void          hb_yield(void);
 
 /************************************************************************
@@ -10727,6 +10727,7 @@ const char hb_builtin_presets_json[] =
 "                    \"AudioSamplerate\": \"auto\",\n"
 "                    \"AudioTrackDRCSlider\": 0.0,\n"
 "                    \"AudioTrackGainSlider\": 0.0,\n"
+"                    \"AudioTrackLoudnessTarget\": 0.0,\n"
 "                    \"AudioTrackQuality\": -1.0,\n"
 "                    \"AudioTrackQualityEnable\": false\n"
 "                }\n"
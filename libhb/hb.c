@@ -12,6 +12,7 @@
 #include "handbrake/hbavfilter.h"
 #include "handbrake/encx264.h"
 #include "libavfilter/avfilter.h"
+#include "libavutil/cpu.h"
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -73,6 +74,7 @@ struct hb_handle_s
 hb_work_object_t * hb_objects = NULL;
 int hb_instance_counter = 0;
 int disable_hardware = 0;
+static int reference_kernels = 0;
 
 static void thread_func( void * );
 
@@ -86,10 +88,10 @@ int hb_avcodec_open(AVCodecContext *avctx, const AVCodec *codec,
     {
 #if defined (__aarch64__) && defined(_WIN32)
         avctx->thread_count = (thread_count == HB_FFMPEG_THREADS_AUTO) ?
-                               hb_get_cpu_count() + 1 : thread_count;
+                               hb_get_thread_count() + 1 : thread_count;
 #else
         avctx->thread_count = (thread_count == HB_FFMPEG_THREADS_AUTO) ?
-                               hb_get_cpu_count() / 2 + 1 : thread_count;
+                               hb_get_thread_count() / 2 + 1 : thread_count;
 #endif
         avctx->thread_type = FF_THREAD_FRAME|FF_THREAD_SLICE;
     }
@@ -453,6 +455,18 @@ void hb_scan( hb_handle_t * h, hb_list_t * paths, int title_index,
         hb_log(" - %s", cpu_type);
     }
     hb_log(" - logical processor count: %d", hb_get_cpu_count());
+    hb_cpu_topology_t topology;
+    hb_get_cpu_topology(&topology);
+    if (topology.physical != topology.online || topology.packages > 1)
+    {
+        hb_log(" - physical cores: %d, packages: %d",
+               topology.physical, topology.packages);
+    }
+    if (topology.quota > 0)
+    {
+        hb_log(" - limited by cgroup cpu quota: %d of %d",
+               topology.quota, topology.online);
+    }
 
 #if HB_PROJECT_FEATURE_QSV
     if (!hb_is_hardware_disabled())
@@ -1795,6 +1809,7 @@ static void hb_add_internal( hb_handle_t * h, hb_job_t * job, hb_list_t *list_pa
     job_copy->encoder_level   = NULL;
     job_copy->encoder_options = NULL;
     job_copy->file            = NULL;
+    job_copy->frame_hash_file = NULL;
     job_copy->list_chapter    = NULL;
     job_copy->list_audio      = NULL;
     job_copy->list_subtitle   = NULL;
@@ -1881,6 +1896,8 @@ static void hb_add_internal( hb_handle_t * h, hb_job_t * job, hb_list_t *list_pa
         job_copy->encoder_level = strdup(job->encoder_level);
     if (job->file != NULL)
         job_copy->file = strdup(job->file);
+    if (job->frame_hash_file != NULL)
+        job_copy->frame_hash_file = strdup(job->frame_hash_file);
 
     job_copy->h     = h;
 
@@ -1948,6 +1965,11 @@ void hb_job_setup_passes(hb_handle_t * h, hb_job_t * job, hb_list_t * list_pass)
     {
         job->multipass = 0;
     }
+    if (job->vcodec == HB_VCODEC_PASSTHRU)
+    {
+        // Nothing to analyse when the video is copied
+        job->multipass = 0;
+    }
     if (job->indepth_scan)
     {
         hb_deep_log(2, "Adding subtitle scan pass");
@@ -1974,6 +1996,78 @@ void hb_job_setup_passes(hb_handle_t * h, hb_job_t * job, hb_list_t * list_pass)
     }
 }
 
+/**
+ * Adds the sample encodes of a constant quality search at one quality
+ * value, one job per sample segment.  Samples start at evenly spread
+ * preview seek points of the title and only carry the video, plus any
+ * burned in subtitles since those change what is encoded.
+ * @param h Handle to hb_handle_t.
+ * @param job Handle to hb_job_t.
+ * @param quality Quality value to encode the samples at.
+ * @param list_pass List the sample jobs are added to.
+ */
+void hb_job_setup_quality_search(hb_handle_t * h, hb_job_t * job,
+                                 double quality, hb_list_t * list_pass)
+{
+    int previews = job->title->preview_count;
+    int samples  = job->quality_samples;
+    int pass_id  = job->pass_id;
+    int ii;
+
+    if (previews <= 0)
+    {
+        previews = samples;
+    }
+    samples = MIN(MAX(samples, 1), previews);
+
+    job->pass_id = HB_PASS_QUALITY_SEARCH;
+    for (ii = 0; ii < samples; ii++)
+    {
+        hb_job_t      * sample;
+        hb_audio_t    * audio;
+        hb_subtitle_t * subtitle;
+        int             count = hb_list_count(list_pass);
+
+        hb_add_internal(h, job, list_pass);
+        if (hb_list_count(list_pass) == count)
+        {
+            continue;
+        }
+        sample = hb_list_item(list_pass, count);
+
+        sample->vquality         = quality;
+        sample->vbitrate         = -1;
+        sample->multipass        = 0;
+        sample->indepth_scan     = 0;
+        sample->checkpoint       = 0;
+        sample->chapter_markers  = 0;
+        sample->start_at_preview = 1 + (ii * previews + previews / 2) / samples;
+        sample->seek_points      = previews;
+        sample->pts_to_start     = 0;
+        sample->pts_to_stop      = sample->quality_sample_duration * 90000LL;
+        sample->frame_to_start   = 0;
+        sample->frame_to_stop    = 0;
+
+        while ((audio = hb_list_item(sample->list_audio, 0)) != NULL)
+        {
+            hb_list_rem(sample->list_audio, audio);
+            hb_audio_close(&audio);
+        }
+        for (int jj = 0; jj < hb_list_count(sample->list_subtitle); )
+        {
+            subtitle = hb_list_item(sample->list_subtitle, jj);
+            if (subtitle->config.dest == RENDERSUB)
+            {
+                jj++;
+                continue;
+            }
+            hb_list_rem(sample->list_subtitle, subtitle);
+            hb_subtitle_close(&subtitle);
+        }
+    }
+    job->pass_id = pass_id;
+}
+
 /**
  * Removes a job from the job list.
  * @param h Handle to hb_handle_t.
@@ -2168,6 +2262,8 @@ int hb_global_init()
     hb_register(&hb_workpass);
     hb_register(&hb_muxer);
     hb_register(&hb_reader);
+    hb_register(&hb_quality_reference);
+    hb_register(&hb_quality_measure);
     hb_register(&hb_sync_video);
     hb_register(&hb_sync_audio);
     hb_register(&hb_sync_subtitle);
@@ -2194,6 +2290,8 @@ int hb_global_init()
     hb_register(&hb_encx265);
 #endif
     hb_register(&hb_encsvtav1);
+    hb_register(&hb_decpassthru);
+    hb_register(&hb_encpassthru);
 
     hb_x264_global_init();
     hb_common_global_init(disable_hardware);
@@ -2424,3 +2522,19 @@ int hb_is_hardware_disabled(void)
 {
     return disable_hardware;
 }
+
+void hb_set_reference_kernels(int enable)
+{
+    reference_kernels = !!enable;
+    // Also keep libavfilter and libswscale off their SIMD code paths
+    av_force_cpu_flags(reference_kernels ? 0 : -1);
+    if (reference_kernels)
+    {
+        hb_log("Init: Using reference C kernels in filters.");
+    }
+}
+
+int hb_get_reference_kernels(void)
+{
+    return reference_kernels;
+}
@@ -671,9 +671,10 @@ hb_dict_t* hb_job_to_dict( const hb_job_t * job )
     if (job->mux)
     {
         hb_dict_t *options_dict;
-        options_dict = json_pack_ex(&error, 0, "{s:o, s:o}",
+        options_dict = json_pack_ex(&error, 0, "{s:o, s:o, s:o}",
             "Optimize",         hb_value_bool(job->optimize),
-            "IpodAtom",         hb_value_bool(job->ipod_atom));
+            "IpodAtom",         hb_value_bool(job->ipod_atom),
+            "Checkpoint",       hb_value_int(job->checkpoint));
         hb_dict_set(dest_dict, "Options", options_dict);
     }
     hb_dict_t *source_dict = hb_dict_get(dict, "Source");
@@ -823,6 +824,17 @@ hb_dict_t* hb_job_to_dict( const hb_job_t * job )
     if (job->vquality > HB_INVALID_VIDEO_QUALITY)
     {
         hb_dict_set(video_dict, "Quality", hb_value_double(job->vquality));
+        if (job->quality_target > 0)
+        {
+            hb_dict_t *search_dict;
+            search_dict = json_pack_ex(&error, 0, "{s:f, s:s, s:i, s:i}",
+                "Target",   job->quality_target,
+                "Metric",   job->quality_metric == HB_QUALITY_METRIC_PSNR ?
+                            "psnr" : "ssim",
+                "Samples",  job->quality_samples,
+                "Duration", job->quality_sample_duration);
+            hb_dict_set(video_dict, "QualitySearch", search_dict);
+        }
     }
     else
     {
@@ -898,6 +910,11 @@ hb_dict_t* hb_job_to_dict( const hb_job_t * job )
 
         hb_value_array_append(filter_list, filter_dict);
     }
+    if (job->frame_hash_file != NULL)
+    {
+        hb_dict_set(filters_dict, "FrameHashFile",
+                    hb_value_string(job->frame_hash_file));
+    }
 
     hb_dict_t *audios_dict = hb_dict_get(dict, "Audio");
     // Construct audio CopyMask
@@ -924,10 +941,11 @@ hb_dict_t* hb_job_to_dict( const hb_job_t * job )
         hb_audio_t *audio = hb_list_item(job->list_audio, ii);
 
         audio_dict = json_pack_ex(&error, 0,
-            "{s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o}",
+            "{s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o, s:o}",
             "Track",                hb_value_int(audio->config.index),
             "Encoder",              hb_value_int(audio->config.out.codec),
             "Gain",                 hb_value_double(audio->config.out.gain),
+            "LoudnessTarget",       hb_value_double(audio->config.out.loudness_target),
             "DRC",                  hb_value_double(audio->config.out.dynamic_range_compression),
             "Mixdown",              hb_value_int(audio->config.out.mixdown),
             "NormalizeMixLevel",    hb_value_bool(audio->config.out.normalize_mix_level),
@@ -1152,6 +1170,7 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     hb_value_t       * mux = NULL, * vcodec = NULL;
     hb_dict_t        * mastering_dict = NULL;
     hb_dict_t        * coll_dict = NULL;
+    hb_dict_t        * search_dict = NULL;
     hb_dict_t        * dovi_dict = NULL;
     hb_value_t       * acodec_copy_mask = NULL, * acodec_fallback = NULL;
     const char       * destfile = NULL;
@@ -1162,6 +1181,7 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     int                passthru_dynamic_hdr_metadata = -1;
     int                subtitle_search_burn = 0;
     const char       * subtitle_search_external_filename = NULL;
+    const char       * frame_hash_file = NULL;
     json_int_t         range_start = -1, range_end = -1, range_seek_points = -1;
     int                vbitrate = -1;
     double             vquality = HB_INVALID_VIDEO_QUALITY;
@@ -1174,8 +1194,8 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     "s:i,"
     // Destination {File, Mux, InlineParameterSets, AlignAVStart,
     //              ChapterMarkers, ChapterList,
-    //              Options {Optimize, IpodAtom}}
-    "s:{s?s, s:o, s?b, s?b, s:b, s?o s?{s?b, s?b}},"
+    //              Options {Optimize, IpodAtom, Checkpoint}}
+    "s:{s?s, s:o, s?b, s?b, s:b, s?o s?{s?b, s?b, s?i}},"
     // Source {Angle, KeepDuplicateTitles, Range {Type, Start, End, SeekPoints}}
     "s:{s?i, s?b, s?{s:s, s?I, s?I, s?I}},"
     // PAR {Num, Den}
@@ -1188,7 +1208,8 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     //       ContentLightLevel,
     //       DolbyVisionConfigurationRecord
     //       ColorPrimariesOverride, ColorTransferOverride, ColorMatrixOverride,
-    //       HardwareDecode, AdapterIndex, AsyncDepth
+    //       HardwareDecode, AdapterIndex, AsyncDepth,
+    //       QualitySearch
     "s:{s:o, s?F, s?i, s?s, s?s, s?s, s?s, s?s,"
     "   s?b, s?b, s?i,"
     "   s?i, s?i, s?i,"
@@ -1197,7 +1218,8 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     "   s?o,"
     "   s?o,"
     "   s?i, s?i, s?i,"
-    "   s?i, s?i, s?i},"
+    "   s?i, s?i, s?i,"
+    "   s?o},"
     // Audio {CopyMask, FallbackEncoder, AudioList}
     "s?{s?o, s?o, s?o},"
     // Subtitle {Search {Enable, Forced, Default, Burn, ExternalFilename}, SubtitleList}
@@ -1206,8 +1228,8 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     "s?o,"
     // Cover arts
     "s?o,"
-    // Filters {FilterList}
-    "s?{s?o}"
+    // Filters {FilterList, FrameHashFile}
+    "s?{s?o, s?s}"
     "}",
         "SequenceID",               unpack_i(&job->sequence_id),
         "Destination",
@@ -1220,6 +1242,7 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
             "Options",
                 "Optimize",         unpack_b(&job->optimize),
                 "IpodAtom",         unpack_b(&job->ipod_atom),
+                "Checkpoint",       unpack_i(&job->checkpoint),
         "Source",
             "Angle",                unpack_i(&job->angle),
             "KeepDuplicateTitles",  unpack_b(&job->keep_duplicate_titles),
@@ -1259,6 +1282,7 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
             "HardwareDecode",         unpack_i(&job->hw_decode),
             "AdapterIndex",           unpack_i(&job->hw_device_index),
             "AsyncDepth",             unpack_i(&job->hw_device_async_depth),
+            "QualitySearch",          unpack_o(&search_dict),
         "Audio",
             "CopyMask",             unpack_o(&acodec_copy_mask),
             "FallbackEncoder",      unpack_o(&acodec_fallback),
@@ -1274,7 +1298,8 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
         "Metadata",                 unpack_o(&meta_dict),
         "CoverArts",                unpack_o(&art_array),
         "Filters",
-            "FilterList",           unpack_o(&filter_list)
+            "FilterList",           unpack_o(&filter_list),
+            "FrameHashFile",        unpack_s(&frame_hash_file)
     );
     if (result < 0)
     {
@@ -1388,6 +1413,7 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
     hb_job_set_encoder_profile(job, video_profile);
     hb_job_set_encoder_level(job, video_level);
     hb_job_set_encoder_options(job, video_options);
+    hb_job_set_frame_hash_file(job, frame_hash_file);
 
     // If both vbitrate and vquality were specified, vbitrate is used;
     // we need to ensure the unused rate control mode is always set to an
@@ -1462,6 +1488,39 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
         }
     }
 
+    if (search_dict != NULL)
+    {
+        const char *metric = NULL;
+
+        result = json_unpack_ex(search_dict, &error, 0,
+        // {Target, Metric, Samples, Duration}
+        "{s:F, s?s, s?i, s?i}",
+            "Target",   unpack_f(&job->quality_target),
+            "Metric",   unpack_s(&metric),
+            "Samples",  unpack_i(&job->quality_samples),
+            "Duration", unpack_i(&job->quality_sample_duration)
+        );
+        if (result < 0)
+        {
+            hb_error("hb_dict_to_job: failed to parse search_dict: %s", error.text);
+            goto fail;
+        }
+        if (metric != NULL && !strcasecmp(metric, "psnr"))
+        {
+            job->quality_metric = HB_QUALITY_METRIC_PSNR;
+        }
+        else if (metric != NULL && strcasecmp(metric, "ssim"))
+        {
+            hb_error("hb_dict_to_job: invalid quality metric (%s)", metric);
+            goto fail;
+        }
+        if (job->quality_samples < 1 || job->quality_sample_duration < 1)
+        {
+            hb_error("hb_dict_to_job: invalid quality search samples");
+            goto fail;
+        }
+    }
+
     if (dovi_dict != NULL)
     {
         result = json_unpack_ex(dovi_dict, &error, 0,
@@ -1614,11 +1673,12 @@ hb_job_t* hb_dict_to_job( hb_handle_t * h, hb_dict_t *dict )
 
             hb_audio_config_init(&audio);
             result = json_unpack_ex(audio_dict, &error, 0,
-                "{s:i, s?s, s?o, s?F, s?F, s?o, s?b, s?o, s?o, s?i, s?F, s?F}",
+                "{s:i, s?s, s?o, s?F, s?F, s?F, s?o, s?b, s?o, s?o, s?i, s?F, s?F}",
                 "Track",                unpack_i(&audio.index),
                 "Name",                 unpack_s(&name),
                 "Encoder",              unpack_o(&acodec),
                 "Gain",                 unpack_f(&audio.out.gain),
+                "LoudnessTarget",       unpack_f(&audio.out.loudness_target),
                 "DRC",                  unpack_f(&audio.out.dynamic_range_compression),
                 "Mixdown",              unpack_o(&mixdown),
                 "NormalizeMixLevel",    unpack_b(&audio.out.normalize_mix_level),
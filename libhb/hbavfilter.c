@@ -57,6 +57,16 @@ hb_avfilter_graph_init(hb_value_t * settings, hb_filter_init_t * init)
         goto fail;
     }
 
+    // Slice threaded avfilters default to one thread per logical cpu,
+    // which oversubscribes the cpus when several graphs run alongside
+    // the decoder, the encoder and the native filter threads.
+    // Must be set before any filter is added to the graph
+    graph->avgraph->thread_type = AVFILTER_THREAD_SLICE;
+    graph->avgraph->nb_threads  = hb_job_thread_count(init->job,
+                                                      HB_THREADS_FILTER);
+    hb_deep_log(2, "hb_avfilter_graph_init: %d slice threads for '%s'",
+                graph->avgraph->nb_threads, graph->settings);
+
 #if 0
     avfilter_graph_set_auto_convert(graph->avgraph, AVFILTER_AUTO_CONVERT_NONE);
 #endif
@@ -267,7 +277,7 @@ hb_buffer_t * hb_avfilter_get_buf(hb_avfilter_graph_t * graph)
     int result = av_buffersink_get_frame(graph->output, graph->frame);
     if (result >= 0)
     {
-        hb_buffer_t *buf = hb_avframe_to_video_buffer(graph->frame, graph->out_time_base);
+        hb_buffer_t *buf = hb_avframe_move_to_video_buffer(graph->frame, graph->out_time_base);
         av_frame_unref(graph->frame);
         return buf;
     }
@@ -281,6 +291,9 @@ void hb_avfilter_combine( hb_list_t * list)
     hb_value_t          * settings = NULL;
     int                   ii;
 
+    // Let crop/scale write directly into padded frames when possible
+    hb_crop_scale_fuse_pad(list);
+
     for (ii = 0; ii < hb_list_count(list); ii++)
     {
         hb_filter_object_t * filter = hb_list_item(list, ii);
@@ -290,7 +303,6 @@ void hb_avfilter_combine( hb_list_t * list)
             case HB_FILTER_AVFILTER:
             case HB_FILTER_YADIF:
             case HB_FILTER_BWDIF:
-            case HB_FILTER_DEBLOCK:
             case HB_FILTER_CROP_SCALE:
             case HB_FILTER_PAD:
             case HB_FILTER_ROTATE:
@@ -299,6 +311,12 @@ void hb_avfilter_combine( hb_list_t * list)
             case HB_FILTER_FORMAT:
             {
                 settings = pv->avfilters;
+                if (settings == NULL)
+                {
+                    // Filter is not an avfilter alias (anymore),
+                    // following aliases must start a new graph
+                    avfilter = NULL;
+                }
             } break;
             default:
             {
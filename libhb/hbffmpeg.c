@@ -31,26 +31,6 @@ static int get_frame_type(int type)
     }
 }
 
-static void free_side_data(AVFrameSideData **ptr_sd)
-{
-    AVFrameSideData *sd = *ptr_sd;
-
-    av_buffer_unref(&sd->buf);
-    av_dict_free(&sd->metadata);
-    av_freep(ptr_sd);
-}
-
-static void wipe_avframe_side_data(AVFrame *frame)
-{
-    for (int i = 0; i < frame->nb_side_data; i++)
-    {
-        free_side_data(&frame->side_data[i]);
-    }
-    frame->nb_side_data = 0;
-
-    av_freep(&frame->side_data);
-}
-
 static void hb_buffer_close_callback(void *opaque, uint8_t *data)
 {
     hb_buffer_t *buf = opaque;
@@ -63,7 +43,11 @@ void hb_video_buffer_to_avframe(AVFrame *frame, hb_buffer_t **buf_in)
 
     if (buf->storage_type == AVFRAME)
     {
-        av_frame_ref(frame, buf->storage);
+        // The hb_buffer_t is consumed, move the frame
+        // and its side data instead of referencing them
+        av_frame_move_ref(frame, buf->storage);
+        buf->side_data = NULL;
+        buf->nb_side_data = 0;
     }
     else
     {
@@ -82,17 +66,12 @@ void hb_video_buffer_to_avframe(AVFrame *frame, hb_buffer_t **buf_in)
             frame->linesize[pp] = buf->plane[pp].stride;
         }
 
-        for (int i = 0; i < buf->nb_side_data; i++)
-        {
-            const AVFrameSideData *sd_src = buf->side_data[i];
-            AVBufferRef *ref = av_buffer_ref(sd_src->buf);
-            AVFrameSideData *sd_dst = av_frame_new_side_data_from_buf(frame, sd_src->type, ref);
-            if (!sd_dst)
-            {
-                av_buffer_unref(&ref);
-                wipe_avframe_side_data(frame);
-            }
-        }
+        // hb_buffer_t side data entries are allocated like AVFrame ones,
+        // hand over the whole array to the frame in constant time
+        frame->side_data = (AVFrameSideData **)buf->side_data;
+        frame->nb_side_data = buf->nb_side_data;
+        buf->side_data = NULL;
+        buf->nb_side_data = 0;
 
         frame->extended_data = frame->data;
     }
@@ -178,7 +157,8 @@ void hb_avframe_set_video_buffer_flags(hb_buffer_t * buf, AVFrame *frame,
 
 #define HB_BUFFER_WRAP_AVFRAME 1
 
-hb_buffer_t * hb_avframe_to_video_buffer(AVFrame *frame, AVRational time_base)
+static hb_buffer_t * avframe_to_video_buffer(AVFrame *frame,
+                                             AVRational time_base, int move)
 {
     hb_buffer_t *buf;
 
@@ -198,14 +178,19 @@ hb_buffer_t * hb_avframe_to_video_buffer(AVFrame *frame, AVRational time_base)
         return NULL;
     }
 
-    int ret;
-    ret = av_frame_ref(frame_copy, frame);
-
-    if (ret < 0)
+    if (move)
     {
-        hb_buffer_close(&buf);
-        av_frame_free(&frame_copy);
-        return NULL;
+        av_frame_move_ref(frame_copy, frame);
+    }
+    else
+    {
+        int ret = av_frame_ref(frame_copy, frame);
+        if (ret < 0)
+        {
+            hb_buffer_close(&buf);
+            av_frame_free(&frame_copy);
+            return NULL;
+        }
     }
 
     buf->storage_type = AVFRAME;
@@ -256,15 +241,25 @@ hb_buffer_t * hb_avframe_to_video_buffer(AVFrame *frame, AVRational time_base)
                             buf->plane[pp].stride, frame->linesize[pp],
                             buf->plane[pp].height);
     }
-    for (int i = 0; i < frame->nb_side_data; i++)
+    if (move)
+    {
+        buf->side_data = (void **)frame->side_data;
+        buf->nb_side_data = frame->nb_side_data;
+        frame->side_data = NULL;
+        frame->nb_side_data = 0;
+    }
+    else
     {
-        const AVFrameSideData *sd_src = frame->side_data[i];
-        AVBufferRef *ref = av_buffer_ref(sd_src->buf);
-        AVFrameSideData *sd_dst = hb_buffer_new_side_data_from_buf(buf, sd_src->type, ref);
-        if (!sd_dst)
+        for (int i = 0; i < frame->nb_side_data; i++)
         {
-            av_buffer_unref(&ref);
-            hb_buffer_wipe_side_data(buf);
+            const AVFrameSideData *sd_src = frame->side_data[i];
+            AVBufferRef *ref = av_buffer_ref(sd_src->buf);
+            AVFrameSideData *sd_dst = hb_buffer_new_side_data_from_buf(buf, sd_src->type, ref);
+            if (!sd_dst)
+            {
+                av_buffer_unref(&ref);
+                hb_buffer_wipe_side_data(buf);
+            }
         }
     }
 #endif
@@ -272,10 +267,32 @@ hb_buffer_t * hb_avframe_to_video_buffer(AVFrame *frame, AVRational time_base)
     return buf;
 }
 
+hb_buffer_t * hb_avframe_to_video_buffer(AVFrame *frame, AVRational time_base)
+{
+    return avframe_to_video_buffer(frame, time_base, 0);
+}
+
+// Same as hb_avframe_to_video_buffer, but takes over the frame
+// references and side data in constant time.  frame is left blank.
+hb_buffer_t * hb_avframe_move_to_video_buffer(AVFrame *frame, AVRational time_base)
+{
+    return avframe_to_video_buffer(frame, time_base, 1);
+}
+
 struct SwsContext*
 hb_sws_get_context(int srcW, int srcH, enum AVPixelFormat srcFormat, int srcRange,
                    int dstW, int dstH, enum AVPixelFormat dstFormat, int dstRange,
                    int flags, int colorspace)
+{
+    return hb_sws_get_context_threads(srcW, srcH, srcFormat, srcRange,
+                                      dstW, dstH, dstFormat, dstRange,
+                                      flags, colorspace, 1);
+}
+
+struct SwsContext*
+hb_sws_get_context_threads(int srcW, int srcH, enum AVPixelFormat srcFormat, int srcRange,
+                           int dstW, int dstH, enum AVPixelFormat dstFormat, int dstRange,
+                           int flags, int colorspace, int threads)
 {
     struct SwsContext * ctx;
 
@@ -293,6 +310,7 @@ hb_sws_get_context(int srcW, int srcH, enum AVPixelFormat srcFormat, int srcRang
         av_opt_set_int(ctx, "dst_range", dstRange, 0);
         av_opt_set_int(ctx, "dst_format", dstFormat, 0);
         av_opt_set_int(ctx, "sws_flags", flags, 0);
+        av_opt_set_int(ctx, "threads", threads, 0);
 
         sws_setColorspaceDetails( ctx,
                       sws_getCoefficients( colorspace ), // src colorspace
@@ -45,7 +45,7 @@ static hb_buffer_t * upload(void *hw_frames_ctx, hb_buffer_t **buf_in)
         goto fail;
     }
 
-    hb_buffer_t *out = hb_avframe_to_video_buffer(hw_frame, (AVRational){1,1});
+    hb_buffer_t *out = hb_avframe_move_to_video_buffer(hw_frame, (AVRational){1,1});
 
     av_frame_unref(&frame);
     av_frame_unref(hw_frame);
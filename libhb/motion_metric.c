@@ -27,6 +27,16 @@ struct hb_motion_metric_private_s
                            int width, int height,
                            int stride_a, int stride_b,
                            const uint8_t *buf_a, const uint8_t *buf_b);
+    float (*sse_metric)(hb_motion_metric_private_t *pv,
+                        int width, int height,
+                        int stride_a, int stride_b,
+                        const uint8_t *buf_a, const uint8_t *buf_b);
+    uint64_t (*motion_metric_rows)(hb_motion_metric_private_t *pv,
+                                   int width, int height,
+                                   int stride_a, int stride_b,
+                                   const uint8_t *buf_a, const uint8_t *buf_b,
+                                   int start, int stop);
+    int       fast;
 };
 
 // Create gamma lookup table.
@@ -78,8 +88,8 @@ APPROX_FRAME_DATA(16)
 // count less.
 #if defined (__aarch64__) && !defined(__APPLE__)
 
-#define DEF_MOTION_METRIC(nbits)                                                           \
-static float motion_metric##_##nbits(hb_motion_metric_private_t *pv,                       \
+#define DEF_MOTION_METRIC_NEON(nbits)                                                      \
+static float motion_metric_neon##_##nbits(hb_motion_metric_private_t *pv,                  \
                                      int width, int height,                                \
                                      int stride_a, int stride_b,                           \
                                      const uint8_t *a, const uint8_t *b)                   \
@@ -91,6 +101,8 @@ static float motion_metric##_##nbits(hb_motion_metric_private_t *pv,
     buf_b     = (uint##nbits##_t *)b;                                                      \
     bw        = width / 16;                                                                \
     bh        = height / 16;                                                               \
+    stride_a /= pv->bps;                                                                   \
+    stride_b /= pv->bps;                                                                   \
                                                                                            \
     uint64_t sum = 0;                                                                      \
     for (int y = 0; y < bh; y++)                                                           \
@@ -136,7 +148,10 @@ static float motion_metric##_##nbits(hb_motion_metric_private_t *pv,
     return (float)sum / (width * height);                                                  \
 }                                                                                          \
 
-#else
+DEF_MOTION_METRIC_NEON(8)
+DEF_MOTION_METRIC_NEON(16)
+
+#endif
 
 #define DEF_SSE_BLOCK16(nbits)                                                         \
 static inline unsigned sse_block16##_##nbits(unsigned *gamma_lut,                      \
@@ -193,8 +208,6 @@ static float motion_metric##_##nbits(hb_motion_metric_private_t *pv,
     return (float)sum / (width * height);                                                   \
 }                                                                                           \
 
-#endif
-
 DEF_MOTION_METRIC(8)
 DEF_MOTION_METRIC(16)
 
@@ -218,16 +231,89 @@ static float motion_metric_fast##_##nbits(hb_motion_metric_private_t *pv,
     approximate_frame_data##_##nbits((const uint##nbits##_t *)b, buf_b,                     \
                                      stride_b / pv->bps, stride_buf_b, width, height);      \
                                                                                             \
-    return motion_metric##_##nbits(pv, width, height,                                       \
-                                   stride_buf_a, stride_buf_b,                              \
-                                   (const uint8_t *)buf_a, (const uint8_t *)buf_b);         \
+    return pv->sse_metric(pv, width, height,                                                \
+                          stride_buf_a * pv->bps, stride_buf_b * pv->bps,                   \
+                          (const uint8_t *)buf_a, (const uint8_t *)buf_b);                  \
 }                                                                                           \
 
 DEF_MOTION_METRIC_FAST(8)
 DEF_MOTION_METRIC_FAST(16)
 
-static int hb_motion_metric_init(hb_motion_metric_object_t *metric,
-                                 hb_filter_init_t *init)
+// Partial sums of motion_metric() and motion_metric_fast() over the
+// 16x16 blocks whose first row lies in [start, stop) of the full size
+// picture. Summing the parts of all row segments gives exactly the sum
+// the whole frame functions compute.
+#define DEF_MOTION_METRIC_ROWS(nbits)                                                       \
+static uint64_t motion_metric_rows##_##nbits(hb_motion_metric_private_t *pv,                \
+                                     int width, int height,                                 \
+                                     int stride_a, int stride_b,                            \
+                                     const uint8_t *a, const uint8_t *b,                    \
+                                     int start, int stop)                                   \
+{                                                                                           \
+    int bw, bh;                                                                             \
+    uint##nbits##_t *buf_a, *buf_b;                                                         \
+                                                                                            \
+    buf_a     = (uint##nbits##_t *)a;                                                       \
+    buf_b     = (uint##nbits##_t *)b;                                                       \
+    bw        = width / 16;                                                                 \
+    bh        = MIN(height / 16, (stop + 15) / 16);                                         \
+    stride_a /= pv->bps;                                                                    \
+    stride_b /= pv->bps;                                                                    \
+                                                                                            \
+    uint64_t sum = 0;                                                                       \
+    for (int y = (start + 15) / 16; y < bh; y++)                                            \
+    {                                                                                       \
+        for (int x = 0; x < bw; x++)                                                        \
+        {                                                                                   \
+            sum += sse_block16##_##nbits(pv->gamma_lut,                                     \
+                        buf_a + y * 16 * stride_a + x * 16,                                 \
+                        buf_b + y * 16 * stride_b + x * 16,                                 \
+                        stride_a, stride_b);                                                \
+        }                                                                                   \
+    }                                                                                       \
+    return sum;                                                                             \
+}                                                                                           \
+                                                                                            \
+static uint64_t motion_metric_fast_rows##_##nbits(hb_motion_metric_private_t *pv,           \
+                                     int width, int height,                                 \
+                                     int stride_a, int stride_b,                            \
+                                     const uint8_t *a, const uint8_t *b,                    \
+                                     int start, int stop)                                   \
+{                                                                                           \
+    uint##nbits##_t *buf_a, *buf_b;                                                         \
+    int first, last;                                                                        \
+    width  /= 4;                                                                            \
+    height /= 4;                                                                            \
+    buf_a = (uint##nbits##_t *)pv->approx_buf_a;                                            \
+    buf_b = (uint##nbits##_t *)pv->approx_buf_b;                                            \
+                                                                                            \
+    /* A block of the approximated frame covers 64 source rows */                           \
+    first = (start + 63) / 64;                                                              \
+    last  = MIN(height / 16, (stop + 63) / 64);                                             \
+    if (first >= last)                                                                      \
+    {                                                                                       \
+        return 0;                                                                           \
+    }                                                                                       \
+                                                                                            \
+    /* Each segment fills its own rows of the approximation buffers */                      \
+    approximate_frame_data##_##nbits(                                                       \
+        (const uint##nbits##_t *)(a + first * 64 * stride_a), buf_a + first * 16 * width,   \
+        stride_a / pv->bps, width, width, (last - first) * 16);                             \
+    approximate_frame_data##_##nbits(                                                       \
+        (const uint##nbits##_t *)(b + first * 64 * stride_b), buf_b + first * 16 * width,   \
+        stride_b / pv->bps, width, width, (last - first) * 16);                             \
+                                                                                            \
+    return motion_metric_rows##_##nbits(pv, width, height,                                  \
+                                        width * pv->bps, width * pv->bps,                   \
+                                        (const uint8_t *)buf_a, (const uint8_t *)buf_b,     \
+                                        first * 16, last * 16);                             \
+}                                                                                           \
+
+DEF_MOTION_METRIC_ROWS(8)
+DEF_MOTION_METRIC_ROWS(16)
+
+static int motion_metric_init(hb_motion_metric_object_t *metric,
+                              hb_filter_init_t *init)
 {
     metric->private_data = calloc(sizeof(struct hb_motion_metric_private_s), 1);
     if (metric->private_data == NULL)
@@ -269,18 +355,37 @@ static int hb_motion_metric_init(hb_motion_metric_object_t *metric,
     switch (pv->depth)
     {
         case 8:
-            pv->motion_metric = fast ? motion_metric_fast_8 : motion_metric_8;
+            pv->sse_metric    = motion_metric_8;
+#if defined (__aarch64__) && !defined(__APPLE__)
+            if (!hb_get_reference_kernels())
+            {
+                pv->sse_metric = motion_metric_neon_8;
+            }
+#endif
+            pv->motion_metric = fast ? motion_metric_fast_8 : pv->sse_metric;
+            pv->motion_metric_rows = fast ? motion_metric_fast_rows_8 :
+                                            motion_metric_rows_8;
             break;
         default:
-            pv->motion_metric = fast ? motion_metric_fast_16 : motion_metric_16;
+            pv->sse_metric    = motion_metric_16;
+#if defined (__aarch64__) && !defined(__APPLE__)
+            if (!hb_get_reference_kernels())
+            {
+                pv->sse_metric = motion_metric_neon_16;
+            }
+#endif
+            pv->motion_metric = fast ? motion_metric_fast_16 : pv->sse_metric;
+            pv->motion_metric_rows = fast ? motion_metric_fast_rows_16 :
+                                            motion_metric_rows_16;
     }
+    pv->fast = fast;
 
     return 0;
 }
 
-static float hb_motion_metric_work(hb_motion_metric_object_t *metric,
-                                   hb_buffer_t *buf_a,
-                                   hb_buffer_t *buf_b)
+static float motion_metric_work(hb_motion_metric_object_t *metric,
+                                hb_buffer_t *buf_a,
+                                hb_buffer_t *buf_b)
 {
     hb_motion_metric_private_t *pv = metric->private_data;
 
@@ -290,7 +395,7 @@ static float hb_motion_metric_work(hb_motion_metric_object_t *metric,
                              buf_a->plane[0].data, buf_b->plane[0].data);
 }
 
-static void hb_motion_metric_close(hb_motion_metric_object_t *metric)
+static void motion_metric_close(hb_motion_metric_object_t *metric)
 {
     hb_motion_metric_private_t *pv = metric->private_data;
 
@@ -308,7 +413,88 @@ static void hb_motion_metric_close(hb_motion_metric_object_t *metric)
 hb_motion_metric_object_t hb_motion_metric =
 {
     .name  = "Motion metric",
-    .init  = hb_motion_metric_init,
-    .work  = hb_motion_metric_work,
-    .close = hb_motion_metric_close,
+    .init  = motion_metric_init,
+    .work  = motion_metric_work,
+    .close = motion_metric_close,
 };
+
+hb_motion_metric_object_t * hb_motion_metric_init(hb_filter_init_t *init)
+{
+    hb_motion_metric_object_t *metric;
+    switch (init->hw_pix_fmt)
+    {
+#if defined(__APPLE__)
+        case AV_PIX_FMT_VIDEOTOOLBOX:
+            metric = &hb_motion_metric_vt;
+            break;
+#endif
+        default:
+            metric = &hb_motion_metric;
+            break;
+    }
+
+    hb_motion_metric_object_t *metric_copy = malloc(sizeof(hb_motion_metric_object_t));
+    if (metric_copy == NULL)
+    {
+        hb_error("motion_metric: malloc failed");
+        return NULL;
+    }
+
+    memcpy(metric_copy, metric, sizeof(hb_motion_metric_object_t));
+
+    if (metric_copy->init(metric_copy, init))
+    {
+        free(metric_copy);
+        hb_error("motion_metric: init failed");
+        return NULL;
+    }
+
+    return metric_copy;
+}
+
+void hb_motion_metric_close(hb_motion_metric_object_t **_m)
+{
+    hb_motion_metric_object_t *m = *_m;
+
+    if (m == NULL)
+    {
+        return;
+    }
+
+    m->close(m);
+
+    free(m);
+    *_m = NULL;
+}
+
+// Motion metric of the rows [start, stop) of buf_a and buf_b, for filters
+// that already walk the frame in row segments and want to measure it in
+// the same pass. Only the software metric supports this.
+uint64_t hb_motion_metric_rows(hb_motion_metric_object_t *metric,
+                               hb_buffer_t *buf_a, hb_buffer_t *buf_b,
+                               int start, int stop)
+{
+    hb_motion_metric_private_t *pv = metric->private_data;
+
+    return pv->motion_metric_rows(pv, buf_a->f.width, buf_a->f.height,
+                                  buf_a->plane[0].stride, buf_b->plane[0].stride,
+                                  buf_a->plane[0].data, buf_b->plane[0].data,
+                                  start, stop);
+}
+
+// Turns the summed results of hb_motion_metric_rows() into the value
+// the metric's work() returns for the whole frame
+float hb_motion_metric_finish(hb_motion_metric_object_t *metric,
+                              hb_buffer_t *buf, uint64_t sum)
+{
+    hb_motion_metric_private_t *pv = metric->private_data;
+    int width  = buf->f.width;
+    int height = buf->f.height;
+
+    if (pv->fast)
+    {
+        width  /= 4;
+        height /= 4;
+    }
+    return (float)sum / (width * height);
+}
@@ -51,6 +51,9 @@ struct hb_mux_object_s
 
     int                 ntracks;
     hb_mux_data_t    ** tracks;
+
+    AVDictionary      * av_opts;        // until the header is written
+    int                 header_written;
 };
 
 enum
@@ -246,6 +249,61 @@ static int set_extradata(hb_data_t *extradata, uint8_t **priv_data, int *priv_si
  **********************************************************************
  * Allocates hb_mux_data_t structures, create file and write headers
  *********************************************************************/
+static int write_header(hb_mux_object_t *m)
+{
+    hb_job_t      * job   = m->job;
+    hb_mux_data_t * track = job->mux_data;
+    int             ii, ret;
+
+    if (m->header_written)
+    {
+        return 0;
+    }
+    if (track == NULL)
+    {
+        // Init failed
+        return -1;
+    }
+
+    if (track->st->codecpar->extradata == NULL &&
+        set_extradata(job->extradata, &track->st->codecpar->extradata,
+                      &track->st->codecpar->extradata_size))
+    {
+        return -1;
+    }
+
+    ret = avformat_write_header(m->oc, &m->av_opts);
+    if( ret < 0 )
+    {
+        hb_error( "muxavformat: avformat_write_header failed!");
+        av_dict_free(&m->av_opts);
+        return -1;
+    }
+
+    AVDictionaryEntry *t = NULL;
+    while( ( t = av_dict_get( m->av_opts, "", t, AV_DICT_IGNORE_SUFFIX ) ) )
+    {
+        hb_log( "muxavformat: Unknown option %s", t->key );
+    }
+    av_dict_free( &m->av_opts );
+
+    for (ii = 0; ii < m->ntracks; ii++)
+    {
+        if (m->tracks[ii]->oc != NULL)
+        {
+            ret = avformat_write_header(m->tracks[ii]->oc, NULL);
+            if( ret < 0 )
+            {
+                hb_error( "muxavformat: avformat_write_header external track failed!");
+                return -1;
+            }
+        }
+    }
+    m->header_written = 1;
+
+    return 0;
+}
+
 static int avformatInit( hb_mux_object_t * m )
 {
     hb_job_t   * job   = m->job;
@@ -259,6 +317,7 @@ static int avformatInit( hb_mux_object_t * m )
     hb_video_framerate_get_limits(&clock_min, &clock_max, &clock);
 
     const char *muxer_name = NULL;
+    const char *filename;
 
     uint8_t         default_track_flag = 1;
     uint8_t         need_fonts = 0;
@@ -297,7 +356,10 @@ static int avformatInit( hb_mux_object_t * m )
 
             av_dict_set(&av_opts, "brand", "mp42", 0);
             av_dict_set(&av_opts, "strict", "experimental", 0);
-            if (job->optimize)
+            if (job->checkpoint_state != NULL)
+                // Fragments keep the part readable up to the last flush
+                av_dict_set(&av_opts, "movflags", "frag_keyframe+empty_moov+default_base_moof+disable_chpl+write_colr", 0);
+            else if (job->optimize)
                 av_dict_set(&av_opts, "movflags", "faststart+disable_chpl+write_colr", 0);
             else
                 av_dict_set(&av_opts, "movflags", "+disable_chpl+write_colr", 0);
@@ -330,14 +392,17 @@ static int avformatInit( hb_mux_object_t * m )
         }
     }
 
-    ret = avformat_alloc_output_context2(&m->oc, NULL, muxer_name, job->file);
+    // Resumable encodes write a part file that is joined at the end
+    filename = job->checkpoint_state != NULL ?
+               hb_checkpoint_part_path(job->checkpoint_state) : job->file;
+    ret = avformat_alloc_output_context2(&m->oc, NULL, muxer_name, filename);
     if (ret < 0)
     {
         hb_error( "Could not initialize avformat context." );
         goto error;
     }
 
-    ret = avio_open2(&m->oc->pb, job->file, AVIO_FLAG_WRITE,
+    ret = avio_open2(&m->oc->pb, filename, AVIO_FLAG_WRITE,
                      &m->oc->interrupt_callback, NULL);
     if (ret < 0)
     {
@@ -479,6 +544,15 @@ static int avformatInit( hb_mux_object_t * m )
             track->st->codecpar->codec_id = AV_CODEC_ID_FFV1;
             break;
 
+        case HB_VCODEC_PASSTHRU:
+            track->st->codecpar->codec_id = job->title->video_codec_param;
+            if (track->st->codecpar->codec_id == AV_CODEC_ID_HEVC &&
+                job->mux == HB_MUX_AV_MP4)
+            {
+                track->st->codecpar->codec_tag = MKTAG('h','v','c','1');
+            }
+            break;
+
         default:
             hb_error("muxavformat: Unknown video codec: %x", job->vcodec);
             goto error;
@@ -1193,30 +1267,16 @@ static int avformatInit( hb_mux_object_t * m )
              HB_PROJECT_VERSION, HB_PROJECT_BUILD);
     av_dict_set(&m->oc->metadata, "encoding_tool", tool_string, 0);
 
-    ret = avformat_write_header(m->oc, &av_opts);
-    if( ret < 0 )
-    {
-        hb_error( "muxavformat: avformat_write_header failed!");
-        goto error;
-    }
-
-    AVDictionaryEntry *t = NULL;
-    while( ( t = av_dict_get( av_opts, "", t, AV_DICT_IGNORE_SUFFIX ) ) )
-    {
-        hb_log( "muxavformat: Unknown option %s", t->key );
-    }
-    av_dict_free( &av_opts );
+    m->av_opts = av_opts;
+    av_opts = NULL;
 
-    for (ii = 0; ii < m->ntracks; ii++)
+    // Passthru video demuxed by HandBrake gets its extradata from the
+    // first packets, the header is written along with the first packet.
+    if (job->vcodec != HB_VCODEC_PASSTHRU || job->extradata != NULL)
     {
-        if (m->tracks[ii]->oc != NULL)
+        if (write_header(m) < 0)
         {
-            ret = avformat_write_header(m->tracks[ii]->oc, NULL);
-            if( ret < 0 )
-            {
-                hb_error( "muxavformat: avformat_write_header external track failed!");
-                goto error;
-            }
+            goto error;
         }
     }
 
@@ -1234,6 +1294,7 @@ error:
         }
     }
     av_dict_free(&av_opts);
+    av_dict_free(&m->av_opts);
     free(job->mux_data);
     job->mux_data = NULL;
     avformat_free_context(m->oc);
@@ -1287,6 +1348,13 @@ static int avformatMux(hb_mux_object_t *m, hb_mux_data_t *track, hb_buffer_t *bu
     uint8_t         * sub_out = NULL;
     AVFormatContext * oc;
 
+    if (write_header(m) < 0)
+    {
+        *job->done_error = HB_ERROR_INIT;
+        *job->die = 1;
+        return -1;
+    }
+
     oc = track->oc != NULL ? track->oc : m->oc;
     if (track->type == MUX_TYPE_VIDEO && (job->mux & HB_MUX_MASK_MP4))
     {
@@ -1629,7 +1697,11 @@ static int avformatEnd(hb_mux_object_t *m)
         }
     }
 
-    av_write_trailer(m->oc);
+    if (m->header_written)
+    {
+        av_write_trailer(m->oc);
+    }
+    av_dict_free(&m->av_opts);
     avio_close(m->oc->pb);
     avformat_free_context(m->oc);
     av_packet_free(&m->pkt);
@@ -1640,7 +1712,10 @@ static int avformatEnd(hb_mux_object_t *m)
     {
         if (m->tracks[ii]->oc != NULL)
         {
-            av_write_trailer(m->tracks[ii]->oc);
+            if (m->header_written)
+            {
+                av_write_trailer(m->tracks[ii]->oc);
+            }
             avio_close(m->tracks[ii]->oc->pb);
             avformat_free_context(m->tracks[ii]->oc);
             m->tracks[ii]->oc = NULL;
@@ -1659,12 +1734,41 @@ static int avformatEnd(hb_mux_object_t *m)
     return 0;
 }
 
+/**********************************************************************
+ * avformatFlush
+ **********************************************************************
+ * Writes out everything muxed so far, returns the resulting file size
+ *********************************************************************/
+static int64_t avformatFlush(hb_mux_object_t *m)
+{
+    if (m->oc == NULL || m->oc->pb == NULL || write_header(m) < 0)
+    {
+        return -1;
+    }
+
+    // Drain the interleaving queue, then close the current fragment
+    // or cluster
+    if (av_interleaved_write_frame(m->oc, NULL) < 0 ||
+        av_write_frame(m->oc, NULL) < 0)
+    {
+        return -1;
+    }
+    avio_flush(m->oc->pb);
+    if (m->oc->pb->error < 0)
+    {
+        return -1;
+    }
+
+    return avio_tell(m->oc->pb);
+}
+
 hb_mux_object_t * hb_mux_avformat_init( hb_job_t * job )
 {
     hb_mux_object_t * m = calloc( sizeof( hb_mux_object_t ), 1 );
     m->init      = avformatInit;
     m->mux       = avformatMux;
     m->end       = avformatEnd;
+    m->flush     = avformatFlush;
     m->job       = job;
     return m;
 }
@@ -10,6 +10,9 @@
 
 #define MIN_BUFFERING (1024*1024*10)
 #define MAX_BUFFERING (1024*1024*50)
+// Packets that borrow an encoder's buffers are copied once a track
+// queues more than this, so the encoder gets its buffers back
+#define MAX_BORROWED  4
 
 struct hb_mux_object_s
 {
@@ -54,6 +57,7 @@ typedef struct
     hb_bitvec_t     * allRdy;     // valid bits in rdy (audio & video tracks)
     hb_track_t     ** track;      // tracks to mux 'max_tracks' elements
     int               buffered_size;
+    hb_checkpoint_t * checkpoint; // resume points, NULL if disabled
 } hb_mux_t;
 
 struct hb_work_private_s
@@ -277,6 +281,10 @@ static void mf_push( hb_mux_t * mux, int tk, hb_buffer_t *buf )
     uint32_t mask = track->mf.flen - 1;
     uint32_t in = track->mf.in;
 
+    if (buf->storage_type == AVBUFFER && in - track->mf.out >= MAX_BORROWED)
+    {
+        hb_buffer_realloc(buf, buf->size);
+    }
     hb_buffer_reduce( buf, buf->size );
     if ( track->buffered_size > MAX_BUFFERING )
     {
@@ -361,10 +369,55 @@ static void OutputTrackChunk( hb_mux_t *mux, int tk, hb_mux_object_t *m )
         buf = mf_pull( mux, tk );
         track->frames += 1;
         track->bytes  += buf->size;
+        if (tk == 0 && mux->checkpoint != NULL)
+        {
+            hb_checkpoint_video(mux->checkpoint, buf);
+        }
         m->mux( m, track->mux_data, buf );
     }
 }
 
+// If the next video frame is due to become a resume point, mux
+// everything that precedes it, flush the file and commit.  A later
+// run of the job restarts from that frame.
+static void muxCheckpoint( hb_mux_t *mux )
+{
+    hb_buffer_t * buf;
+    int64_t       size;
+    double        pts;
+    int           i;
+
+    if (mux->checkpoint == NULL || mux->m == NULL)
+    {
+        return;
+    }
+    buf = mf_peek(mux->track[0]);
+    if (buf == NULL || buf->s.start >= mux->pts ||
+        !hb_checkpoint_due(mux->checkpoint, buf))
+    {
+        return;
+    }
+
+    pts = mux->pts;
+    mux->pts = buf->s.start;
+    for (i = 0; i < mux->ntracks; ++i)
+    {
+        OutputTrackChunk(mux, i, mux->m);
+    }
+    mux->pts = pts;
+
+    size = mux->m->flush(mux->m);
+    if (size < 0)
+    {
+        hb_error("mux: checkpoint failed, resuming is disabled");
+        mux->checkpoint = NULL;
+    }
+    else
+    {
+        hb_checkpoint_commit(mux->checkpoint, buf->s.start, size);
+    }
+}
+
 static int muxWork( hb_work_object_t * w, hb_buffer_t ** buf_in,
                      hb_buffer_t ** buf_out )
 {
@@ -418,6 +471,7 @@ static int muxWork( hb_work_object_t * w, hb_buffer_t ** buf_in,
            (hb_bitvec_cmp(mux->eof, mux->allEof)))
     {
         hb_bitvec_zero(more);
+        muxCheckpoint(mux);
         for ( i = 0; i < mux->ntracks; ++i )
         {
             track = mux->track[i];
@@ -481,6 +535,7 @@ static void muxFlush(hb_mux_t * mux)
     while (!done)
     {
         done = 1;
+        muxCheckpoint(mux);
         for (ii = 0; ii < mux->ntracks; ii++)
         {
             OutputTrackChunk(mux, ii, mux->m);
@@ -539,6 +594,14 @@ static void muxClose( hb_work_object_t * muxer )
     {
         mux->m->end( mux->m );
         free( mux->m );
+
+        // An encode that did not complete keeps its parts for resuming
+        if (mux->checkpoint != NULL && !*job->die &&
+            *job->done_error == HB_ERROR_NONE &&
+            hb_checkpoint_join(job) < 0)
+        {
+            *job->done_error = HB_ERROR_UNKNOWN;
+        }
     }
 
     // we're all done muxing -- print final stats and cleanup.
@@ -642,6 +705,7 @@ static int muxInit( hb_work_object_t * muxer, hb_job_t * job )
     pv->mux = mux;
     pv->job = job;
     pv->track = mux->ntracks;
+    mux->checkpoint = job->checkpoint_state;
 
     /* Get a real muxer */
     if( job->pass_id == HB_PASS_ENCODE || job->pass_id == HB_PASS_ENCODE_FINAL )
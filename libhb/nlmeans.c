@@ -247,7 +247,10 @@ static int nlmeans_init(hb_filter_object_t *filter,
             pv->nlmeans_deborder      = nlmeans_deborder_8;
             pv->nlmeans_plane         = nlmeans_plane_8;
         #if defined(ARCH_X86)
-            nlmeans_init_x86(functions);
+            if (!hb_get_reference_kernels())
+            {
+                nlmeans_init_x86(functions);
+            }
         #endif
             break;
 
@@ -359,7 +362,7 @@ static int nlmeans_init(hb_filter_object_t *filter,
 
     // Threads
     if (pv->threads < 1) {
-        pv->threads = hb_get_cpu_count();
+        pv->threads = hb_get_thread_count();
 
         // Reduce internal thread count where we have many logical cores
         // Too many threads increases CPU cache pressure, reducing performance
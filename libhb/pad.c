@@ -32,26 +32,11 @@ hb_filter_object_t hb_filter_pad =
     .settings_template = pad_template,
 };
 
-/* Pad presets and tunes
- *
- * There are currently no presets and tunes for pad
- * The custom pad string is converted to an avformat filter graph string
- */
-static int pad_init(hb_filter_object_t * filter, hb_filter_init_t * init)
+static void pad_get_settings(hb_dict_t * settings, const hb_geometry_t * geo,
+                             int * out_width, int * out_height,
+                             int * out_x, int * out_y, int * out_rgb)
 {
-    hb_filter_private_t * pv = NULL;
-
-    pv = calloc(1, sizeof(struct hb_filter_private_s));
-    filter->private_data = pv;
-    if (pv == NULL)
-    {
-        return 1;
-    }
-    pv->input = *init;
-
-    hb_dict_t        * settings = filter->settings;
-
-    int      width  = -1, height = -1, rgb = 0;
+    int      width  = -1, height = -1, rgb = -1;
     int      top = -1, bottom = -1, left = -1, right = -1;
     int      x = -1, y = -1;
     char  *  color = NULL;
@@ -77,11 +62,11 @@ static int pad_init(hb_filter_object_t * filter, hb_filter_init_t * init)
     }
     if (top >= 0 && bottom >= 0 && height < 0)
     {
-        height = init->geometry.height + top + bottom;
+        height = geo->height + top + bottom;
     }
     if (left >= 0 && right >= 0 && width < 0)
     {
-        width = init->geometry.width + left + right;
+        width = geo->width + left + right;
     }
     if (color != NULL)
     {
@@ -93,11 +78,47 @@ static int pad_init(hb_filter_object_t * filter, hb_filter_init_t * init)
             rgb = hb_rgb_lookup_by_name(color);
         }
         free(color);
-        color = hb_strdup_printf("0x%06x", rgb);
+    }
+    if (width < geo->width)
+    {
+        width = geo->width;
+    }
+    if (height < geo->height)
+    {
+        height = geo->height;
     }
 
-    char x_str[20];
-    char y_str[20];
+    *out_width  = width;
+    *out_height = height;
+    *out_x      = x;
+    *out_y      = y;
+    *out_rgb    = rgb;
+}
+
+/* Pad presets and tunes
+ *
+ * There are currently no presets and tunes for pad
+ * The custom pad string is converted to an avformat filter graph string
+ */
+static int pad_init(hb_filter_object_t * filter, hb_filter_init_t * init)
+{
+    hb_filter_private_t * pv = NULL;
+
+    pv = calloc(1, sizeof(struct hb_filter_private_s));
+    filter->private_data = pv;
+    if (pv == NULL)
+    {
+        return 1;
+    }
+    pv->input = *init;
+
+    int      width, height, x, y, rgb;
+    char     x_str[20];
+    char     y_str[20];
+
+    pad_get_settings(filter->settings, &init->geometry,
+                     &width, &height, &x, &y, &rgb);
+
     if (x < 0)
     {
         snprintf(x_str, 20, "(out_w-in_w)/2");
@@ -114,14 +135,6 @@ static int pad_init(hb_filter_object_t * filter, hb_filter_init_t * init)
     {
         snprintf(y_str, 20, "%d", y);
     }
-    if (width < init->geometry.width)
-    {
-        width = init->geometry.width;
-    }
-    if (height < init->geometry.height)
-    {
-        height = init->geometry.height;
-    }
 
     hb_dict_t * avfilter = hb_dict_init();
     hb_dict_t * avsettings = hb_dict_init();
@@ -130,8 +143,9 @@ static int pad_init(hb_filter_object_t * filter, hb_filter_init_t * init)
     hb_dict_set(avsettings, "height", hb_value_int(height));
     hb_dict_set(avsettings, "x", hb_value_string(x_str));
     hb_dict_set(avsettings, "y", hb_value_string(y_str));
-    if (color != NULL)
+    if (rgb >= 0)
     {
+        char * color = hb_strdup_printf("0x%06x", rgb);
         hb_dict_set(avsettings, "color", hb_value_string(color));
         free(color);
     }
@@ -145,3 +159,19 @@ static int pad_init(hb_filter_object_t * filter, hb_filter_init_t * init)
     return 0;
 }
 
+// Returns the padded frame size, the position of the input picture
+// within it and the fill color.  x and y are -1 when the picture is
+// centered.  rgb is -1 when no color was specified (black).
+int hb_pad_get_region(hb_filter_object_t * filter,
+                      int * width, int * height, int * x, int * y, int * rgb)
+{
+    hb_filter_private_t * pv = filter->private_data;
+
+    if (filter->id != HB_FILTER_PAD || pv == NULL)
+    {
+        return -1;
+    }
+    pad_get_settings(filter->settings, &pv->input.geometry,
+                     width, height, x, y, rgb);
+    return 0;
+}
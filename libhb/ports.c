@@ -16,6 +16,8 @@
 #ifdef SYS_LINUX
 #define _GNU_SOURCE
 #include <sched.h>
+#include <errno.h>
+#include <sys/syscall.h>
 #endif
 #include <pthread.h>
 
@@ -50,6 +52,7 @@
 #include <mbctype.h>
 #include <locale.h>
 #include <shlobj.h>
+#include <io.h>
 #endif
 
 #ifdef SYS_SunOS
@@ -287,6 +290,7 @@ struct
         uint32_t buf4[12];
     };
     int count;
+    hb_cpu_topology_t topology;
 } hb_cpu_info;
 
 int hb_get_cpu_count()
@@ -295,6 +299,23 @@ int hb_get_cpu_count()
     return hb_cpu_info.count;
 }
 
+/*
+ * Thread count for a thread pool that would otherwise use one thread
+ * per cpu.  Each filter, decoder and encoder starts its own pool, so on
+ * hosts with hundreds of cpus an uncapped count multiplies into
+ * thousands of threads.
+ */
+int hb_get_thread_count()
+{
+    return MIN(hb_get_cpu_count(), HB_THREAD_POOL_MAX);
+}
+
+void hb_get_cpu_topology(hb_cpu_topology_t *topology)
+{
+    init_cpu_info();
+    *topology = hb_cpu_info.topology;
+}
+
 int hb_get_cpu_platform()
 {
     init_cpu_info();
@@ -504,24 +525,252 @@ static void init_cpu_info()
     }
 }
 
+#if defined(SYS_LINUX)
+static int read_sysfs_int(const char *fmt, int cpu, int *value)
+{
+    char path[128];
+    FILE *file;
+    int ret;
+
+    snprintf(path, sizeof(path), fmt, cpu);
+    file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    ret = fscanf(file, "%d", value) == 1 ? 0 : -1;
+    fclose(file);
+    return ret;
+}
+
+/*
+ * Returns the cpu quota of the first cgroup (v2 unified, or v1 cpu
+ * controller) on the way from ours up to the root that has one,
+ * rounded up to whole cpus. Returns 0 when there is no quota.
+ */
+static int cgroup_cpu_quota()
+{
+    char line[4096], path[4096 + 64];
+    char *cgroup_v1 = NULL, *cgroup_v2 = NULL;
+    FILE *file;
+    int quota = 0;
+
+    file = fopen("/proc/self/cgroup", "r");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        // hierarchy-ID:controller-list:cgroup-path
+        char *controllers = strchr(line, ':');
+        char *cgroup      = controllers ? strchr(controllers + 1, ':') : NULL;
+        if (cgroup == NULL)
+        {
+            continue;
+        }
+        *cgroup++ = 0;
+        controllers++;
+        cgroup[strcspn(cgroup, "\n")] = 0;
+
+        if (!strcmp(line, "0") && *controllers == 0)
+        {
+            free(cgroup_v2);
+            cgroup_v2 = strdup(cgroup);
+        }
+        else
+        {
+            char *tok, *save = NULL;
+            for (tok = strtok_r(controllers, ",", &save); tok != NULL;
+                 tok = strtok_r(NULL, ",", &save))
+            {
+                if (!strcmp(tok, "cpu"))
+                {
+                    free(cgroup_v1);
+                    cgroup_v1 = strdup(cgroup);
+                }
+            }
+        }
+    }
+    fclose(file);
+
+    for (char *cgroup = cgroup_v1 ? cgroup_v1 : cgroup_v2;
+         cgroup != NULL && quota == 0;)
+    {
+        long long max = -1, period = 0;
+
+        if (cgroup == cgroup_v1)
+        {
+            const char *mounts[] = { "cpu,cpuacct", "cpu", NULL };
+            for (int ii = 0; mounts[ii] != NULL && max < 0; ii++)
+            {
+                snprintf(path, sizeof(path),
+                         "/sys/fs/cgroup/%s%s/cpu.cfs_quota_us",
+                         mounts[ii], cgroup);
+                file = fopen(path, "r");
+                if (file == NULL)
+                {
+                    continue;
+                }
+                if (fscanf(file, "%lld", &max) != 1)
+                {
+                    max = -1;
+                }
+                fclose(file);
+                snprintf(path, sizeof(path),
+                         "/sys/fs/cgroup/%s%s/cpu.cfs_period_us",
+                         mounts[ii], cgroup);
+                file = fopen(path, "r");
+                if (file != NULL)
+                {
+                    if (fscanf(file, "%lld", &period) != 1)
+                    {
+                        period = 0;
+                    }
+                    fclose(file);
+                }
+            }
+        }
+        else
+        {
+            snprintf(path, sizeof(path), "/sys/fs/cgroup%s/cpu.max", cgroup);
+            file = fopen(path, "r");
+            if (file != NULL)
+            {
+                // "max 100000" when unlimited
+                if (fscanf(file, "%lld %lld", &max, &period) != 2)
+                {
+                    max = -1;
+                }
+                fclose(file);
+            }
+        }
+        if (max > 0 && period > 0)
+        {
+            quota = (max + period - 1) / period;
+        }
+
+        // Inside a cgroup namespace the limit may sit on an ancestor
+        char *slash = strrchr(cgroup, '/');
+        if (slash == NULL || slash[1] == 0)
+        {
+            break;
+        }
+        if (slash == cgroup)
+        {
+            slash[1] = 0;
+        }
+        else
+        {
+            *slash = 0;
+        }
+    }
+    free(cgroup_v1);
+    free(cgroup_v2);
+
+    return quota;
+}
+
 /*
- * Whenever possible, returns the number of CPUs on the current computer.
+ * Counts the cpus in our affinity mask, however many the kernel
+ * supports, and the physical cores and packages they belong to.
+ */
+static void init_cpu_topology_linux(hb_cpu_topology_t *topology)
+{
+    cpu_set_t *mask = NULL;
+    size_t     size = 0;
+    int        ncpus;
+
+    for (ncpus = CPU_SETSIZE; ncpus <= 1 << 20; ncpus *= 2)
+    {
+        mask = CPU_ALLOC(ncpus);
+        if (mask == NULL)
+        {
+            return;
+        }
+        size = CPU_ALLOC_SIZE(ncpus);
+        CPU_ZERO_S(size, mask);
+        if (sched_getaffinity(0, size, mask) == 0)
+        {
+            break;
+        }
+        CPU_FREE(mask);
+        mask = NULL;
+        if (errno != EINVAL)
+        {
+            return;
+        }
+    }
+    if (mask == NULL)
+    {
+        return;
+    }
+
+    topology->online = CPU_COUNT_S(size, mask);
+
+    // Physical cores are unique (package, core) pairs
+    int64_t *cores = calloc(topology->online, sizeof(int64_t));
+    int      ncores = 0, packages = 0;
+    for (int cpu = 0; cores != NULL && cpu < ncpus; cpu++)
+    {
+        int package, core, ii;
+
+        if (!CPU_ISSET_S(cpu, size, mask))
+        {
+            continue;
+        }
+        if (read_sysfs_int("/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+                           cpu, &package) ||
+            read_sysfs_int("/sys/devices/system/cpu/cpu%d/topology/core_id",
+                           cpu, &core))
+        {
+            ncores = 0;
+            break;
+        }
+        int64_t key = ((int64_t)package << 32) | (uint32_t)core;
+        for (ii = 0; ii < ncores && cores[ii] != key; ii++);
+        if (ii == ncores)
+        {
+            cores[ncores++] = key;
+            for (ii = 0; ii < ncores - 1 && (cores[ii] >> 32) != package; ii++);
+            if (ii == ncores - 1)
+            {
+                packages++;
+            }
+        }
+    }
+    free(cores);
+    CPU_FREE(mask);
+
+    if (ncores > 0)
+    {
+        topology->physical = ncores;
+        topology->packages = packages;
+    }
+    topology->quota = cgroup_cpu_quota();
+}
+#endif
+
+/*
+ * Whenever possible, returns the number of CPUs on the current computer
+ * this process is allowed to use, and fills in hb_cpu_info.topology.
  * Returns 1 otherwise.
  */
 static int init_cpu_count()
 {
     int cpu_count = 1;
+    hb_cpu_topology_t *topology = &hb_cpu_info.topology;
 
 #if defined(SYS_CYGWIN) || defined(SYS_MINGW)
     cpu_count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
 
 #elif defined(SYS_LINUX)
-    unsigned int bit;
-    cpu_set_t p_aff;
-    memset( &p_aff, 0, sizeof(p_aff) );
-    sched_getaffinity( 0, sizeof(p_aff), &p_aff );
-    for( cpu_count = 0, bit = 0; bit < sizeof(p_aff); bit++ )
-         cpu_count += (((uint8_t *)&p_aff)[bit / 8] >> (bit % 8)) & 1;
+    init_cpu_topology_linux(topology);
+    cpu_count = topology->online;
+    if (topology->quota > 0)
+    {
+        cpu_count = MIN(cpu_count, topology->quota);
+    }
 
 #elif defined(SYS_DARWIN) || defined(SYS_FREEBSD) || defined(SYS_NETBSD) || defined(SYS_OPENBSD)
     size_t length = sizeof( cpu_count );
@@ -558,7 +807,20 @@ static int init_cpu_count()
 #endif
 
     cpu_count = MAX( 1, cpu_count );
-    cpu_count = MIN( cpu_count, 64 );
+
+    topology->logical = cpu_count;
+    if (topology->online <= 0)
+    {
+        topology->online = cpu_count;
+    }
+    if (topology->physical <= 0)
+    {
+        topology->physical = topology->online;
+    }
+    if (topology->packages <= 0)
+    {
+        topology->packages = 1;
+    }
 
     return cpu_count;
 }
@@ -846,6 +1108,66 @@ FILE * hb_fopen(const char *path, const char *mode)
 #endif
 }
 
+/************************************************************************
+ * hb_unlink, hb_rename
+ ************************************************************************
+ * Wrappers to the real unlink and rename, needed to handle utf8
+ * filenames on windows.  hb_rename replaces an existing destination.
+ ***********************************************************************/
+int hb_unlink(const char *path)
+{
+#ifdef SYS_MINGW
+    wchar_t path_utf16[MAX_PATH];
+    if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, path_utf16, MAX_PATH))
+        return -1;
+    return _wunlink(path_utf16);
+#else
+    return unlink(path);
+#endif
+}
+
+int hb_rename(const char *src, const char *dst)
+{
+#ifdef SYS_MINGW
+    wchar_t src_utf16[MAX_PATH];
+    wchar_t dst_utf16[MAX_PATH];
+    if (!MultiByteToWideChar(CP_UTF8, 0, src, -1, src_utf16, MAX_PATH))
+        return -1;
+    if (!MultiByteToWideChar(CP_UTF8, 0, dst, -1, dst_utf16, MAX_PATH))
+        return -1;
+    return MoveFileExW(src_utf16, dst_utf16, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(src, dst);
+#endif
+}
+
+/************************************************************************
+ * hb_fsync, hb_ftruncate
+ ************************************************************************
+ * Flush a stream all the way to the disk, and cut a file to 'size'.
+ ***********************************************************************/
+int hb_fsync(FILE *f)
+{
+    if (fflush(f))
+        return -1;
+#ifdef SYS_MINGW
+    return _commit(_fileno(f));
+#else
+    return fsync(fileno(f));
+#endif
+}
+
+int hb_ftruncate(FILE *f, int64_t size)
+{
+    if (fflush(f))
+        return -1;
+#ifdef SYS_MINGW
+    return _chsize_s(_fileno(f), size) ? -1 : 0;
+#else
+    return ftruncate(fileno(f), size);
+#endif
+}
+
 HB_DIR* hb_opendir(const char *path)
 {
 #ifdef SYS_MINGW
@@ -956,6 +1278,52 @@ struct hb_thread_s
     pthread_t       thread;
 };
 
+static int hb_thread_policy = HB_THREAD_POLICY_NORMAL;
+
+/************************************************************************
+ * hb_thread_set_policy()
+ ************************************************************************
+ * Run threads started afterwards with HB_LOW_PRIORITY under the given
+ * HB_THREAD_POLICY_* scheduling class and a matching I/O priority.
+ * Threads they create, e.g. encoder thread pools, inherit both.
+ ***********************************************************************/
+void hb_thread_set_policy( int policy )
+{
+    hb_thread_policy = policy;
+}
+
+#if defined( SYS_LINUX )
+#define IOPRIO_CLASS_SHIFT          13
+#define IOPRIO_CLASS_BE             2
+#define IOPRIO_CLASS_IDLE           3
+#define IOPRIO_WHO_PROCESS          1
+#define IOPRIO_PRIO_VALUE(class, data) (((class) << IOPRIO_CLASS_SHIFT) | (data))
+
+static void hb_thread_apply_policy( hb_thread_t * t )
+{
+    struct sched_param param;
+    int idle = hb_thread_policy == HB_THREAD_POLICY_IDLE;
+
+    memset( &param, 0, sizeof( struct sched_param ) );
+    if( pthread_setschedparam( pthread_self(),
+                               idle ? SCHED_IDLE : SCHED_BATCH, &param ) )
+    {
+        hb_deep_log( 2, "thread \"%s\": failed to set scheduling policy",
+                     t->name );
+    }
+#ifdef SYS_ioprio_set
+    // I/O priorities are per thread, 0 is the calling thread
+    if( syscall( SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                 idle ? IOPRIO_PRIO_VALUE( IOPRIO_CLASS_IDLE, 0 ) :
+                        IOPRIO_PRIO_VALUE( IOPRIO_CLASS_BE, 7 ) ) < 0 )
+    {
+        hb_deep_log( 2, "thread \"%s\": failed to set I/O priority",
+                     t->name );
+    }
+#endif
+}
+#endif
+
 /* Get a unique identifier to thread and represent as 64-bit unsigned.
  * If unsupported, the value 0 is be returned.
  * Caller should use result only for display/log purposes.
@@ -981,7 +1349,7 @@ static uint64_t hb_thread_to_integer( const hb_thread_t* t )
  * hb_thread_func()
  ************************************************************************
  * We use it as the root routine for any thread, for two reasons:
- *  + To set the thread priority on macOS (pthread_setschedparam() could
+ *  + To set the thread name and priority (pthread_setschedparam() could
  *    be called from hb_thread_init(), but it's nicer to do it as we
  *    are sure it is done before the real routine starts)
  *  + Get informed when the thread exits, so we know whether
@@ -1003,6 +1371,17 @@ static void attribute_align_thread hb_thread_func( void * _t )
 
 #if defined( SYS_DARWIN )
     pthread_setname_np( t->name );
+#elif defined( SYS_LINUX )
+    /* Linux limits thread names to 15 characters */
+    char name[16];
+    snprintf( name, sizeof( name ), "%s", t->name );
+    pthread_setname_np( pthread_self(), name );
+
+    if( t->priority == HB_LOW_PRIORITY &&
+        hb_thread_policy != HB_THREAD_POLICY_NORMAL )
+    {
+        hb_thread_apply_policy( t );
+    }
 #endif
 
     /* Start the actual routine */
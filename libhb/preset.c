@@ -860,6 +860,11 @@ static void add_audio_for_lang(hb_value_array_t *list, const hb_dict_t *preset,
                     hb_dict_set(audio_dict, "Gain", hb_value_dup(
                         hb_dict_get(encoder_dict, "AudioTrackGainSlider")));
                 }
+                if (hb_dict_get(encoder_dict, "AudioTrackLoudnessTarget") != NULL)
+                {
+                    hb_dict_set(audio_dict, "LoudnessTarget", hb_value_dup(
+                        hb_dict_get(encoder_dict, "AudioTrackLoudnessTarget")));
+                }
                 if (hb_dict_get(encoder_dict, "AudioTrackDRCSlider") != NULL)
                 {
                     hb_dict_set(audio_dict, "DRC", hb_value_dup(
@@ -2355,6 +2360,12 @@ int hb_preset_apply_dimensions(hb_handle_t *h, int title_index,
     hb_dict_set(scale_settings, "crop-bottom", hb_value_int(geo.crop[1]));
     hb_dict_set(scale_settings, "crop-left", hb_value_int(geo.crop[2]));
     hb_dict_set(scale_settings, "crop-right", hb_value_int(geo.crop[3]));
+    // "fast" trades lanczos for a box filter on exact 2:1 and 4:1 downscales
+    const char *scaler = hb_dict_get_string(preset, "VideoScaler");
+    if (scaler != NULL && !strcasecmp(scaler, "fast"))
+    {
+        hb_dict_set(scale_settings, "fast-downscale", hb_value_bool(1));
+    }
     if (hb_validate_filter_settings(HB_FILTER_CROP_SCALE, scale_settings))
     {
         hb_error("hb_preset_apply_dimensions: Internal error, invalid CROP_SCALE");
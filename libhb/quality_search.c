@@ -0,0 +1,490 @@
+/* quality_search.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/* Constant quality search.
+ *
+ * A job with quality_target set encodes a few short segments, starting
+ * at the scan's preview seek points, at candidate quality values before
+ * the real encode.  These sample encodes end in two work objects in
+ * place of the muxer:
+ *
+ *   filters -> Quality reference -> encoder -> Quality measure
+ *                      |                             ^
+ *                      +--- job->fifo_quality_ref ---+
+ *
+ * The reference object keeps a copy of every frame the encoder gets.
+ * The measure object decodes the encoded frames and compares each one
+ * with the copy that has the same time stamp.  The score of the sample
+ * (mean luma SSIM, or PSNR of the luma mean squared error) is left in
+ * job->quality_score for the search in work.c.
+ */
+
+#include "handbrake/handbrake.h"
+#include "handbrake/hbffmpeg.h"
+
+#define QUALITY_PSNR_MAX 100.
+
+struct hb_work_private_s
+{
+    hb_job_t       * job;
+
+    AVCodecContext * context;
+    AVPacket       * pkt;
+    AVFrame        * frame;
+    int64_t        * sums;
+
+    int              frames;
+    int              unmatched;
+    double           ssim;
+    double           sse;
+    uint64_t         pixels;
+    double           peak;
+};
+
+/***********************************************************************
+ * Quality reference
+ **********************************************************************/
+static int qualityRefInit(hb_work_object_t *w, hb_job_t *job)
+{
+    hb_work_private_t *pv = calloc(1, sizeof(hb_work_private_t));
+
+    if (pv == NULL)
+    {
+        return 1;
+    }
+    pv->job = job;
+    w->private_data = pv;
+
+    return 0;
+}
+
+static void qualityRefClose(hb_work_object_t *w)
+{
+    // The encoder input fifo is created by work.c for this object
+    hb_fifo_close(&w->fifo_out);
+    free(w->private_data);
+    w->private_data = NULL;
+}
+
+static int qualityRefWork(hb_work_object_t *w, hb_buffer_t **buf_in,
+                          hb_buffer_t **buf_out)
+{
+    hb_work_private_t *pv = w->private_data;
+    hb_buffer_t       *in = *buf_in;
+
+    *buf_out = in;
+    *buf_in  = NULL;
+
+    if (in->s.flags & HB_BUF_FLAG_EOF)
+    {
+        return HB_WORK_DONE;
+    }
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(in->f.fmt);
+    if (desc == NULL || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL))
+    {
+        hb_error("quality search: hardware frames are not supported");
+        *pv->job->done_error = HB_ERROR_UNKNOWN;
+        *pv->job->die = 1;
+        return HB_WORK_DONE;
+    }
+    hb_fifo_push(pv->job->fifo_quality_ref, hb_buffer_dup(in));
+
+    return HB_WORK_OK;
+}
+
+hb_work_object_t hb_quality_reference =
+{
+    WORK_QUALITY_REFERENCE,
+    "Quality reference",
+    qualityRefInit,
+    qualityRefWork,
+    qualityRefClose
+};
+
+/***********************************************************************
+ * Quality measure
+ **********************************************************************/
+static enum AVCodecID quality_codec_id(int vcodec)
+{
+    if (vcodec & HB_VCODEC_H264_MASK)
+    {
+        return AV_CODEC_ID_H264;
+    }
+    if (vcodec & HB_VCODEC_H265_MASK)
+    {
+        return AV_CODEC_ID_HEVC;
+    }
+    if (vcodec & HB_VCODEC_AV1_MASK)
+    {
+        return AV_CODEC_ID_AV1;
+    }
+    switch (vcodec)
+    {
+        case HB_VCODEC_FFMPEG_MPEG4:
+            return AV_CODEC_ID_MPEG4;
+        case HB_VCODEC_FFMPEG_MPEG2:
+            return AV_CODEC_ID_MPEG2VIDEO;
+        case HB_VCODEC_FFMPEG_VP8:
+            return AV_CODEC_ID_VP8;
+        case HB_VCODEC_FFMPEG_VP9:
+        case HB_VCODEC_FFMPEG_VP9_10BIT:
+            return AV_CODEC_ID_VP9;
+        case HB_VCODEC_THEORA:
+            return AV_CODEC_ID_THEORA;
+        case HB_VCODEC_FFMPEG_FFV1:
+            return AV_CODEC_ID_FFV1;
+        default:
+            return AV_CODEC_ID_NONE;
+    }
+}
+
+static int qualityMeasureInit(hb_work_object_t *w, hb_job_t *job)
+{
+    hb_work_private_t *pv = calloc(1, sizeof(hb_work_private_t));
+
+    if (pv == NULL)
+    {
+        return 1;
+    }
+    w->private_data = pv;
+
+    pv->job   = job;
+    pv->pkt   = av_packet_alloc();
+    pv->frame = av_frame_alloc();
+    // Two rows of 4x4 block sums for SSIM
+    pv->sums  = calloc(2 * (job->width / 4 + 1) * 4, sizeof(int64_t));
+    if (pv->pkt == NULL || pv->frame == NULL || pv->sums == NULL)
+    {
+        hb_error("quality search: out of memory");
+        return 1;
+    }
+    if (quality_codec_id(job->vcodec) == AV_CODEC_ID_NONE)
+    {
+        hb_error("quality search: unsupported video encoder %x", job->vcodec);
+        return 1;
+    }
+    job->quality_score = 0.;
+
+    return 0;
+}
+
+// The decoder can only be opened once the encoder has produced
+// its extradata, which some encoders do with their first frame
+static int open_decoder(hb_work_private_t *pv)
+{
+    hb_job_t       *job   = pv->job;
+    const AVCodec  *codec = avcodec_find_decoder(quality_codec_id(job->vcodec));
+
+    if (codec == NULL)
+    {
+        hb_error("quality search: no decoder for video encoder %x",
+                 job->vcodec);
+        return -1;
+    }
+    pv->context = avcodec_alloc_context3(codec);
+    if (pv->context == NULL)
+    {
+        return -1;
+    }
+    if (job->extradata != NULL && job->extradata->size > 0)
+    {
+        pv->context->extradata = av_mallocz(job->extradata->size +
+                                            AV_INPUT_BUFFER_PADDING_SIZE);
+        if (pv->context->extradata == NULL)
+        {
+            return -1;
+        }
+        memcpy(pv->context->extradata, job->extradata->bytes,
+               job->extradata->size);
+        pv->context->extradata_size = job->extradata->size;
+    }
+    pv->context->width   = job->width;
+    pv->context->height  = job->height;
+    pv->context->pix_fmt = job->output_pix_fmt;
+
+    if (hb_avcodec_open(pv->context, codec, NULL, HB_FFMPEG_THREADS_AUTO))
+    {
+        hb_error("quality search: failed to open decoder %s", codec->name);
+        return -1;
+    }
+    return 0;
+}
+
+static inline int sample(const uint8_t *row, int x, int wide)
+{
+    return wide ? ((const uint16_t *)row)[x] : row[x];
+}
+
+// Sums of a, b, a*a + b*b and a*b over each 4x4 block of a row of blocks
+static void block_sums(const uint8_t *a, int a_stride,
+                       const uint8_t *b, int b_stride,
+                       int blocks, int wide, int64_t *sums)
+{
+    for (int bx = 0; bx < blocks; bx++, sums += 4)
+    {
+        int64_t s1 = 0, s2 = 0, ss = 0, s12 = 0;
+
+        for (int y = 0; y < 4; y++)
+        {
+            const uint8_t *ra = a + y * a_stride;
+            const uint8_t *rb = b + y * b_stride;
+
+            for (int x = bx * 4; x < bx * 4 + 4; x++)
+            {
+                int64_t va = sample(ra, x, wide);
+                int64_t vb = sample(rb, x, wide);
+
+                s1  += va;
+                s2  += vb;
+                ss  += va * va + vb * vb;
+                s12 += va * vb;
+            }
+        }
+        sums[0] = s1;
+        sums[1] = s2;
+        sums[2] = ss;
+        sums[3] = s12;
+    }
+}
+
+// SSIM over 8x8 windows spaced 4 pixels apart, as in x264
+static double plane_ssim(hb_work_private_t *pv,
+                         const uint8_t *a, int a_stride,
+                         const uint8_t *b, int b_stride,
+                         int width, int height, int wide)
+{
+    const double c1 = .01 * .01 * pv->peak * pv->peak * 64;
+    const double c2 = .03 * .03 * pv->peak * pv->peak * 64 * 63;
+    const int    bw = width / 4, bh = height / 4;
+    int64_t     *sums[2];
+    double       ssim = 0.;
+    int          count = 0;
+
+    if (bw < 2 || bh < 2)
+    {
+        return 1.;
+    }
+    sums[0] = pv->sums;
+    sums[1] = pv->sums + bw * 4;
+
+    block_sums(a, a_stride, b, b_stride, bw, wide, sums[0]);
+    for (int by = 1; by < bh; by++)
+    {
+        int64_t *top = sums[(by - 1) & 1];
+        int64_t *bot = sums[by & 1];
+
+        block_sums(a + by * 4 * a_stride, a_stride,
+                   b + by * 4 * b_stride, b_stride, bw, wide, bot);
+        for (int bx = 0; bx < bw - 1; bx++)
+        {
+            double s[4];
+
+            for (int ii = 0; ii < 4; ii++)
+            {
+                s[ii] = top[bx * 4 + ii] + top[bx * 4 + 4 + ii] +
+                        bot[bx * 4 + ii] + bot[bx * 4 + 4 + ii];
+            }
+            double vars  = s[2] * 64 - s[0] * s[0] - s[1] * s[1];
+            double covar = s[3] * 64 - s[0] * s[1];
+
+            ssim += (2 * s[0] * s[1] + c1) * (2 * covar + c2) /
+                    ((s[0] * s[0] + s[1] * s[1] + c1) * (vars + c2));
+            count++;
+        }
+    }
+    return ssim / count;
+}
+
+static double plane_sse(const uint8_t *a, int a_stride,
+                        const uint8_t *b, int b_stride,
+                        int width, int height, int wide)
+{
+    double sse = 0.;
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t *ra = a + y * a_stride;
+        const uint8_t *rb = b + y * b_stride;
+        int64_t        row = 0;
+
+        for (int x = 0; x < width; x++)
+        {
+            int64_t d = sample(ra, x, wide) - sample(rb, x, wide);
+            row += d * d;
+        }
+        sse += row;
+    }
+    return sse;
+}
+
+static int measure_frame(hb_work_private_t *pv, AVFrame *frame)
+{
+    hb_fifo_t   *fifo = pv->job->fifo_quality_ref;
+    hb_buffer_t *ref;
+    int64_t      pts  = frame->best_effort_timestamp;
+
+    // Drop references of frames the encoder did not output
+    while ((ref = hb_fifo_see(fifo)) != NULL && ref->s.start < pts)
+    {
+        ref = hb_fifo_get(fifo);
+        hb_buffer_close(&ref);
+        pv->unmatched++;
+    }
+    if (ref == NULL || ref->s.start != pts)
+    {
+        pv->unmatched++;
+        return 0;
+    }
+    ref = hb_fifo_get(fifo);
+
+    if (frame->format != ref->f.fmt ||
+        frame->width  != ref->plane[0].width ||
+        frame->height != ref->plane[0].height)
+    {
+        hb_error("quality search: decoded frame %dx%d %s does not match %dx%d %s",
+                 frame->width, frame->height,
+                 av_get_pix_fmt_name(frame->format),
+                 ref->plane[0].width, ref->plane[0].height,
+                 av_get_pix_fmt_name(ref->f.fmt));
+        hb_buffer_close(&ref);
+        return -1;
+    }
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int wide = desc->comp[0].depth > 8;
+
+    pv->peak = (1 << desc->comp[0].depth) - 1;
+    pv->ssim += plane_ssim(pv, ref->plane[0].data, ref->plane[0].stride,
+                           frame->data[0], frame->linesize[0],
+                           frame->width, frame->height, wide);
+    pv->sse  += plane_sse(ref->plane[0].data, ref->plane[0].stride,
+                          frame->data[0], frame->linesize[0],
+                          frame->width, frame->height, wide);
+    pv->pixels += frame->width * frame->height;
+    pv->frames++;
+
+    hb_buffer_close(&ref);
+    return 0;
+}
+
+static int decode(hb_work_private_t *pv, AVPacket *pkt)
+{
+    int ret = avcodec_send_packet(pv->context, pkt);
+
+    if (ret < 0 && ret != AVERROR_EOF)
+    {
+        hb_log("quality search: decode error %d", ret);
+        return 0;
+    }
+    while ((ret = avcodec_receive_frame(pv->context, pv->frame)) >= 0)
+    {
+        ret = measure_frame(pv, pv->frame);
+        av_frame_unref(pv->frame);
+        if (ret < 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static double score(hb_work_private_t *pv)
+{
+    if (pv->frames == 0)
+    {
+        return 0.;
+    }
+    if (pv->job->quality_metric == HB_QUALITY_METRIC_PSNR)
+    {
+        if (pv->sse <= 0.)
+        {
+            return QUALITY_PSNR_MAX;
+        }
+        return MIN(10. * log10(pv->peak * pv->peak * pv->pixels / pv->sse),
+                   QUALITY_PSNR_MAX);
+    }
+    return pv->ssim / pv->frames;
+}
+
+static int qualityMeasureWork(hb_work_object_t *w, hb_buffer_t **buf_in,
+                              hb_buffer_t **buf_out)
+{
+    hb_work_private_t *pv = w->private_data;
+    hb_buffer_t       *in = *buf_in;
+
+    *buf_out = NULL;
+
+    if (pv->context == NULL && !(in->s.flags & HB_BUF_FLAG_EOF))
+    {
+        if (open_decoder(pv))
+        {
+            *pv->job->done_error = HB_ERROR_UNKNOWN;
+            *pv->job->die = 1;
+            return HB_WORK_DONE;
+        }
+    }
+
+    if (in->s.flags & HB_BUF_FLAG_EOF)
+    {
+        if (pv->context != NULL && decode(pv, NULL) < 0)
+        {
+            *pv->job->done_error = HB_ERROR_UNKNOWN;
+            *pv->job->die = 1;
+        }
+        pv->job->quality_score = score(pv);
+        return HB_WORK_DONE;
+    }
+
+    pv->pkt->data  = in->data;
+    pv->pkt->size  = in->size;
+    pv->pkt->pts   = in->s.start;
+    pv->pkt->dts   = in->s.renderOffset;
+    pv->pkt->flags = (in->s.flags & HB_FLAG_FRAMETYPE_KEY) ?
+                     AV_PKT_FLAG_KEY : 0;
+    if (decode(pv, pv->pkt) < 0)
+    {
+        *pv->job->done_error = HB_ERROR_UNKNOWN;
+        *pv->job->die = 1;
+        return HB_WORK_DONE;
+    }
+    return HB_WORK_OK;
+}
+
+static void qualityMeasureClose(hb_work_object_t *w)
+{
+    hb_work_private_t *pv = w->private_data;
+
+    if (pv == NULL)
+    {
+        return;
+    }
+    if (pv->frames > 0)
+    {
+        hb_log("quality search: %d frames, %s %.4f%s", pv->frames,
+               pv->job->quality_metric == HB_QUALITY_METRIC_PSNR ?
+                   "PSNR" : "SSIM", score(pv),
+               pv->unmatched ? " (some frames unmatched)" : "");
+    }
+    hb_avcodec_free_context(&pv->context);
+    av_packet_free(&pv->pkt);
+    av_frame_free(&pv->frame);
+    free(pv->sums);
+    free(pv);
+    w->private_data = NULL;
+}
+
+hb_work_object_t hb_quality_measure =
+{
+    WORK_QUALITY_MEASURE,
+    "Quality measure",
+    qualityMeasureInit,
+    qualityMeasureWork,
+    qualityMeasureClose
+};
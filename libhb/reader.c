@@ -149,9 +149,22 @@ static int hb_reader_open( hb_work_private_t * r )
                         (r->job->seek_points ? (r->job->seek_points + 1.0)
                                              : 11.0));
         }
-        // libdvdnav doesn't have a seek to timestamp function.
-        // So we will have to decode frames until we find the correct time
-        // in sync.c
+        else if (r->job->pts_to_start)
+        {
+            // DVD seeks land on the VOBU at or before the requested time.
+            // sync.c decodes from there to the correct time.
+            int64_t chapter_pts = chapter_end_pts(r->job->title,
+                                                  r->job->chapter_start - 1);
+            int64_t pts = hb_dvd_seek_pts(r->dvd, chapter_pts +
+                                                  r->job->pts_to_start);
+            if (pts >= 0)
+            {
+                r->job->reader_pts_offset = pts - chapter_pts;
+                r->duration -= r->job->reader_pts_offset;
+            }
+        }
+        // If the seek was not possible, we will have to decode frames
+        // until we find the correct time in sync.c
         r->start_found = 1;
     }
     else if (r->title->type == HB_STREAM_TYPE ||
@@ -166,7 +179,8 @@ static int hb_reader_open( hb_work_private_t * r )
                          (r->job->seek_points ? (r->job->seek_points + 1.0)
                                               : 11.0);
             int64_t start = r->title->duration * frac;
-            if (hb_stream_seek_ts(r->stream, start) >= 0)
+            if (r->title->type == HB_FF_STREAM_TYPE &&
+                hb_stream_seek_ts(r->stream, start) >= 0)
             {
                 // If successful, we know the video stream has been seeked
                 // to the right location. But libav does not seek all
@@ -179,9 +193,9 @@ static int hb_reader_open( hb_work_private_t * r )
             }
             else
             {
-                // hb_stream_seek_ts only works for libav streams.
-                // TS and PS streams have not index and have timestamp
-                // discontinuities, so we seek to a byte position in these.
+                // TS and PS streams have no index and have timestamp
+                // discontinuities, and scan took their previews at byte
+                // positions, so we seek to a byte position in these.
                 hb_stream_seek(r->stream, frac);
             }
         }
@@ -194,12 +208,18 @@ static int hb_reader_open( hb_work_private_t * r )
                 // first packet we get, subtract that from pts_to_start, and
                 // inspect the reset of the frames in sync.
                 r->duration -= r->job->pts_to_start;
-                r->job->reader_pts_offset = AV_NOPTS_VALUE;
+                r->job->reader_pts_offset = hb_stream_seek_pts(r->stream);
+                if (r->job->reader_pts_offset != AV_NOPTS_VALUE)
+                {
+                    // TS and PS seeks land on a random access point whose
+                    // title time is already known.
+                    r->start_found = 1;
+                }
             }
             else
             {
-                // hb_stream_seek_ts does nothing for TS streams and will
-                // return an error.
+                // The timestamp could not be located (e.g. no random
+                // access point was found before it).
                 //
                 // So we will decode frames until we find the correct time
                 // in sync.c
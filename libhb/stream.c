@@ -181,6 +181,9 @@ struct hb_stream_s
     int      chapter;           /* Chapter that we are currently in */
     int64_t  chapter_end;       /* HB time that the current chapter ends */
 
+    int64_t  seek_pts;          /* Title time that the last timestamp seek
+                                   landed on, AV_NOPTS_VALUE if unknown */
+
 
     struct
     {
@@ -1881,15 +1884,286 @@ int hb_stream_seek( hb_stream_t * stream, float f )
     return 1;
 }
 
+/***********************************************************************
+ * hb_stream_seek_ts
+ ***********************************************************************
+ *
+ * Transport and program streams have no index.  Bisect the file on the
+ * PTS of the video stream, then back up to the closest random access
+ * point at or before the requested time.
+ *
+ * Bisection only works when the PTS increase through the file.  The
+ * result is rejected when the probes are out of order, when the PTS jump
+ * between the random access point and the requested time, or when the
+ * random access point is too far before it, so that the caller falls
+ * back to decoding from the start.
+ *
+ **********************************************************************/
+#define SEEK_PTS_MASK    0x1ffffffffLL
+#define SEEK_MIN_SPAN    (256 * 1024)
+#define SEEK_MAX_PROBES  64
+// PTS may go back this much in decode order (B-frames)
+#define SEEK_PTS_REORDER (1 * 90000)
+// Largest PTS step between neighbouring video PES
+#define SEEK_PTS_STEP    (5 * 90000)
+// Farthest a random access point may be before the requested time
+#define SEEK_MAX_BEFORE  (30 * 90000)
+
+typedef struct
+{
+    off_t   pos;
+    int64_t rel;
+} seek_probe_t;
+
+static int seek_probe_cmp( const void *a, const void *b )
+{
+    const seek_probe_t *pa = a, *pb = b;
+
+    if ( pa->pos != pb->pos )
+    {
+        return pa->pos < pb->pos ? -1 : 1;
+    }
+    return 0;
+}
+
+// The PTS seen by the bisection must not decrease through the file,
+// otherwise the file has discontinuities and bisection is meaningless.
+static int seek_probes_ordered( seek_probe_t *probes, int count )
+{
+    int ii;
+
+    qsort( probes, count, sizeof(seek_probe_t), seek_probe_cmp );
+    for ( ii = 1; ii < count; ii++ )
+    {
+        if ( probes[ii].rel + SEEK_PTS_REORDER < probes[ii - 1].rel )
+        {
+            hb_log( "hb_stream_seek_ts: PTS discontinuity between offsets "
+                    "%"PRId64" and %"PRId64, (int64_t)probes[ii - 1].pos,
+                    (int64_t)probes[ii].pos );
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Read forward to the next video PES that has a PTS.  *pos is set to a
+// file position that reading can be restarted from so that this PES is
+// seen again.
+static int seek_next_video_pts( hb_stream_t *stream, off_t *pos,
+                                int64_t *pts, int *key )
+{
+    if ( stream->hb_stream_type == transport )
+    {
+        const uint8_t *buf;
+        int adapt_len;
+        int pid = stream->ts.list[ts_index_of_video(stream)].pid;
+
+        while ( ( buf = hb_ts_stream_getPEStype( stream, pid,
+                                                 &adapt_len ) ) != NULL )
+        {
+            const uint8_t *pes = buf + 4 + adapt_len;
+            if ( ( pes[7] >> 7 ) != 1 )
+            {
+                continue;
+            }
+            *pts = ((((uint64_t)pes[ 9] >> 1 ) & 7) << 30) |
+                   (  (uint64_t)pes[10] << 22)             |
+                   ( ((uint64_t)pes[11] >> 1 )      << 15) |
+                   (  (uint64_t)pes[12] << 7 )             |
+                   (  (uint64_t)pes[13] >> 1 );
+            *key = ts_isIframe( stream, buf, adapt_len );
+            *pos = ftello( stream->file_handle ) - stream->packetsize;
+            return 0;
+        }
+    }
+    else
+    {
+        hb_buffer_t *buf;
+        hb_pes_info_t pes_info;
+        off_t start = ftello( stream->file_handle );
+
+        buf = hb_ps_stream_getVideo( stream, &pes_info );
+        if ( buf != NULL )
+        {
+            *pts = pes_info.pts;
+            *key = isIframe( stream, buf->data, buf->size );
+            *pos = start;
+            hb_buffer_close( &buf );
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int seek_sample( hb_stream_t *stream, off_t fpos, off_t *pos,
+                        int64_t *pts, int *key )
+{
+    if ( stream->hb_stream_type == transport )
+    {
+        fseeko( stream->file_handle, fpos, SEEK_SET );
+        align_to_next_packet( stream );
+    }
+    else
+    {
+        fpos &=~ ( HB_DVD_READ_BUFFER_SIZE - 1 );
+        fseeko( stream->file_handle, fpos, SEEK_SET );
+        if ( stream->hb_stream_type == program )
+        {
+            skip_to_next_pack( stream );
+        }
+    }
+    return seek_next_video_pts( stream, pos, pts, key );
+}
+
+static int ts_ps_seek_ts( hb_stream_t * stream, int64_t ts )
+{
+    off_t        fsize, lo, hi, mid, start, back, pos, found_pos = -1;
+    int64_t      base, pts, rel, prev, found_rel = 0;
+    int          key, ii, count = 0, continuous = 1;
+    seek_probe_t probes[SEEK_MAX_PROBES + 1];
+
+    if ( stream->hb_stream_type == transport &&
+         ts_index_of_video( stream ) < 0 )
+    {
+        return -1;
+    }
+
+    fseeko( stream->file_handle, 0, SEEK_END );
+    fsize = ftello( stream->file_handle );
+    if ( seek_sample( stream, 0, &pos, &base, &key ) )
+    {
+        hb_stream_seek( stream, 0. );
+        return -1;
+    }
+    probes[count].pos = pos;
+    probes[count].rel = 0;
+    count++;
+
+    // The first video PES found after 'lo' is always at or before 'ts'.
+    // PTS are compared relative to the start of the file so that a
+    // single 33 bit wrap inside the file is harmless.
+    lo = 0;
+    hi = fsize;
+    for ( ii = 0; ii < SEEK_MAX_PROBES && hi - lo > SEEK_MIN_SPAN; ii++ )
+    {
+        mid = lo + ( hi - lo ) / 2;
+        if ( seek_sample( stream, mid, &pos, &pts, &key ) == 0 )
+        {
+            rel = ( pts - base ) & SEEK_PTS_MASK;
+            probes[count].pos = pos;
+            probes[count].rel = rel;
+            count++;
+            if ( rel <= ts )
+            {
+                lo = mid;
+                continue;
+            }
+        }
+        hi = mid;
+    }
+    if ( !seek_probes_ordered( probes, count ) )
+    {
+        hb_stream_seek( stream, 0. );
+        return -1;
+    }
+
+    // Find the last random access point at or before 'ts', reading
+    // further back each time none is found.
+    back  = 0;
+    start = lo;
+    while ( found_pos < 0 )
+    {
+        if ( seek_sample( stream, start, &pos, &pts, &key ) == 0 )
+        {
+            prev = ( pts - base ) & SEEK_PTS_MASK;
+            do
+            {
+                rel = ( pts - base ) & SEEK_PTS_MASK;
+                if ( rel > prev + SEEK_PTS_STEP ||
+                     rel + SEEK_PTS_REORDER + SEEK_PTS_STEP < prev )
+                {
+                    continuous = 0;
+                    break;
+                }
+                prev = rel;
+                if ( rel > ts )
+                {
+                    break;
+                }
+                if ( key || !stream->has_IDRs )
+                {
+                    found_pos = pos;
+                    found_rel = rel;
+                }
+            } while ( seek_next_video_pts( stream, &pos, &pts, &key ) == 0 );
+        }
+        if ( found_pos >= 0 || start == 0 || !continuous )
+        {
+            break;
+        }
+        back  = back ? back * 2 : SEEK_MIN_SPAN;
+        start = MAX( 0, lo - back );
+    }
+    if ( !continuous )
+    {
+        hb_log( "hb_stream_seek_ts: PTS discontinuity before %"PRId64, ts );
+        hb_stream_seek( stream, 0. );
+        return -1;
+    }
+    if ( found_pos < 0 || ts - found_rel > SEEK_MAX_BEFORE )
+    {
+        hb_log( "hb_stream_seek_ts: no random access point before %"PRId64,
+                ts );
+        hb_stream_seek( stream, 0. );
+        return -1;
+    }
+
+    hb_deep_log( 2, "hb_stream_seek_ts: %"PRId64" found at %"PRId64
+                 " (offset %"PRId64")", ts, found_rel, (int64_t)found_pos );
+    fseeko( stream->file_handle, found_pos, SEEK_SET );
+    if ( stream->hb_stream_type == transport )
+    {
+        hb_ts_stream_reset( stream );
+    }
+    else
+    {
+        hb_ps_stream_reset( stream );
+    }
+    if ( !stream->has_IDRs )
+    {
+        // the stream has no IDRs so don't look for one.
+        stream->need_keyframe = 0;
+    }
+    stream->seek_pts = found_rel;
+
+    return 0;
+}
+
 int hb_stream_seek_ts( hb_stream_t * stream, int64_t ts )
 {
+    stream->seek_pts = AV_NOPTS_VALUE;
     if ( stream->hb_stream_type == ffmpeg )
     {
         return ffmpeg_seek_ts( stream, ts );
     }
+    if ( stream->hb_stream_type == transport ||
+         stream->hb_stream_type == program )
+    {
+        return ts_ps_seek_ts( stream, ts );
+    }
     return -1;
 }
 
+/*
+ * Title time of the position the last hb_stream_seek_ts landed on.
+ * AV_NOPTS_VALUE when it is only known once the first video packet
+ * has been read (libav streams).
+ */
+int64_t hb_stream_seek_pts( hb_stream_t * stream )
+{
+    return stream->seek_pts;
+}
+
 static char* strncpyupper( char *dst, const char *src, int len )
 {
     int ii;
@@ -11,6 +11,7 @@
 #include "handbrake/hbffmpeg.h"
 #include <stdio.h>
 #include "handbrake/audio_resample.h"
+#include "handbrake/audio_loudness.h"
 #include "handbrake/hwaccel.h"
 
 #if HB_PROJECT_FEATURE_QSV
@@ -132,6 +133,8 @@ typedef struct
             // Samplerate conversion
             hb_audio_resample_t * resample;
             double                gain_factor;
+            // Loudness normalization
+            hb_audio_loudness_t * loudness;
         } audio;
 
         // Subtitle stream context
@@ -533,7 +536,11 @@ static void alignStream( sync_common_t * common, sync_stream_t * stream,
         }
         else if (stream->type == SYNC_TYPE_VIDEO)
         {
-            blank_buf = CreateBlackBuf(stream, gap, pts);
+            // Can't add black frames to passthru video either
+            if (common->job->vcodec != HB_VCODEC_PASSTHRU)
+            {
+                blank_buf = CreateBlackBuf(stream, gap, pts);
+            }
         }
 
         int64_t last_stop = pts;
@@ -1231,6 +1238,17 @@ static void streamFlush( sync_stream_t * stream )
         hb_list_rem(stream->in_queue, buf);
         hb_buffer_close(&buf);
     }
+    if (stream->type == SYNC_TYPE_AUDIO && stream->audio.loudness != NULL)
+    {
+        hb_buffer_t * buf;
+
+        // Output what is left in the loudness lookahead window.
+        // These were timestamped by OutputBuffer before being held.
+        while ((buf = hb_audio_loudness_flush(stream->audio.loudness)) != NULL)
+        {
+            fifo_push(stream->fifo_out, buf);
+        }
+    }
     fifo_push(stream->fifo_out, hb_buffer_eof_init());
 }
 
@@ -1742,6 +1760,19 @@ static int OutputBuffer( sync_common_t * common )
             saveChap(out_stream, buf);
             hb_buffer_close(&buf);
         }
+        if (buf != NULL && out_stream->type == SYNC_TYPE_AUDIO &&
+            out_stream->audio.loudness != NULL)
+        {
+            // Buffers are held back for the loudness lookahead window.
+            // Their timestamps are already final, so holding them does
+            // not stall next_pts and open a gap that gets filled with
+            // silence.
+            buf = hb_audio_loudness_process(out_stream->audio.loudness, buf);
+            if (buf == NULL)
+            {
+                continue;
+            }
+        }
         restoreChap(out_stream, buf);
         fifo_push(out_stream->fifo_out, buf);
         out_count++;
@@ -2084,8 +2115,13 @@ static void QueueBuffer( sync_stream_t * stream, hb_buffer_t * buf )
     }
 
     // Render offset is only useful for decoders, which are all
-    // upstream of sync.  Squash it.
-    buf->s.renderOffset = AV_NOPTS_VALUE;
+    // upstream of sync.  Squash it.  Passthru video carries its
+    // pts - dts distance there instead.
+    if (stream->type != SYNC_TYPE_VIDEO ||
+        stream->common->job->vcodec != HB_VCODEC_PASSTHRU)
+    {
+        buf->s.renderOffset = AV_NOPTS_VALUE;
+    }
 
     hb_deep_log(11,
         "type %8s id %x scr seq %d start %"PRId64" stop %"PRId64" dur %f",
@@ -2197,6 +2233,21 @@ static int InitAudio( sync_common_t * common, int index )
 
     pv->stream->audio.gain_factor = pow(10, audio->config.out.gain / 20);
 
+    if (!(audio->config.out.codec & HB_ACODEC_PASS_FLAG) &&
+        audio->config.out.loudness_target != 0.0)
+    {
+        pv->stream->audio.loudness =
+            hb_audio_loudness_init(audio->config.out.samplerate,
+                                   audio->config.out.mixdown,
+                                   audio->config.out.loudness_target,
+                                   HB_LOUDNESS_LOOKAHEAD_DEFAULT);
+        if (pv->stream->audio.loudness == NULL)
+        {
+            hb_error("sync: audio 0x%x loudness init failed", audio->id);
+            goto fail;
+        }
+    }
+
     hb_list_add(common->list_work, w);
 
     return 0;
@@ -2210,6 +2261,7 @@ fail:
             {
                 hb_audio_resample_free(pv->stream->audio.resample);
             }
+            hb_audio_loudness_free(&pv->stream->audio.loudness);
             hb_list_close(&pv->stream->delta_list);
             hb_list_close(&pv->stream->in_queue);
         }
@@ -3010,6 +3062,14 @@ static void syncAudioClose( hb_work_object_t * w )
     {
         hb_audio_resample_free(pv->stream->audio.resample);
     }
+    if (pv->stream->audio.loudness)
+    {
+        hb_log("sync: audio 0x%x integrated loudness %.1f LUFS, final gain %+.1f dB",
+               pv->stream->audio.audio->id,
+               hb_audio_loudness_integrated(pv->stream->audio.loudness),
+               hb_audio_loudness_gain(pv->stream->audio.loudness));
+        hb_audio_loudness_free(&pv->stream->audio.loudness);
+    }
 
     sync_delta_t * delta;
     while ((delta = hb_list_item(pv->stream->delta_list, 0)) != NULL)
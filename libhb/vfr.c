@@ -72,53 +72,18 @@ hb_filter_object_t hb_filter_vfr =
     .settings_template = hb_vfr_template,
 };
 
-static hb_motion_metric_object_t * hb_motion_metric_init(hb_filter_init_t *init)
+static float frame_motion(hb_filter_private_t * pv,
+                          hb_buffer_t * ref, hb_buffer_t * buf)
 {
-    hb_motion_metric_object_t *metric;
-    switch (init->hw_pix_fmt)
-    {
-#if defined(__APPLE__)
-        case AV_PIX_FMT_VIDEOTOOLBOX:
-            metric = &hb_motion_metric_vt;
-            break;
-#endif
-        default:
-            metric = &hb_motion_metric;
-            break;
-    }
-
-    hb_motion_metric_object_t *metric_copy = malloc(sizeof(hb_motion_metric_object_t));
-    if (metric_copy == NULL)
+    // comb_detect already measured it if neither frame has been
+    // changed since
+    if ((buf->s.analysis.flags & HB_ANALYSIS_MOTION) &&
+        (ref->s.analysis.flags & HB_ANALYSIS_MOTION) &&
+        buf->s.analysis.motion_ref == ref->s.start)
     {
-        hb_error("vfr: motion metric malloc failed");
-        return NULL;
+        return buf->s.analysis.motion;
     }
-
-    memcpy(metric_copy, metric, sizeof(hb_motion_metric_object_t));
-
-    if (metric_copy->init(metric_copy, init))
-    {
-        free(metric_copy);
-        hb_error("vfr: motion metric init failed");
-        return NULL;
-    }
-
-    return metric_copy;
-}
-
-void hb_motion_metric_close(hb_motion_metric_object_t **_m)
-{
-    hb_motion_metric_object_t *m = *_m;
-
-    if (m == NULL)
-    {
-        return;
-    }
-
-    m->close(m);
-
-    free(m);
-    *_m = NULL;
+    return pv->metric->work(pv->metric, ref, buf);
 }
 
 static void delete_metric(double * metrics, int pos, int size)
@@ -236,7 +201,7 @@ static hb_buffer_t * adjust_frame_rate( hb_filter_private_t * pv,
         penultimate = hb_list_item(pv->frame_rate_list, count - 2);
         ultimate    = hb_list_item(pv->frame_rate_list, count - 1);
 
-        pv->frame_metric[count - 1] = pv->metric->work(pv->metric, penultimate, ultimate);
+        pv->frame_metric[count - 1] = frame_motion(pv, penultimate, ultimate);
 
         if (count < pv->frame_analysis_depth)
         {
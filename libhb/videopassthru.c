@@ -0,0 +1,476 @@
+/* videopassthru.c
+
+   Copyright (c) 2003-2025 HandBrake Team
+   This file is part of the HandBrake source code
+   Homepage: <http://handbrake.fr/>.
+   It may be used under the terms of the GNU General Public License v2.
+   For full terms see the file COPYING file or visit http://www.gnu.org/licenses/gpl-2.0.html
+ */
+
+/* Video passthru (remux) work objects.
+ *
+ * hb_decpassthru sits where the video decoder would and turns the
+ * demuxed stream into whole, timestamped packets.  Packets travel through
+ * sync in decode order, so the start time of each buffer is its dts and
+ * the distance to its pts is carried in renderOffset, which sync leaves
+ * alone in passthru mode.
+ *
+ * hb_encpassthru sits where the video encoder would and converts the
+ * synchronized buffers back to the pts/dts pair the muxer expects.
+ *
+ * Streams demuxed by HandBrake carry their parameter sets in-band.
+ * hb_decpassthru extracts them from the parsed packets into
+ * job->extradata, and the muxer writes its header (avcC, hvcC,
+ * CodecPrivate) along with the first packet.
+ */
+
+#include "handbrake/handbrake.h"
+#include "handbrake/hbffmpeg.h"
+#include "handbrake/extradata.h"
+#include "libavcodec/bsf.h"
+
+struct hb_work_private_s
+{
+    hb_job_t             * job;
+    double                 duration;
+
+    // hb_decpassthru
+    AVCodecContext       * context;
+    AVCodecParserContext * parser;
+    AVBSFContext         * bsf;         // until extradata was found
+    AVPacket             * pkt;
+    hb_data_t           ** extradata;
+    hb_buffer_list_t       list;
+    int                    unfinished;
+    int                    new_chap;
+    int                    scr_sequence;
+    int64_t                last_dts;
+
+    // hb_encpassthru
+    int                    codec_param;
+    int                    got_keyframe;
+    int                    dropped;
+};
+
+static int  decpassthruInit(hb_work_object_t *, hb_job_t *);
+static int  decpassthruWork(hb_work_object_t *, hb_buffer_t **, hb_buffer_t **);
+static void decpassthruClose(hb_work_object_t *);
+static int  encpassthruInit(hb_work_object_t *, hb_job_t *);
+static int  encpassthruWork(hb_work_object_t *, hb_buffer_t **, hb_buffer_t **);
+static void encpassthruClose(hb_work_object_t *);
+
+hb_work_object_t hb_decpassthru =
+{
+    .id     = WORK_DECPASSTHRU,
+    .name   = "Video Passthru (parser)",
+    .init   = decpassthruInit,
+    .work   = decpassthruWork,
+    .close  = decpassthruClose,
+};
+
+hb_work_object_t hb_encpassthru =
+{
+    .id     = WORK_ENCPASSTHRU,
+    .name   = "Video Passthru",
+    .init   = encpassthruInit,
+    .work   = encpassthruWork,
+    .close  = encpassthruClose,
+};
+
+static double frame_duration(hb_job_t *job)
+{
+    if (job->title->vrate.num <= 0 || job->title->vrate.den <= 0)
+    {
+        return 90000. / 25.;
+    }
+    return 90000. * job->title->vrate.den / job->title->vrate.num;
+}
+
+static int extract_init(hb_work_private_t *pv, int codec_id)
+{
+    const AVBitStreamFilter *bsf = av_bsf_get_by_name("extract_extradata");
+    int                      ret;
+
+    if (bsf == NULL)
+    {
+        hb_log("decpassthru: extract_extradata not available");
+        return 0;
+    }
+    ret = av_bsf_alloc(bsf, &pv->bsf);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    pv->bsf->par_in->codec_type = AVMEDIA_TYPE_VIDEO;
+    pv->bsf->par_in->codec_id   = codec_id;
+    if (av_bsf_init(pv->bsf) < 0)
+    {
+        // The codec keeps no configuration outside of its frames
+        av_bsf_free(&pv->bsf);
+        return 0;
+    }
+    pv->pkt = av_packet_alloc();
+    if (pv->pkt == NULL)
+    {
+        av_bsf_free(&pv->bsf);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+// Store the first codec configuration found in the parsed packets
+static void extract_extradata(hb_work_private_t *pv, hb_buffer_t *buf)
+{
+    int ret;
+
+    pv->pkt->data = buf->data;
+    pv->pkt->size = buf->size;
+    ret = av_bsf_send_packet(pv->bsf, pv->pkt);
+    if (ret < 0)
+    {
+        av_packet_unref(pv->pkt);
+        return;
+    }
+    while (av_bsf_receive_packet(pv->bsf, pv->pkt) == 0)
+    {
+        const uint8_t *extradata;
+        size_t         size;
+
+        extradata = av_packet_get_side_data(pv->pkt,
+                                            AV_PKT_DATA_NEW_EXTRADATA, &size);
+        if (extradata != NULL && size > 0 && *pv->extradata == NULL)
+        {
+            if (hb_set_extradata(pv->extradata, extradata, size))
+            {
+                hb_error("decpassthru: failed to copy extradata");
+            }
+        }
+        av_packet_unref(pv->pkt);
+    }
+    if (*pv->extradata != NULL)
+    {
+        av_bsf_free(&pv->bsf);
+        av_packet_free(&pv->pkt);
+    }
+}
+
+static int decpassthruInit(hb_work_object_t *w, hb_job_t *job)
+{
+    hb_work_private_t *pv = calloc(1, sizeof(hb_work_private_t));
+    if (pv == NULL)
+    {
+        return 1;
+    }
+    w->private_data = pv;
+
+    pv->job      = job;
+    pv->duration = frame_duration(job);
+    pv->last_dts = AV_NOPTS_VALUE;
+    hb_buffer_list_clear(&pv->list);
+
+    if (job->title->opaque_priv != NULL)
+    {
+        // libavformat demuxes whole packets for us and the stream
+        // parameters already hold the codec configuration.
+        AVFormatContext   *ic  = (AVFormatContext *)job->title->opaque_priv;
+        AVCodecParameters *par = ic->streams[job->title->video_id]->codecpar;
+
+        if (par->extradata != NULL && par->extradata_size > 0 &&
+            w->extradata != NULL &&
+            hb_set_extradata(w->extradata, par->extradata,
+                             par->extradata_size))
+        {
+            hb_error("decpassthru: failed to copy extradata");
+            return 1;
+        }
+    }
+    else
+    {
+        // Our own demuxers deliver PES payloads that do not align with
+        // frame boundaries.
+        pv->context = avcodec_alloc_context3(NULL);
+        pv->parser  = av_parser_init(w->codec_param);
+        if (pv->context == NULL || pv->parser == NULL)
+        {
+            hb_error("decpassthru: no parser for %s",
+                     avcodec_get_name(w->codec_param));
+            return 1;
+        }
+        pv->context->codec_type = AVMEDIA_TYPE_VIDEO;
+        pv->context->codec_id   = w->codec_param;
+
+        // The codec configuration is only found in-band
+        if (w->extradata != NULL && *w->extradata == NULL &&
+            extract_init(pv, w->codec_param))
+        {
+            hb_error("decpassthru: failed to initialize extract_extradata");
+            return 1;
+        }
+        pv->extradata = w->extradata;
+    }
+
+    return 0;
+}
+
+static void decpassthruClose(hb_work_object_t *w)
+{
+    hb_work_private_t *pv = w->private_data;
+
+    if (pv == NULL)
+    {
+        return;
+    }
+    if (pv->parser != NULL)
+    {
+        av_parser_close(pv->parser);
+    }
+    av_bsf_free(&pv->bsf);
+    av_packet_free(&pv->pkt);
+    hb_avcodec_free_context(&pv->context);
+    hb_buffer_list_close(&pv->list);
+    free(pv);
+    w->private_data = NULL;
+}
+
+// Move the timestamps into the layout sync expects for passthru video.
+static void set_timestamps(hb_work_private_t *pv, hb_buffer_t *buf,
+                           int64_t pts, int64_t dts)
+{
+    if (dts == AV_NOPTS_VALUE)
+    {
+        dts = pts;
+    }
+    if (dts == AV_NOPTS_VALUE && pv->last_dts != AV_NOPTS_VALUE)
+    {
+        dts = pv->last_dts + pv->duration;
+    }
+    if (pts == AV_NOPTS_VALUE || pts < dts)
+    {
+        pts = dts;
+    }
+    if (dts != AV_NOPTS_VALUE)
+    {
+        pv->last_dts = dts;
+    }
+
+    buf->s.start        = dts;
+    buf->s.renderOffset = dts != AV_NOPTS_VALUE ? pts - dts : 0;
+    buf->s.duration     = pv->duration;
+    buf->s.stop         = dts != AV_NOPTS_VALUE ? dts + pv->duration :
+                                                  AV_NOPTS_VALUE;
+}
+
+static void parser_output(hb_work_private_t *pv, uint8_t *data, int size)
+{
+    hb_buffer_t *out = hb_buffer_init(size);
+    if (out == NULL)
+    {
+        return;
+    }
+    memcpy(out->data, data, size);
+
+    out->s.type         = VIDEO_BUF;
+    out->s.scr_sequence = pv->scr_sequence;
+    out->s.new_chap     = pv->new_chap;
+    pv->new_chap        = 0;
+
+    if (pv->parser->key_frame == 1 ||
+        pv->parser->pict_type == AV_PICTURE_TYPE_I)
+    {
+        out->s.flags    |= HB_FLAG_FRAMETYPE_KEY;
+        out->s.frametype = HB_FRAME_I;
+    }
+    else if (pv->parser->pict_type == AV_PICTURE_TYPE_B)
+    {
+        out->s.frametype = HB_FRAME_B;
+    }
+    else
+    {
+        out->s.frametype = HB_FRAME_P;
+    }
+    set_timestamps(pv, out, pv->parser->pts, pv->parser->dts);
+    if (pv->bsf != NULL)
+    {
+        // Before the packet goes downstream, the muxer writes its
+        // header when it sees the first one
+        extract_extradata(pv, out);
+    }
+    hb_buffer_list_append(&pv->list, out);
+}
+
+static void parser_flush(hb_work_private_t *pv)
+{
+    uint8_t *pout;
+    int      pout_len;
+
+    do
+    {
+        pout     = NULL;
+        pout_len = 0;
+        av_parser_parse2(pv->parser, pv->context, &pout, &pout_len,
+                         NULL, 0, AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+        if (pout != NULL && pout_len > 0)
+        {
+            parser_output(pv, pout, pout_len);
+        }
+    } while (pout != NULL && pout_len > 0);
+}
+
+static int decpassthruWork(hb_work_object_t *w, hb_buffer_t **buf_in,
+                           hb_buffer_t **buf_out)
+{
+    hb_work_private_t *pv = w->private_data;
+    hb_buffer_t       *in = *buf_in;
+
+    *buf_out = NULL;
+
+    if (in->s.flags & HB_BUF_FLAG_EOF)
+    {
+        if (pv->parser != NULL)
+        {
+            parser_flush(pv);
+        }
+        hb_buffer_list_append(&pv->list, in);
+        *buf_in  = NULL;
+        *buf_out = hb_buffer_list_clear(&pv->list);
+        return HB_WORK_DONE;
+    }
+
+    if (pv->parser == NULL)
+    {
+        // Already one packet per buffer
+        *buf_in = NULL;
+        set_timestamps(pv, in, in->s.start, in->s.renderOffset);
+        *buf_out = in;
+        return HB_WORK_OK;
+    }
+
+    // Chapter and SCR information belong to the frame that starts in
+    // this buffer, which is the next one the parser completes unless a
+    // frame is still being assembled from earlier buffers.
+    if (!pv->unfinished)
+    {
+        pv->scr_sequence = in->s.scr_sequence;
+        if (in->s.new_chap > 0)
+        {
+            pv->new_chap = in->s.new_chap;
+        }
+    }
+
+    int64_t pts = in->s.start;
+    int64_t dts = in->s.renderOffset;
+    int     pos, len;
+    for (pos = 0; pos < in->size; pos += len)
+    {
+        uint8_t *pout     = NULL;
+        int      pout_len = 0;
+
+        len = av_parser_parse2(pv->parser, pv->context, &pout, &pout_len,
+                               in->data + pos, in->size - pos, pts, dts, 0);
+        pts = AV_NOPTS_VALUE;
+        dts = AV_NOPTS_VALUE;
+
+        if (pout != NULL && pout_len > 0)
+        {
+            parser_output(pv, pout, pout_len);
+
+            pv->scr_sequence = in->s.scr_sequence;
+            if (in->s.new_chap > 0 && pv->unfinished)
+            {
+                pv->new_chap = in->s.new_chap;
+            }
+            pv->unfinished = 0;
+        }
+        if (len > 0 && pout_len <= 0)
+        {
+            pv->unfinished = 1;
+        }
+    }
+    *buf_out = hb_buffer_list_clear(&pv->list);
+
+    return HB_WORK_OK;
+}
+
+static int encpassthruInit(hb_work_object_t *w, hb_job_t *job)
+{
+    hb_work_private_t *pv = calloc(1, sizeof(hb_work_private_t));
+    if (pv == NULL)
+    {
+        return 1;
+    }
+    w->private_data = pv;
+
+    pv->job         = job;
+    pv->duration    = frame_duration(job);
+    pv->codec_param = job->title->video_codec_param;
+
+    return 0;
+}
+
+static void encpassthruClose(hb_work_object_t *w)
+{
+    hb_work_private_t *pv = w->private_data;
+
+    if (pv == NULL)
+    {
+        return;
+    }
+    free(pv);
+    w->private_data = NULL;
+}
+
+static int encpassthruWork(hb_work_object_t *w, hb_buffer_t **buf_in,
+                           hb_buffer_t **buf_out)
+{
+    hb_work_private_t *pv = w->private_data;
+    hb_buffer_t       *in = *buf_in;
+
+    *buf_out = NULL;
+
+    if (in->s.flags & HB_BUF_FLAG_EOF)
+    {
+        *buf_in  = NULL;
+        *buf_out = in;
+        return HB_WORK_DONE;
+    }
+
+    // Sync may have trimmed the head of the stream (p-to-p, A/V
+    // alignment), and nothing before the first keyframe is decodable.
+    if (!pv->got_keyframe)
+    {
+        if (!(in->s.flags & HB_FLAG_FRAMETYPE_KEY))
+        {
+            pv->dropped++;
+            return HB_WORK_OK;
+        }
+        if (pv->dropped > 0)
+        {
+            hb_log("encpassthru: dropped %d frames before the first keyframe",
+                   pv->dropped);
+        }
+        pv->got_keyframe = 1;
+    }
+
+    int64_t delta = in->s.renderOffset;
+    if (delta == AV_NOPTS_VALUE || delta < 0)
+    {
+        delta = 0;
+    }
+
+    in->s.renderOffset = in->s.start;
+    in->s.start       += delta;
+    in->s.stop        += delta;
+
+    // Only MPEG-1/2 guarantee B-frames are never referenced
+    if (in->s.frametype != HB_FRAME_B ||
+        (pv->codec_param != AV_CODEC_ID_MPEG1VIDEO &&
+         pv->codec_param != AV_CODEC_ID_MPEG2VIDEO))
+    {
+        in->s.flags |= HB_FLAG_FRAMETYPE_REF;
+    }
+
+    *buf_in  = NULL;
+    *buf_out = in;
+
+    return HB_WORK_OK;
+}
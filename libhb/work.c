@@ -50,6 +50,8 @@ static void filter_loop( void * );
 #define FIFO_MINI 4
 #define FIFO_MINI_WAKE 3
 
+#define QUALITY_SEARCH_STEPS 8
+
 /**
  * Allocates work object and launches work thread with work_func.
  * @param jobs Handle to hb_list_t.
@@ -104,6 +106,119 @@ static void SetWorkStateInfo(hb_job_t *job)
     hb_set_state( job->h, &state );
 }
 
+/**
+ * Encodes and measures the quality search samples at one quality value.
+ * @param work Handle work object.
+ * @param job Handle to hb_job_t.
+ * @param quality Quality value to encode at.
+ * @return Lowest score of the samples.
+ */
+static double quality_search_sample(hb_work_t * work, hb_job_t * job,
+                                    double quality)
+{
+    hb_list_t * samples = hb_list_init();
+    hb_job_t  * sample;
+    double      score = 0.;
+    int         count, ii;
+
+    hb_log("work: quality search, trying %.2f", quality);
+
+    hb_job_setup_quality_search(job->h, job, quality, samples);
+    count = hb_list_count(samples);
+    for (ii = 0; ii < count && !*work->die; ii++)
+    {
+        sample = hb_list_item(samples, ii);
+        sample->die = work->die;
+        sample->done_error = work->error;
+        *(work->current_job) = sample;
+        InitWorkState(sample, ii + 1, count);
+        do_job(sample);
+        score = ii == 0 ? sample->quality_score :
+                          MIN(score, sample->quality_score);
+    }
+    *(work->current_job) = NULL;
+
+    for (ii = 0; ii < count; ii++)
+    {
+        sample = hb_list_item(samples, ii);
+        hb_job_close(&sample);
+    }
+    hb_list_close(&samples);
+
+    hb_log("work: quality search, %.2f scores %.4f", quality, score);
+    return score;
+}
+
+/**
+ * Constant quality search.  Bisects the quality range of the video
+ * encoder for the lowest quality at which every sample still meets
+ * job->quality_target, and encodes the job at that quality.
+ * @param work Handle work object.
+ * @param job Handle to hb_job_t.
+ */
+static void quality_search(hb_work_t * work, hb_job_t * job)
+{
+    float  low, high, granularity;
+    int    direction, steps, good, bad, mid;
+    double quality, tried = HB_INVALID_VIDEO_QUALITY;
+
+    hb_video_quality_get_limits(job->vcodec, &low, &high, &granularity,
+                                &direction);
+    if (granularity <= 0 || high <= low)
+    {
+        hb_log("work: quality search not supported by %s, skipping",
+               hb_video_encoder_get_name(job->vcodec));
+        return;
+    }
+
+    hb_log("work: quality search, target %s %.4f, %d samples of %d s",
+           job->quality_metric == HB_QUALITY_METRIC_PSNR ? "PSNR" : "SSIM",
+           job->quality_target, job->quality_samples,
+           job->quality_sample_duration);
+
+    // Search over steps from the best quality (0) to the worst (steps).
+    // Samples meet the target from step 0 up to some step, the lowest
+    // quality that meets it is the last good step.
+    steps = (high - low) / granularity + .5;
+    good  = -1;
+    bad   = steps + 1;
+    for (int ii = 0; ii < QUALITY_SEARCH_STEPS && bad - good > 1 &&
+                     !*work->die; ii++)
+    {
+        mid     = (good + bad) / 2;
+        quality = direction ? low + mid * granularity :
+                              high - mid * granularity;
+        if (quality_search_sample(work, job, quality) >= job->quality_target)
+        {
+            good = mid;
+        }
+        else
+        {
+            bad = mid;
+        }
+        tried = quality;
+    }
+    if (*work->die)
+    {
+        return;
+    }
+
+    if (good < 0)
+    {
+        // Nothing tried met the target, use the best quality tried
+        hb_log("work: quality search, target not met");
+        quality = tried;
+    }
+    else
+    {
+        quality = direction ? low + good * granularity :
+                              high - good * granularity;
+    }
+    hb_log("work: quality search, encoding at %.2f (%s)", quality,
+           hb_video_quality_get_name(job->vcodec));
+    job->vquality = quality;
+}
+
 /**
  * Iterates through job list and calls do_job for each job.
  * @param _work Handle work object.
@@ -153,6 +268,13 @@ static void work_func( void * _work )
             job = new_job;
         }
 
+        if (job->quality_target > 0 &&
+            job->vquality > HB_INVALID_VIDEO_QUALITY &&
+            job->vcodec != HB_VCODEC_PASSTHRU)
+        {
+            quality_search(work, job);
+        }
+
         hb_job_setup_passes(job->h, job, passes);
         hb_job_close(&job);
 
@@ -365,6 +487,9 @@ hb_work_object_t* hb_video_encoder(hb_handle_t *h, int vcodec)
            w = hb_get_work(h, WORK_ENCAVCODEC);
            w->codec_param = AV_CODEC_ID_FFV1;
             break;
+        case HB_VCODEC_PASSTHRU:
+            w = hb_get_work(h, WORK_ENCPASSTHRU);
+            break;
         default:
             hb_error("Unknown video codec (0x%x)", vcodec );
     }
@@ -416,6 +541,83 @@ hb_work_object_t* hb_audio_encoder(hb_handle_t *h, int codec)
     return NULL;
 }
 
+/*
+ * Filters that keep several cores busy.  Filters that only move or
+ * convert pixels (crop/scale, pad, rotate, colorspace, format, ...) get
+ * no share of the cpus even though they run in a thread or avfilter
+ * graph of their own.  yadif and bwdif run inside an avfilter graph,
+ * their own entries are skipped in the pipeline but still count here.
+ */
+static const int heavy_filters[] =
+{
+    HB_FILTER_DETELECINE,
+    HB_FILTER_COMB_DETECT,
+    HB_FILTER_DECOMB,
+    HB_FILTER_YADIF,
+    HB_FILTER_BWDIF,
+    HB_FILTER_DEBLOCK,
+    HB_FILTER_DENOISE,
+    HB_FILTER_NLMEANS,
+    HB_FILTER_CHROMA_SMOOTH,
+    HB_FILTER_LAPSHARP,
+    HB_FILTER_UNSHARP,
+    HB_FILTER_INVALID
+};
+
+static int count_heavy_filters(hb_job_t *job)
+{
+    int count = 0;
+
+    if (job == NULL || job->list_filter == NULL)
+    {
+        return 0;
+    }
+    for (int ii = 0; ii < hb_list_count(job->list_filter); ii++)
+    {
+        hb_filter_object_t *filter = hb_list_item(job->list_filter, ii);
+        for (int jj = 0; heavy_filters[jj] != HB_FILTER_INVALID; jj++)
+        {
+            if (filter->id == heavy_filters[jj])
+            {
+                count++;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Number of threads a pipeline stage of a job should use for its own
+ * thread pool.  The cpus are shared by the decoder, the encoder and
+ * every heavy filter.  A filter gets an even share.  The encoder is
+ * usually the bottleneck and gets what the decoder and an eighth of the
+ * cpus per heavy filter leave, at least half the cpus.  Either is capped
+ * at HB_THREAD_POOL_MAX.
+ * @param job Handle to hb_job_t, may be NULL.
+ * @param stage HB_THREADS_ENCODER or HB_THREADS_FILTER.
+ */
+int hb_job_thread_count(hb_job_t *job, int stage)
+{
+    int cpu_count = hb_get_cpu_count();
+    int heavy     = count_heavy_filters(job);
+    int reserve, threads;
+
+    switch (stage)
+    {
+        case HB_THREADS_ENCODER:
+            reserve = 1 + heavy * MAX(1, cpu_count / 8);
+            threads = cpu_count - MIN(reserve, cpu_count / 2);
+            break;
+        case HB_THREADS_FILTER:
+        default:
+            // decoder, encoder and the heavy filters
+            threads = (cpu_count + heavy + 1) / (heavy + 2);
+            break;
+    }
+    return MAX(1, MIN(threads, HB_THREAD_POOL_MAX));
+}
+
 /**
  * Displays job parameters in the debug log.
  * @param job Handle work hb_job_t.
@@ -787,6 +989,11 @@ void hb_display_job_info(hb_job_t *job)
                 {
                     hb_log( "   + gain: %.fdB", audio->config.out.gain );
                 }
+                if (audio->config.out.loudness_target != 0.0)
+                {
+                    hb_log("   + loudness normalization: %.1f LUFS",
+                           audio->config.out.loudness_target);
+                }
                 if (audio->config.out.dynamic_range_compression > 0.0f &&
                     hb_audio_can_apply_drc(audio->config.in.codec,
                                            audio->config.in.codec_param,
@@ -1024,6 +1231,20 @@ static int sanitize_subtitles( hb_job_t * job )
     for (i = 0; i < hb_list_count(job->list_subtitle);)
     {
         subtitle = hb_list_item(job->list_subtitle, i);
+        if (job->vcodec == HB_VCODEC_PASSTHRU &&
+            (subtitle->config.dest == RENDERSUB ||
+             hb_subtitle_must_burn(subtitle, job->mux)))
+        {
+            if (!hb_subtitle_can_pass(subtitle->source, job->mux))
+            {
+                hb_log("Subtitle burn-in is not possible with video passthru, dropping track %d.", i);
+                hb_list_rem(job->list_subtitle, subtitle);
+                free(subtitle);
+                continue;
+            }
+            hb_log("Subtitle burn-in is not possible with video passthru.  Changing track %d to soft subtitle.", i);
+            subtitle->config.dest = PASSTHRUSUB;
+        }
         if (subtitle->config.dest == RENDERSUB)
         {
             if (one_burned)
@@ -1712,6 +1933,10 @@ static void do_job(hb_job_t *job)
     {
         hb_log( "Starting Task: Analysis Pass" );
     }
+    else if (job->pass_id == HB_PASS_QUALITY_SEARCH)
+    {
+        hb_log( "Starting Task: Quality Search Sample" );
+    }
     else
     {
         hb_log( "Starting Task: Encoding Pass" );
@@ -1745,6 +1970,25 @@ static void do_job(hb_job_t *job)
         *job->die = 1;
         goto cleanup;
     }
+    if (job->vcodec == HB_VCODEC_PASSTHRU)
+    {
+        // The video is never decoded, so there is nothing to filter
+        // and the output has the properties of the source.
+        hb_filter_object_t *filter;
+        while ((filter = hb_list_item(job->list_filter, 0)) != NULL)
+        {
+            hb_list_rem(job->list_filter, filter);
+            hb_filter_close(&filter);
+        }
+        job->hw_decode       = 0;
+        job->passthru_dynamic_hdr_metadata = 0;
+        job->output_pix_fmt  = title->pix_fmt;
+        job->color_prim      = title->color_prim;
+        job->color_transfer  = title->color_transfer;
+        job->color_matrix    = title->color_matrix;
+        job->color_range     = title->color_range;
+        job->chroma_location = title->chroma_location;
+    }
     // Filters have an effect on settings.
     // So initialize the filters and update the job.
     if (job->list_filter && hb_list_count(job->list_filter))
@@ -1899,6 +2143,12 @@ static void do_job(hb_job_t *job)
         job->fifo_render = NULL; // Attached to filter chain
         job->fifo_out    = hb_fifo_init( FIFO_LARGE, FIFO_LARGE_WAKE );
     }
+    if (job->pass_id == HB_PASS_QUALITY_SEARCH)
+    {
+        // Holds the frames of the encoder's lookahead, so no bound
+        job->fifo_quality_ref = hb_fifo_init(FIFO_UNBOUNDED,
+                                             FIFO_UNBOUNDED_WAKE);
+    }
 
     result = sanitize_audio(job);
     if (result)
@@ -1982,8 +2232,19 @@ static void do_job(hb_job_t *job)
     }
 
     // Video decoder
-    w = hb_video_decoder(job->h, title->video_codec, title->video_codec_param,
-                         job->hw_device_ctx, job->hw_accel);
+    if (job->vcodec == HB_VCODEC_PASSTHRU && !job->indepth_scan)
+    {
+        // Splits the input into packets, no decoding
+        w = hb_get_work(job->h, WORK_DECPASSTHRU);
+        w->codec_param = title->video_codec_param;
+        w->extradata   = &job->extradata;
+    }
+    else
+    {
+        w = hb_video_decoder(job->h, title->video_codec,
+                             title->video_codec_param,
+                             job->hw_device_ctx, job->hw_accel);
+    }
     if (w == NULL)
     {
         *job->done_error = HB_ERROR_WRONG_INPUT;
@@ -2070,6 +2331,16 @@ static void do_job(hb_job_t *job)
             job->fifo_render = NULL;
         }
 
+        if (job->pass_id == HB_PASS_QUALITY_SEARCH)
+        {
+            // Copy what the encoder gets for the quality measure
+            w = hb_get_work(job->h, WORK_QUALITY_REFERENCE);
+            w->fifo_in  = job->fifo_render ? job->fifo_render : job->fifo_sync;
+            w->fifo_out = hb_fifo_init(FIFO_MINI, FIFO_MINI_WAKE);
+            job->fifo_render = w->fifo_out;
+            hb_list_add(job->list_work, w);
+        }
+
         // Video encoder
         w = hb_video_encoder(job->h, job->vcodec);
         if (w == NULL)
@@ -2097,7 +2368,14 @@ static void do_job(hb_job_t *job)
     // Add Muxer work object
     // Muxer work object should be the last object added to the list
     // during regular encoding pass.  For subtitle scan, sync is last.
-    if (!job->indepth_scan)
+    // Quality search samples are measured instead of muxed.
+    if (job->pass_id == HB_PASS_QUALITY_SEARCH)
+    {
+        w = hb_get_work(job->h, WORK_QUALITY_MEASURE);
+        w->fifo_in = job->fifo_out;
+        hb_list_add(job->list_work, w);
+    }
+    else if (!job->indepth_scan)
     {
         w = hb_get_work(job->h, WORK_MUX);
         hb_list_add(job->list_work, w);
@@ -2109,6 +2387,14 @@ static void do_job(hb_job_t *job)
         hb_log("work: only 1 chapter, disabling chapter markers");
     }
 
+    // Pick up where an interrupted run of this job left off.
+    // This can move the start of the job, so it must precede
+    // the initialization of the reader and sync.
+    if (!job->indepth_scan && job->checkpoint > 0)
+    {
+        hb_checkpoint_init(job);
+    }
+
     /* Display settings */
     hb_display_job_info( job );
 
@@ -2127,6 +2413,19 @@ static void do_job(hb_job_t *job)
         }
     }
 
+    // Log filter output hashes of the pass that is muxed
+    if (job->frame_hash_file != NULL && job->list_filter != NULL &&
+        (job->pass_id == HB_PASS_ENCODE ||
+         job->pass_id == HB_PASS_ENCODE_FINAL))
+    {
+        if (hb_frame_hash_init(job))
+        {
+            *job->done_error = HB_ERROR_INIT;
+            *job->die = 1;
+            goto cleanup;
+        }
+    }
+
     /* Launch processing threads */
     for (i = 0; i < hb_list_count( job->list_work ); i++)
     {
@@ -2180,6 +2479,7 @@ cleanup:
             filter->close(filter);
         }
     }
+    hb_frame_hash_close(job);
 
     // Close work objects
     // A work thread can use data created by another work thread's init.
@@ -2200,12 +2500,14 @@ cleanup:
     }
 
     hb_list_close( &job->list_work );
+    hb_checkpoint_close(job);
 
     /* Close fifos */
     hb_fifo_close( &job->fifo_in );
     hb_fifo_close( &job->fifo_raw );
     hb_fifo_close( &job->fifo_sync );
     hb_fifo_close( &job->fifo_out );
+    hb_fifo_close( &job->fifo_quality_ref );
 
     for (i = 0; i < hb_list_count( job->list_subtitle ); i++)
     {
@@ -2390,6 +2692,11 @@ static void filter_loop( void * _f )
 
         f->status = f->work( f, &buf_in, &buf_out );
 
+        if (buf_out && f->frame_hash != NULL)
+        {
+            hb_frame_hash_filter(f->frame_hash, f, buf_out);
+        }
+
         if ( buf_out && f->chapter_val && f->chapter_time <= buf_out->s.start )
         {
             buf_out->s.new_chap = f->chapter_val;
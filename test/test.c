@@ -30,6 +30,10 @@
 #include <pthread.h>
 #endif
 
+#if defined( SYS_LINUX )
+#include <sys/inotify.h>
+#endif
+
 #include "handbrake/handbrake.h"
 #include "handbrake/lang.h"
 #include "parsecsv.h"
@@ -136,6 +140,7 @@ static char ** normalize_mix_level       = NULL;
 static char ** audio_dither              = NULL;
 static char ** dynamic_range_compression = NULL;
 static char ** audio_gain                = NULL;
+static char ** audio_loudness            = NULL;
 static char ** acompressions             = NULL;
 static char *  acodec_fallback           = NULL;
 static char ** anames                    = NULL;
@@ -162,6 +167,7 @@ static int      width                    = 0;
 static int      height                   = 0;
 static int      crop[4]                  = { -1,-1,-1,-1 };
 static char *   crop_mode                = NULL;
+static char *   video_scaler             = NULL;
 static int      crop_threshold_pixels    = 0;
 static int      crop_threshold_frames    = 0;
 static char *   vrate                    = NULL;
@@ -193,6 +199,9 @@ static char *   preset_export_desc   = NULL;
 static char *   preset_export_file   = NULL;
 static char *   preset_name          = NULL;
 static char *   queue_import_name    = NULL;
+static char *   watch_dir            = NULL;
+static int      watch_settle         = 5;
+static int      watch_jobs           = 1;
 static int      cfr           = -1;
 static int      optimize      = -1;
 static int      ipod_atom     = -1;
@@ -213,6 +222,15 @@ static int      qsv_adapter        = -1;
 static int      qsv_decode         = -1;
 #endif
 static int          hw_decode      = 0;
+static int          thread_policy  = HB_THREAD_POLICY_NORMAL;
+static int          checkpoint     = 0;
+static double       quality_target = 0;
+static char *       quality_metric = NULL;
+static int          quality_samples = 0;
+static char *       frame_hash_file = NULL;
+static char *       frame_hash_compare = NULL;
+static double       frame_hash_tolerance = 0;
+static int          reference_kernels = 0;
 static int      keep_duplicate_titles = 0;
 static int      hdr_dynamic_metadata_disable = 0;
 static char *   hdr_dynamic_metadata  = NULL;
@@ -502,6 +520,393 @@ int RunQueue(hb_handle_t *h, const char *queue_import_name)
     return 0;
 }
 
+/****************************************************************************
+ * Watch folder
+ ****************************************************************************
+ * Files that appear in watch_dir are scanned and encoded with the preset,
+ * using up to watch_jobs long-lived handles.  A file is picked up once its
+ * size and modification time have been stable for watch_settle seconds.
+ * On Linux inotify tells us when to look at the directory again, elsewhere
+ * it is polled.
+ ****************************************************************************/
+enum
+{
+    WATCH_IDLE,
+    WATCH_SCANNING,
+    WATCH_ENCODING,
+};
+
+typedef struct
+{
+    hb_handle_t * h;
+    int           state;
+    char        * input;
+    char        * output;
+} watch_slot_t;
+
+static char * watch_output_name(const char *path, hb_dict_t *preset_dict)
+{
+    const char     * name, * ext = "mkv";
+    hb_container_t * container;
+    char           * base, * dot, * result;
+
+    container = hb_container_get_from_name(
+        hb_value_get_string(hb_dict_get(preset_dict, "FileFormat")));
+    if (container != NULL)
+    {
+        ext = container->default_extension;
+    }
+
+    name = hb_strr_dir_sep(path);
+    name = name != NULL ? name + 1 : path;
+    base = strdup(name);
+    dot  = strrchr(base, '.');
+    if (dot != NULL && dot != base)
+    {
+        *dot = 0;
+    }
+    result = hb_strdup_printf("%s/%s.%s", output, base, ext);
+    free(base);
+
+    return result;
+}
+
+static int watch_writing(watch_slot_t *slots, const char *path)
+{
+    int ii;
+
+    for (ii = 0; ii < watch_jobs; ii++)
+    {
+        if (slots[ii].state != WATCH_IDLE && slots[ii].output != NULL &&
+            !strcmp(slots[ii].output, path))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Forgets files that are gone, so a new file with the same name is
+// picked up again and 'seen' does not grow without bound
+static void watch_expire(hb_dict_t *seen, watch_slot_t *slots)
+{
+    hb_value_array_t * gone = hb_value_array_init();
+    hb_dict_iter_t     iter;
+    int                ii;
+
+    for (iter  = hb_dict_iter_init(seen);
+         iter != HB_DICT_ITER_DONE;
+         iter  = hb_dict_iter_next(seen, iter))
+    {
+        const char * path = hb_dict_iter_key(iter);
+        hb_stat_t    sb;
+
+        // Our output may not exist yet while it is being encoded
+        if (!hb_stat(path, &sb) || watch_writing(slots, path))
+        {
+            continue;
+        }
+        hb_value_array_append(gone, hb_value_string(path));
+    }
+    for (ii = 0; ii < hb_value_array_len(gone); ii++)
+    {
+        hb_dict_remove(seen,
+                       hb_value_get_string(hb_value_array_get(gone, ii)));
+    }
+    hb_value_free(&gone);
+}
+
+// Updates the stability state of every file in the watch directory
+// and appends the files that are ready to 'ready'
+static void watch_poll(hb_dict_t *seen, hb_value_array_t *ready,
+                       watch_slot_t *slots, hb_dict_t *preset_dict)
+{
+    HB_DIR        * dir;
+    struct dirent * entry;
+    uint64_t        now = hb_get_date();
+
+    dir = hb_opendir(watch_dir);
+    if (dir == NULL)
+    {
+        return;
+    }
+    while ((entry = hb_readdir(dir)) != NULL)
+    {
+        hb_stat_t   sb;
+        hb_dict_t * file;
+        char      * path;
+
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        path = hb_strdup_printf("%s/%s", watch_dir, entry->d_name);
+        file = hb_dict_get(seen, path);
+        if (hb_stat(path, &sb) || !S_ISREG(sb.st_mode))
+        {
+            free(path);
+            continue;
+        }
+        if (file != NULL && hb_value_get_bool(hb_dict_get(file, "Done")))
+        {
+            // Our own output is never picked up; anything else that
+            // changes after it was handled is treated as a new file
+            if (hb_value_get_bool(hb_dict_get(file, "Output")) ||
+                (hb_value_get_int(hb_dict_get(file, "Size"))  == sb.st_size &&
+                 hb_value_get_int(hb_dict_get(file, "MTime")) == sb.st_mtime))
+            {
+                free(path);
+                continue;
+            }
+            fprintf(stderr, "Watch: %s changed, picking it up again\n", path);
+            file = NULL;
+        }
+        if (file == NULL ||
+            hb_value_get_int(hb_dict_get(file, "Size"))  != sb.st_size ||
+            hb_value_get_int(hb_dict_get(file, "MTime")) != sb.st_mtime)
+        {
+            file = hb_dict_init();
+            hb_dict_set(file, "Size", hb_value_int(sb.st_size));
+            hb_dict_set(file, "MTime", hb_value_int(sb.st_mtime));
+            hb_dict_set(file, "Since", hb_value_int(now));
+            hb_dict_set(seen, path, file);
+        }
+        else if (now - hb_value_get_int(hb_dict_get(file, "Since")) >=
+                 watch_settle * 1000ULL)
+        {
+            char      * out = watch_output_name(path, preset_dict);
+            hb_stat_t   osb;
+
+            hb_dict_set(file, "Done", hb_value_bool(1));
+            // An earlier run already encoded it
+            if (!hb_stat(out, &osb) && osb.st_mtime >= sb.st_mtime)
+            {
+                fprintf(stderr, "Watch: skipping %s, %s is up to date\n",
+                        path, out);
+            }
+            else
+            {
+                hb_value_array_append(ready, hb_value_string(path));
+            }
+            free(out);
+        }
+        free(path);
+    }
+    hb_closedir(dir);
+    watch_expire(seen, slots);
+}
+
+static int watch_pending(hb_dict_t *seen)
+{
+    hb_dict_iter_t iter;
+
+    for (iter  = hb_dict_iter_init(seen);
+         iter != HB_DICT_ITER_DONE;
+         iter  = hb_dict_iter_next(seen, iter))
+    {
+        hb_dict_t *file = hb_dict_iter_value(iter);
+        if (!hb_value_get_bool(hb_dict_get(file, "Done")))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void watch_slot_done(watch_slot_t *slot)
+{
+    free(slot->input);
+    free(slot->output);
+    slot->input  = NULL;
+    slot->output = NULL;
+    slot->state  = WATCH_IDLE;
+}
+
+static void watch_slot_start(watch_slot_t *slot, const char *path,
+                             hb_dict_t *seen, hb_dict_t *preset_dict)
+{
+    hb_list_t * file_paths;
+    hb_dict_t * file;
+
+    slot->input  = strdup(path);
+    slot->output = watch_output_name(path, preset_dict);
+    slot->state  = WATCH_SCANNING;
+
+    // Never pick up our own output if it lands in the watch directory
+    file = hb_dict_init();
+    hb_dict_set(file, "Done", hb_value_bool(1));
+    hb_dict_set(file, "Output", hb_value_bool(1));
+    hb_dict_set(seen, slot->output, file);
+
+    fprintf(stderr, "Watch: scanning %s\n", slot->input);
+    file_paths = hb_list_init();
+    hb_list_add(file_paths, slot->input);
+    hb_scan(slot->h, file_paths, titleindex, preview_count, store_previews,
+            min_title_duration * 90000LL, max_title_duration * 90000LL,
+            crop_threshold_frames, crop_threshold_pixels,
+            NULL, hw_decode, keep_duplicate_titles);
+    hb_list_close(&file_paths);
+}
+
+static void watch_slot_update(watch_slot_t *slot, hb_dict_t *preset_dict)
+{
+    hb_state_t       s;
+    hb_title_set_t * title_set;
+    hb_title_t     * title;
+    hb_dict_t      * job_dict;
+    char           * json_job, * saved_output;
+
+    hb_get_state(slot->h, &s);
+    if (slot->state == WATCH_SCANNING && s.state == HB_STATE_SCANDONE)
+    {
+        title_set = hb_get_title_set(slot->h);
+        title = title_set != NULL ? hb_list_item(title_set->list_title, 0) :
+                                    NULL;
+        if (title == NULL)
+        {
+            fprintf(stderr, "Watch: no title found in %s\n", slot->input);
+            watch_slot_done(slot);
+            return;
+        }
+
+        // PrepareJob names the output after the global option
+        saved_output = output;
+        output       = slot->output;
+        job_dict     = PrepareJob(slot->h, title, preset_dict);
+        output       = saved_output;
+
+        json_job = job_dict != NULL ? hb_value_get_json(job_dict) : NULL;
+        hb_value_free(&job_dict);
+        if (json_job == NULL)
+        {
+            fprintf(stderr, "Watch: error in setting up job for %s\n",
+                    slot->input);
+            watch_slot_done(slot);
+            return;
+        }
+        fprintf(stderr, "Watch: encoding %s to %s\n",
+                slot->input, slot->output);
+        hb_add_json(slot->h, json_job);
+        free(json_job);
+        slot->state = WATCH_ENCODING;
+        hb_start(slot->h);
+    }
+    else if (slot->state == WATCH_ENCODING && s.state == HB_STATE_WORKDONE)
+    {
+        switch (s.param.working.error)
+        {
+            case HB_ERROR_NONE:
+                fprintf(stderr, "Watch: %s done\n", slot->output);
+                break;
+            case HB_ERROR_CANCELED:
+                fprintf(stderr, "Watch: %s canceled\n", slot->output);
+                break;
+            default:
+                fprintf(stderr, "Watch: %s failed (error %x)\n",
+                        slot->output, s.param.working.error);
+                done_error = s.param.working.error;
+                break;
+        }
+        watch_slot_done(slot);
+    }
+}
+
+static void WatchLoop(hb_handle_t *h, hb_dict_t *preset_dict)
+{
+    watch_slot_t     * slots;
+    hb_dict_t        * seen  = hb_dict_init();
+    hb_value_array_t * ready = hb_value_array_init();
+    uint64_t           last_poll = 0;
+    int                ii, fd = -1, poll_now = 1;
+
+    slots = calloc(watch_jobs, sizeof(watch_slot_t));
+    slots[0].h = h;
+    for (ii = 1; ii < watch_jobs; ii++)
+    {
+        slots[ii].h = hb_init(debug);
+    }
+
+#if defined( SYS_LINUX )
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0 &&
+        inotify_add_watch(fd, watch_dir, IN_CLOSE_WRITE | IN_MOVED_TO |
+                                         IN_CREATE | IN_MODIFY) < 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+#endif
+
+    fprintf(stderr, "Watching %s, output to %s\n", watch_dir, output);
+    while (!die)
+    {
+        // Without inotify, and while files are settling, look at
+        // the directory once a second
+        if (poll_now ||
+            ((fd < 0 || watch_pending(seen)) &&
+             hb_get_date() - last_poll >= 1000))
+        {
+            watch_poll(seen, ready, slots, preset_dict);
+            last_poll = hb_get_date();
+            poll_now  = 0;
+        }
+
+        for (ii = 0; ii < watch_jobs; ii++)
+        {
+            if (slots[ii].state == WATCH_IDLE &&
+                hb_value_array_len(ready) > 0)
+            {
+                watch_slot_start(&slots[ii],
+                    hb_value_get_string(hb_value_array_get(ready, 0)),
+                    seen, preset_dict);
+                hb_value_array_remove(ready, 0);
+            }
+            watch_slot_update(&slots[ii], preset_dict);
+        }
+
+#if defined( SYS_LINUX )
+        if (fd >= 0)
+        {
+            fd_set         fds;
+            struct timeval tv;
+            char           buf[4096];
+
+            tv.tv_sec  = 0;
+            tv.tv_usec = 200000;
+            FD_ZERO(&fds);
+            FD_SET(fd, &fds);
+            if (select(fd + 1, &fds, NULL, NULL, &tv) > 0)
+            {
+                while (read(fd, buf, sizeof(buf)) > 0);
+                poll_now = 1;
+            }
+            continue;
+        }
+#endif
+        hb_snooze(200);
+    }
+
+    for (ii = 0; ii < watch_jobs; ii++)
+    {
+        if (slots[ii].state != WATCH_IDLE)
+        {
+            hb_stop(slots[ii].h);
+            watch_slot_done(&slots[ii]);
+        }
+        if (ii > 0)
+        {
+            hb_close(&slots[ii].h);
+        }
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    free(slots);
+    hb_value_free(&seen);
+    hb_value_free(&ready);
+}
+
 int main( int argc, char ** argv )
 {
     hb_handle_t * h;
@@ -531,7 +936,29 @@ int main( int argc, char ** argv )
     /* Register our error handler */
     hb_register_error_handler(&hb_cli_error_handler);
 
+    if (frame_hash_compare != NULL)
+    {
+        switch (hb_frame_hash_compare(frame_hash_file, frame_hash_compare,
+                                      frame_hash_tolerance))
+        {
+            case 0:
+                fprintf(stderr, "Frame hashes match\n");
+                break;
+            case 1:
+                fprintf(stderr, "Frame hashes differ\n");
+                done_error = HB_ERROR_UNKNOWN;
+                break;
+            default:
+                done_error = HB_ERROR_WRONG_INPUT;
+                break;
+        }
+        goto cleanup;
+    }
+
+    hb_set_reference_kernels(reference_kernels);
+
     hb_dvd_set_dvdnav( dvdnav );
+    hb_thread_set_policy( thread_policy );
 
     /* Show version */
     fprintf( stderr, "%s - %s - %s\n",
@@ -596,6 +1023,14 @@ int main( int argc, char ** argv )
             }
         }
 
+        if (watch_dir != NULL)
+        {
+            hb_system_sleep_prevent(h);
+            WatchLoop(h, preset_dict);
+            hb_value_free(&preset_dict);
+            goto cleanup;
+        }
+
         /* Feed libhb with a DVD to scan */
         fprintf( stderr, "Opening %s...\n", input );
 
@@ -635,6 +1070,7 @@ cleanup:
     hb_str_vfree(atracks);
     hb_str_vfree(audio_lang_list);
     hb_str_vfree(audio_gain);
+    hb_str_vfree(audio_loudness);
     hb_str_vfree(dynamic_range_compression);
     hb_str_vfree(mixdowns);
     hb_str_vfree(subtitle_lang_list);
@@ -669,6 +1105,11 @@ cleanup:
     free(preset_export_name);
     free(preset_export_desc);
     free(preset_export_file);
+    free(watch_dir);
+    free(video_scaler);
+    free(quality_metric);
+    free(frame_hash_file);
+    free(frame_hash_compare);
 
     // write a carriage return to stdout
     // avoids overlap / line wrapping when stderr is redirected
@@ -1357,7 +1798,22 @@ static void ShowHelp(void)
 "                           '--preset-export'\n"
 "   --queue-import-file <filename>\n"
 "                           Import an encode queue file created by the GUI\n"
+"   --watch <directory>     Watch a directory and encode each file that\n"
+"                           appears in it with the selected preset. Output\n"
+"                           files are written to the directory given with\n"
+"                           -o, named after the input. Runs until stopped.\n"
+"   --watch-settle <number> Seconds a file must stay unchanged before it is\n"
+"                           encoded (default: 5)\n"
+"   --watch-jobs <number>   Number of files to encode at the same time\n"
+"                           (default: 1)\n"
 "       --no-dvdnav         Do not use dvdnav for reading DVDs\n"
+#if defined( SYS_LINUX )
+"       --thread-policy <string>\n"
+"                           Scheduling class for encoding threads:\n"
+"                               normal (default)\n"
+"                               batch  (SCHED_BATCH, lowest best-effort I/O)\n"
+"                               idle   (SCHED_IDLE, idle I/O class)\n"
+#endif
 "\n"
 "\n"
 "Source Options ---------------------------------------------------------------\n"
@@ -1422,6 +1878,12 @@ static void ShowHelp(void)
 "   --inline-parameter-sets Create adaptive streaming compatible output.\n"
 "                           Inserts parameter sets (SPS and PPS) inline\n"
 "                           in the video stream before each IDR.\n"
+"       --checkpoint <number>\n"
+"                           Make the encode resumable. Every <number>\n"
+"                           seconds the output written so far is committed\n"
+"                           to a journal next to the destination file. If\n"
+"                           the encode is interrupted, running the same job\n"
+"                           again continues from the last commit.\n"
 "\n"
 "\n"
 "Video Options ----------------------------------------------------------------\n"
@@ -1468,6 +1930,16 @@ static void ShowHelp(void)
 "                           first pass to improve speed\n"
 "                           (works with x264 and x265)\n"
 "       --no-turbo          Disable 2-pass mode's \"turbo\" first pass\n"
+"       --quality-target <float>\n"
+"                           Search for the lowest video quality whose\n"
+"                           sample encodes meet this score, then encode at\n"
+"                           that quality. Samples start at the preview seek\n"
+"                           points. Requires constant quality (-q).\n"
+"       --quality-metric <string>\n"
+"                           Score used by --quality-target\n"
+"                           Options: ssim (default, 0-1), psnr (dB)\n"
+"       --quality-samples <number>\n"
+"                           Number of sample segments (default: 4)\n"
 "   -r, --rate <float>      Set video framerate\n"
 "                           (" );
     i = 0;
@@ -1658,6 +2130,10 @@ static void ShowHelp(void)
 "                           in dB.  Negative values attenuate, positive\n"
 "                           values amplify. A 1 dB difference is barely\n"
 "                           audible.\n"
+"       --loudness <float>  Normalize audio to the given integrated loudness\n"
+"                           (EBU R128, in LUFS, e.g. -23) while encoding.\n"
+"                           Does NOT work with audio passthru (copy).\n"
+"                           0 disables. Separate tracks by commas.\n"
 "       --adither <string>  Select dithering to apply before encoding audio:\n");
     dither = NULL;
     while ((dither = hb_audio_dither_get_next(dither)) != NULL)
@@ -1713,6 +2189,12 @@ static void ShowHelp(void)
 "                           Number of frames that must be different to trigger\n"
 "                           smart crop \n"
 "                           (default: 4, 6 or 8 scaling with preview count)\n"
+"       --scaler <string>   swscale|fast\n"
+"                           'fast' scales exact 2:1 and 4:1 downscales\n"
+"                           (e.g. 2160p to 1080p) with a box filter, which is\n"
+"                           much cheaper but softer than the default lanczos.\n"
+"                           Other sizes always use swscale.\n"
+"                           (default: swscale)\n"
 "   -Y, --maxHeight <number>\n"
 "                           Set maximum height in pixels\n"
 "   -X, --maxWidth  <number>\n"
@@ -1892,6 +2374,16 @@ static void ShowHelp(void)
     fprintf( out,
 "   -g, --grayscale         Grayscale encoding\n"
 "   --no-grayscale          Disable preset 'grayscale'\n"
+"   --frame-hash <filename> Log a hash of every frame each filter outputs\n"
+"   --reference-kernels     Use the plain C versions of filter kernels\n"
+"                           instead of the SIMD optimized ones\n"
+"   --frame-hash-compare <filename>\n"
+"                           Compare the --frame-hash log with this one and\n"
+"                           report which filters differ, then exit\n"
+"   --frame-hash-tolerance <float>\n"
+"                           Largest plane mean difference for frames that\n"
+"                           are not bit exact to still count as matching\n"
+"                           (default: 0)\n"
 "\n"
 "\n"
 "Subtitles Options ------------------------------------------------------------\n"
@@ -2277,6 +2769,20 @@ static int ParseOptions( int argc, char ** argv )
     #define HDR_DYNAMIC_METADATA          334
     #define AUDIO_AUTONAMING_BEHAVIOUR    335
     #define COLOR_RANGE                   336
+    #define THREAD_POLICY                 337
+    #define CHECKPOINT                    338
+    #define AUDIO_LOUDNESS                339
+    #define WATCH                         340
+    #define WATCH_SETTLE                  341
+    #define WATCH_JOBS                    342
+    #define QUALITY_TARGET                343
+    #define QUALITY_METRIC                344
+    #define QUALITY_SAMPLES               345
+    #define FRAME_HASH                    346
+    #define FRAME_HASH_COMPARE            347
+    #define FRAME_HASH_TOLERANCE          348
+    #define REFERENCE_KERNELS             349
+    #define VIDEO_SCALER                  350
 
     for( ;; )
     {
@@ -2287,6 +2793,9 @@ static int ParseOptions( int argc, char ** argv )
             { "describe",    no_argument,       NULL,    DESCRIBE },
             { "verbose",     optional_argument, NULL,    'v' },
             { "no-dvdnav",   no_argument,       NULL,    DVDNAV },
+#if defined( SYS_LINUX )
+            { "thread-policy", required_argument, NULL,  THREAD_POLICY },
+#endif
 
 #if HB_PROJECT_FEATURE_QSV
             { "qsv-async-depth",      required_argument, NULL,        QSV_ASYNC_DEPTH,    },
@@ -2323,6 +2832,7 @@ static int ParseOptions( int argc, char ** argv )
             { "inline-parameter-sets", no_argument, &inline_parameter_sets, 1 },
             { "no-inline-parameter-sets", no_argument, &inline_parameter_sets, 0 },
             { "align-av",    no_argument,       &align_av_start, 1 },
+            { "checkpoint",  required_argument, NULL,    CHECKPOINT },
             { "no-align-av", no_argument,       &align_av_start, 0 },
             { "keep-metadata", no_argument,     &metadata_passthru, 1 },
             { "no-metadata",   no_argument,     &metadata_passthru, 0 },
@@ -2334,6 +2844,7 @@ static int ParseOptions( int argc, char ** argv )
             { "normalize-mix", required_argument, NULL,  NORMALIZE_MIX },
             { "drc",         required_argument, NULL,    'D' },
             { "gain",        required_argument, NULL,    AUDIO_GAIN },
+            { "loudness",    required_argument, NULL,    AUDIO_LOUDNESS },
             { "adither",     required_argument, NULL,    AUDIO_DITHER },
             { "subtitle-lang-list", required_argument, NULL, SUBTITLE_LANG_LIST },
             { "all-subtitles", no_argument,     &subtitle_all, 1 },
@@ -2389,6 +2900,10 @@ static int ParseOptions( int argc, char ** argv )
             { "no-decomb",   no_argument,       &decomb_disable,      1 },
             { "grayscale",   no_argument,       NULL,        'g' },
             { "no-grayscale",no_argument,       &grayscale,    0 },
+            { "frame-hash",           required_argument, NULL, FRAME_HASH },
+            { "frame-hash-compare",   required_argument, NULL, FRAME_HASH_COMPARE },
+            { "frame-hash-tolerance", required_argument, NULL, FRAME_HASH_TOLERANCE },
+            { "reference-kernels",    no_argument,       NULL, REFERENCE_KERNELS },
             { "rotate",      optional_argument, NULL,   ROTATE_FILTER },
             { "non-anamorphic",  no_argument, &anamorphic_mode, HB_ANAMORPHIC_NONE },
             { "auto-anamorphic",  no_argument, &anamorphic_mode, HB_ANAMORPHIC_AUTO },
@@ -2407,6 +2922,7 @@ static int ParseOptions( int argc, char ** argv )
             { "crop-mode",   required_argument, NULL,     CROP_MODE },
             { "crop-threshold-pixels",  required_argument,  NULL, CROP_THRESHOLD_PIXELS },
             { "crop-threshold-frames",  required_argument,  NULL, CROP_THRESHOLD_FRAMES },
+            { "scaler",      required_argument, NULL,     VIDEO_SCALER },
             
             { "pad",         required_argument, NULL,            PAD },
             { "no-pad",      no_argument,       &pad_disable,    1 },
@@ -2437,6 +2953,9 @@ static int ParseOptions( int argc, char ** argv )
 
             { "vb",          required_argument, NULL,    'b' },
             { "quality",     required_argument, NULL,    'q' },
+            { "quality-target",  required_argument, NULL, QUALITY_TARGET },
+            { "quality-metric",  required_argument, NULL, QUALITY_METRIC },
+            { "quality-samples", required_argument, NULL, QUALITY_SAMPLES },
             { "ab",          required_argument, NULL,    'B' },
             { "aq",          required_argument, NULL,    'Q' },
             { "ac",          required_argument, NULL,    'C' },
@@ -2454,6 +2973,9 @@ static int ParseOptions( int argc, char ** argv )
             { "preset-export-file", required_argument, NULL, PRESET_EXPORT_FILE },
             { "preset-export-description", required_argument, NULL, PRESET_EXPORT_DESC },
             { "queue-import-file",  required_argument, NULL, QUEUE_IMPORT },
+            { "watch",       required_argument, NULL,    WATCH },
+            { "watch-settle",required_argument, NULL,    WATCH_SETTLE },
+            { "watch-jobs",  required_argument, NULL,    WATCH_JOBS },
 
             { "keep-aname",    no_argument,     &audio_name_passthru, 1 },
             { "no-keep-aname", no_argument,     &audio_name_passthru, 0 },
@@ -2562,9 +3084,57 @@ static int ParseOptions( int argc, char ** argv )
             case QUEUE_IMPORT:
                 queue_import_name = strdup(optarg);
                 break;
+            case WATCH:
+                watch_dir = strdup(optarg);
+                break;
+            case WATCH_SETTLE:
+                watch_settle = atoi(optarg);
+                if (watch_settle < 0)
+                {
+                    fprintf(stderr, "Invalid watch settle time (%s)\n", optarg);
+                    return -1;
+                }
+                break;
+            case WATCH_JOBS:
+                watch_jobs = atoi(optarg);
+                if (watch_jobs < 1)
+                {
+                    fprintf(stderr, "Invalid number of watch jobs (%s)\n", optarg);
+                    return -1;
+                }
+                break;
             case DVDNAV:
                 dvdnav = 0;
                 break;
+            case CHECKPOINT:
+                checkpoint = atoi(optarg);
+                if (checkpoint < 0)
+                {
+                    fprintf(stderr, "Invalid checkpoint interval (%s)\n", optarg);
+                    return -1;
+                }
+                break;
+#if defined( SYS_LINUX )
+            case THREAD_POLICY:
+                if (!strcasecmp(optarg, "normal"))
+                {
+                    thread_policy = HB_THREAD_POLICY_NORMAL;
+                }
+                else if (!strcasecmp(optarg, "batch"))
+                {
+                    thread_policy = HB_THREAD_POLICY_BATCH;
+                }
+                else if (!strcasecmp(optarg, "idle"))
+                {
+                    thread_policy = HB_THREAD_POLICY_IDLE;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid thread policy (%s)\n", optarg);
+                    return -1;
+                }
+                break;
+#endif
 
             case 'f':
                 format = strdup( optarg );
@@ -2675,6 +3245,12 @@ static int ParseOptions( int argc, char ** argv )
                     audio_gain = hb_str_vsplit(optarg, ',');
                 }
                 break;
+            case AUDIO_LOUDNESS:
+                if (optarg != NULL)
+                {
+                    audio_loudness = hb_str_vsplit(optarg, ',');
+                }
+                break;
             case AUDIO_DITHER:
                 if (optarg != NULL)
                 {
@@ -3035,6 +3611,17 @@ static int ParseOptions( int argc, char ** argv )
                 crop_mode  = strdup( optarg );
                 break;
             }
+            case VIDEO_SCALER:
+            {
+                if (strcmp(optarg, "swscale") && strcmp(optarg, "fast"))
+                {
+                    fprintf(stderr, "Invalid scaler (%s)\n", optarg);
+                    return -1;
+                }
+                free(video_scaler);
+                video_scaler = strdup(optarg);
+                break;
+            }
             case CROP_THRESHOLD_PIXELS:
             {
                 crop_threshold_pixels  = atoi( optarg );
@@ -3073,6 +3660,51 @@ static int ParseOptions( int argc, char ** argv )
             case 'q':
                 vquality = atof( optarg );
                 break;
+            case QUALITY_TARGET:
+                quality_target = atof(optarg);
+                if (quality_target <= 0)
+                {
+                    fprintf(stderr, "Invalid quality target (%s)\n", optarg);
+                    return -1;
+                }
+                break;
+            case QUALITY_METRIC:
+                if (strcasecmp(optarg, "ssim") && strcasecmp(optarg, "psnr"))
+                {
+                    fprintf(stderr, "Invalid quality metric (%s)\n", optarg);
+                    return -1;
+                }
+                free(quality_metric);
+                quality_metric = strdup(optarg);
+                break;
+            case QUALITY_SAMPLES:
+                quality_samples = atoi(optarg);
+                if (quality_samples < 1)
+                {
+                    fprintf(stderr, "Invalid quality samples (%s)\n", optarg);
+                    return -1;
+                }
+                break;
+            case FRAME_HASH:
+                free(frame_hash_file);
+                frame_hash_file = strdup(optarg);
+                break;
+            case FRAME_HASH_COMPARE:
+                free(frame_hash_compare);
+                frame_hash_compare = strdup(optarg);
+                break;
+            case FRAME_HASH_TOLERANCE:
+                frame_hash_tolerance = atof(optarg);
+                if (frame_hash_tolerance < 0)
+                {
+                    fprintf(stderr, "Invalid frame hash tolerance (%s)\n",
+                            optarg);
+                    return -1;
+                }
+                break;
+            case REFERENCE_KERNELS:
+                reference_kernels = 1;
+                break;
             case 'B':
                 abitrates = hb_str_vsplit( optarg, ',' );
                 break;
@@ -3755,7 +4387,39 @@ static int CheckOptions( int argc, char ** argv )
         return 0;
     }
 
-    if (preset_export_name == NULL && (input == NULL || *input == '\0'))
+    if (frame_hash_compare != NULL)
+    {
+        if (frame_hash_file == NULL)
+        {
+            fprintf(stderr, "--frame-hash-compare requires --frame-hash. "
+                    "Run %s --help for syntax.\n", argv[0]);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (watch_dir != NULL)
+    {
+        hb_stat_t sb;
+
+        if (input != NULL)
+        {
+            fprintf(stderr, "Incompatible options: --watch and --input\n");
+            return 1;
+        }
+        if (hb_stat(watch_dir, &sb) || !S_ISDIR(sb.st_mode))
+        {
+            fprintf(stderr, "Watch directory %s not found\n", watch_dir);
+            return 1;
+        }
+        if (output == NULL || hb_stat(output, &sb) || !S_ISDIR(sb.st_mode))
+        {
+            fprintf(stderr, "--watch requires an existing output directory "
+                    "(-o). Run %s --help for syntax.\n", argv[0]);
+            return 1;
+        }
+    }
+    else if (preset_export_name == NULL && (input == NULL || *input == '\0'))
     {
         fprintf( stderr, "Missing input device. Run %s --help for "
                  "syntax.\n", argv[0] );
@@ -3763,7 +4427,7 @@ static int CheckOptions( int argc, char ** argv )
     }
 
     /* Parse format */
-    if (titleindex > 0 && !titlescan)
+    if (titleindex > 0 && !titlescan && watch_dir == NULL)
     {
         if (preset_export_name == NULL && (output == NULL || *output == '\0'))
         {
@@ -4080,6 +4744,7 @@ static hb_dict_t * PreparePreset(const char *preset_name)
         audio_dither              != NULL ||
         dynamic_range_compression != NULL ||
         audio_gain                != NULL ||
+        audio_loudness            != NULL ||
         aqualities                != NULL ||
         acompressions             != NULL ||
         anames                    != NULL))
@@ -4099,6 +4764,7 @@ static hb_dict_t * PreparePreset(const char *preset_name)
         int count = MAX(hb_str_vlen(mixdowns),
                     MAX(hb_str_vlen(dynamic_range_compression),
                     MAX(hb_str_vlen(audio_gain),
+                    MAX(hb_str_vlen(audio_loudness),
                     MAX(hb_str_vlen(audio_dither),
                     MAX(hb_str_vlen(normalize_mix_level),
                     MAX(hb_str_vlen(arates),
@@ -4106,7 +4772,7 @@ static hb_dict_t * PreparePreset(const char *preset_name)
                     MAX(hb_str_vlen(aqualities),
                     MAX(hb_str_vlen(acompressions),
                     MAX(hb_str_vlen(acodecs),
-                        hb_str_vlen(anames)))))))))));
+                        hb_str_vlen(anames))))))))))));
 
         if (list_len < count)
         {
@@ -4189,6 +4855,12 @@ static hb_dict_t * PreparePreset(const char *preset_name)
                 hb_dict_set(audio_dict_stub, "AudioTrackGainSlider",
                   hb_value_double(strtod(audio_gain[last], NULL)));
             }
+            last = hb_str_vlen(audio_loudness) - 1;
+            if (last >= 0 && audio_loudness[last][0] != 0)
+            {
+                hb_dict_set(audio_dict_stub, "AudioTrackLoudnessTarget",
+                  hb_value_double(strtod(audio_loudness[last], NULL)));
+            }
             last = hb_str_vlen(audio_dither) - 1;
             if (last >= 0 && audio_dither[last][0] != 0)
             {
@@ -4340,6 +5012,21 @@ static hb_dict_t * PreparePreset(const char *preset_name)
             }
         }
 
+        // Override command line specified loudness target
+        if (hb_str_vlen(audio_loudness) > 0)
+        {
+            for (ii = 0; audio_loudness[ii] != NULL; ii++)
+            {
+                if (audio_loudness[ii][0] != 0)
+                {
+                    audio_dict = hb_value_array_get(list, ii);
+                    hb_dict_set(audio_dict, "AudioTrackLoudnessTarget",
+                      hb_value_double(
+                        strtod(audio_loudness[ii], NULL)));
+                }
+            }
+        }
+
         // Override command line specified dither method
         if (hb_str_vlen(audio_dither) > 0)
         {
@@ -4582,6 +5269,10 @@ static hb_dict_t * PreparePreset(const char *preset_name)
     {
         hb_dict_set(preset, "PictureCropMode",  hb_value_int(2));
     }
+    if (video_scaler != NULL)
+    {
+        hb_dict_set(preset, "VideoScaler", hb_value_string(video_scaler));
+    }
 
     if (display_width > 0)
     {
@@ -5047,6 +5738,49 @@ PrepareJob(hb_handle_t *h, hb_title_t *title, hb_dict_t *preset_dict)
     }
 
     hb_dict_set(dest_dict, "File", hb_value_string(output));
+    if (checkpoint > 0)
+    {
+        hb_dict_t *options_dict = hb_dict_get(dest_dict, "Options");
+        if (options_dict == NULL)
+        {
+            options_dict = hb_dict_init();
+            hb_dict_set(dest_dict, "Options", options_dict);
+        }
+        hb_dict_set(options_dict, "Checkpoint", hb_value_int(checkpoint));
+    }
+
+    if (quality_target > 0)
+    {
+        hb_dict_t *video_dict = hb_dict_get(job_dict, "Video");
+        if (!hb_dict_get(video_dict, "Quality"))
+        {
+            fprintf(stderr,
+                    "Warning: --quality-target requires constant quality\n");
+        }
+        else
+        {
+            hb_dict_t *search_dict = hb_dict_init();
+            hb_dict_set(search_dict, "Target", hb_value_double(quality_target));
+            if (quality_metric != NULL)
+            {
+                hb_dict_set(search_dict, "Metric",
+                            hb_value_string(quality_metric));
+            }
+            if (quality_samples > 0)
+            {
+                hb_dict_set(search_dict, "Samples",
+                            hb_value_int(quality_samples));
+            }
+            hb_dict_set(video_dict, "QualitySearch", search_dict);
+        }
+    }
+
+    if (frame_hash_file != NULL)
+    {
+        hb_dict_t *filters_dict = hb_dict_get(job_dict, "Filters");
+        hb_dict_set(filters_dict, "FrameHashFile",
+                    hb_value_string(frame_hash_file));
+    }
 
     // Now that the job is initialized, we need to find out
     // what muxer is being used.
@@ -5422,6 +6156,31 @@ PrepareJob(hb_handle_t *h, hb_title_t *title, hb_dict_t *preset_dict)
             hb_dict_set(audio_dict, "Gain", hb_value_double(gain));
         }
 
+        /* Audio Loudness */
+        ii = 0;
+        double loudness = 0.;
+        if (audio_loudness)
+        {
+            for (; audio_loudness[ii] != NULL && ii < track_count; ii++)
+            {
+                loudness = atof(audio_loudness[ii]);
+                audio_dict = hb_value_array_get(audio_array, ii);
+                hb_dict_set(audio_dict, "LoudnessTarget",
+                            hb_value_double(loudness));
+            }
+            if (audio_loudness[ii] != NULL)
+            {
+                fprintf(stderr, "Dropping excess audio loudness targets\n");
+            }
+        }
+        // If exactly one loudness target was specified, apply it to
+        // the rest of the tracks
+        if (ii == 1) for (; ii < track_count; ii++)
+        {
+            audio_dict = hb_value_array_get(audio_array, ii);
+            hb_dict_set(audio_dict, "LoudnessTarget", hb_value_double(loudness));
+        }
+
         /* Audio Dither */
         int dither = 0;
         ii = 0;